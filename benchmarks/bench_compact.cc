@@ -0,0 +1,84 @@
+// Measures the memory released by compacting a config in which most of the
+// document is read by other programs: per-backend metadata and a large
+// section belonging to another tool.
+#include "bench_compact.h"
+#include <fstream>
+#include <iostream>
+#include <malloc.h>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+	/**
+	 * Generate a config with `backends` backends and `entries` entries in a
+	 * section that the schema does not describe.
+	 */
+	std::string make_document(size_t backends, size_t entries)
+	{
+		std::string doc = "listen = \"192.0.2.1\";\n"
+		                  "log-level = \"info\";\n"
+		                  "limits { max-connections = 4096; buffer = 64kb; }\n"
+		                  "backends = [";
+		for (size_t i = 0; i < backends; i++)
+		{
+			auto n = std::to_string(i);
+			doc += "{ name = \"backend" + n + "\"; host = \"10.0." + n +
+			       ".1\"; port = 8080; metadata { owner = \"team" + n +
+			       "\"; description = \"Backend number " + n +
+			       " in the default pool\"; tags = [\"a\", \"b\", \"c\"]; } },";
+		}
+		doc += "];\nmonitoring {\n";
+		for (size_t i = 0; i < entries; i++)
+		{
+			auto n = std::to_string(i);
+			doc += "check" + n + " { url = \"http://10.0.0.1/health/" + n +
+			       "\"; interval = 10; alert = \"pager\"; },\n";
+		}
+		doc += "}\n";
+		return doc;
+	}
+
+	/**
+	 * Returns the bytes of heap in use, after returning free memory to the
+	 * OS, and the resident set size.
+	 */
+	std::pair<size_t, size_t> memory_use()
+	{
+		malloc_trim(0);
+		size_t        pages, resident;
+		std::ifstream statm("/proc/self/statm");
+		statm >> pages >> resident;
+		return {mallinfo2().uordblks, resident * sysconf(_SC_PAGESIZE)};
+	}
+} // namespace
+
+int main()
+{
+	for (auto [backends, entries] :
+	     {std::pair<size_t, size_t>{100, 1000}, {1000, 20000}})
+	{
+		std::string doc = make_document(backends, entries);
+		auto       *p   = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+		ucl_parser_add_string(p, doc.data(), doc.size());
+		auto *obj = ucl_parser_get_object(p);
+		ucl_parser_free(p);
+		doc.clear();
+		doc.shrink_to_fit();
+		auto conf        = std::get<Config>(make_config(obj));
+		auto [heap, rss] = memory_use();
+		Config::compact(obj);
+		auto [compactHeap, compactRss] = memory_use();
+		if (conf.backends().find_by_name("backend1")->port() != 8080)
+		{
+			std::cerr << "Compacting removed a property in the schema\n";
+			return EXIT_FAILURE;
+		}
+		std::cout << backends << " backends, " << entries
+		          << " unknown entries: heap " << heap / 1024 << " KiB -> "
+		          << compactHeap / 1024 << " KiB, RSS " << rss / 1024
+		          << " KiB -> " << compactRss / 1024 << " KiB\n";
+		ucl_object_unref(obj);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,224 @@
+// Compares reading the frequently accessed fields of many configs generated
+// from a 200-field schema: looked up in the UCL object on each access,
+// materialized in schema order, and materialized with the layout from
+// `bench_layout.profile`, which packs the hot fields into one cache line.
+#define CONFIG_NAMESPACE_BEGIN                                                 \
+	namespace lazy                                                             \
+	{
+#define CONFIG_NAMESPACE_END }
+#include "bench_layout_lazy.h"
+#undef CONFIG_NAMESPACE_BEGIN
+#define CONFIG_NAMESPACE_BEGIN                                                 \
+	namespace schema_order                                                     \
+	{
+#include "bench_layout_schema_order.h"
+#undef CONFIG_NAMESPACE_BEGIN
+#define CONFIG_NAMESPACE_BEGIN                                                 \
+	namespace profiled                                                         \
+	{
+#include "bench_layout_profiled.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <random>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	/**
+	 * The number of configs.  Large enough that the schema-order layouts do
+	 * not fit in the last-level cache, but the hot cache lines do.
+	 */
+	constexpr size_t ConfigCount = 4096;
+
+	/**
+	 * The number of passes over all of the configs.
+	 */
+	constexpr size_t Passes = 50;
+
+	/**
+	 * Generate a config in which every field is set.
+	 */
+	std::string make_document(size_t seed)
+	{
+		std::string doc;
+		for (size_t i = 0; i < 200; i++)
+		{
+			char name[16];
+			snprintf(name, sizeof(name), "field%03zu = ", i);
+			doc += name;
+			auto n = std::to_string((seed * 31 + i) % 1000);
+			switch (i % 4)
+			{
+				case 0:
+					doc += n;
+					break;
+				case 1:
+					doc += n + ".5";
+					break;
+				case 2:
+					doc += (seed + i) % 2 ? "true" : "false";
+					break;
+				case 3:
+					doc += "\"value " + n + "\"";
+					break;
+			}
+			doc += ";\n";
+		}
+		return doc;
+	}
+
+	/**
+	 * Read the hot fields of `conf`, as a request handler would.
+	 */
+	template<typename Config>
+	uint64_t read_hot_fields(const Config &conf)
+	{
+		return conf.field007().size() + static_cast<uint64_t>(conf.field033()) +
+		       conf.field058() + conf.field091().size() + conf.field120() +
+		       static_cast<uint64_t>(conf.field145()) + conf.field176() +
+		       conf.field198();
+	}
+
+	/**
+	 * A hardware performance counter for the calling thread.  Counters are
+	 * often unavailable in containers and virtual machines, in which case
+	 * `stop` returns nothing.
+	 */
+	class PerfCounter
+	{
+		int fd;
+
+		public:
+		PerfCounter(uint32_t type, uint64_t config)
+		{
+			perf_event_attr attr{};
+			attr.size           = sizeof(attr);
+			attr.type           = type;
+			attr.config         = config;
+			attr.disabled       = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv     = 1;
+			fd = static_cast<int>(
+			  syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		}
+
+		~PerfCounter()
+		{
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+		}
+
+		void start()
+		{
+			if (fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+
+		std::optional<uint64_t> stop()
+		{
+			uint64_t count;
+			if ((fd < 0) || (ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) != 0) ||
+			    (::read(fd, &count, sizeof(count)) != sizeof(count)))
+			{
+				return std::nullopt;
+			}
+			return count;
+		}
+	};
+
+	/**
+	 * Create a config from each document, read the hot fields of the
+	 * configs in a random order, and report the time and cache misses per
+	 * config.
+	 */
+	template<typename Config, typename MakeConfig>
+	void run(const char                     *name,
+	         const std::vector<std::string> &documents,
+	         MakeConfig                      factory)
+	{
+		std::vector<Config> configs;
+		configs.reserve(documents.size());
+		for (auto &doc : documents)
+		{
+			auto *p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+			ucl_parser_add_string(p, doc.data(), doc.size());
+			auto *obj = ucl_parser_get_object(p);
+			ucl_parser_free(p);
+			configs.push_back(std::get<Config>(factory(obj, false)));
+			ucl_object_unref(obj);
+		}
+		std::vector<size_t> order(configs.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), std::mt19937(42));
+		PerfCounter cacheMisses(PERF_TYPE_HARDWARE,
+		                        PERF_COUNT_HW_CACHE_MISSES);
+		PerfCounter l1Misses(PERF_TYPE_HW_CACHE,
+		                     PERF_COUNT_HW_CACHE_L1D |
+		                       (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+		uint64_t sum = 0;
+		cacheMisses.start();
+		l1Misses.start();
+		auto start = Clock::now();
+		for (size_t pass = 0; pass < Passes; pass++)
+		{
+			for (size_t i : order)
+			{
+				sum += read_hot_fields(configs[i]);
+			}
+		}
+		auto   end      = Clock::now();
+		auto   llc      = cacheMisses.stop();
+		auto   l1       = l1Misses.stop();
+		double accesses = static_cast<double>(Passes * order.size());
+		std::cout << name << ": "
+		          << std::chrono::duration<double, std::nano>(end - start)
+		                 .count() /
+		               accesses
+		          << " ns/config";
+		if (l1 && llc)
+		{
+			std::cout << ", " << *l1 / accesses << " L1D misses/config, "
+			          << *llc / accesses << " LLC misses/config";
+		}
+		else
+		{
+			std::cout << ", cache miss counters unavailable";
+		}
+		std::cout << " (checksum " << sum << ")\n";
+	}
+} // namespace
+
+int main()
+{
+	std::vector<std::string> documents;
+	for (size_t i = 0; i < ConfigCount; i++)
+	{
+		documents.push_back(make_document(i));
+	}
+	std::cout << "sizeof(Config): schema order "
+	          << sizeof(schema_order::Config) << " bytes, profiled "
+	          << sizeof(profiled::Config) << " bytes inline\n";
+	run<lazy::Config>("UCL lookups", documents, lazy::make_config);
+	run<schema_order::Config>(
+	  "Materialized, schema order", documents, schema_order::make_config);
+	run<profiled::Config>(
+	  "Materialized, profiled", documents, profiled::make_config);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+# Written by Config::write_access_profile after a run of the request
+# handler that bench_layout models.
+field000 0
+field001 0
+field002 0
+field003 20000
+field004 0
+field005 0
+field006 0
+field007 4000000
+field008 0
+field009 0
+field010 0
+field011 0
+field012 0
+field013 0
+field014 0
+field015 0
+field016 0
+field017 0
+field018 0
+field019 0
+field020 0
+field021 0
+field022 0
+field023 0
+field024 0
+field025 0
+field026 0
+field027 0
+field028 0
+field029 0
+field030 0
+field031 0
+field032 0
+field033 4000000
+field034 0
+field035 0
+field036 0
+field037 0
+field038 0
+field039 0
+field040 0
+field041 0
+field042 0
+field043 0
+field044 0
+field045 0
+field046 0
+field047 0
+field048 0
+field049 0
+field050 0
+field051 0
+field052 0
+field053 0
+field054 0
+field055 0
+field056 0
+field057 0
+field058 4000000
+field059 0
+field060 0
+field061 0
+field062 0
+field063 0
+field064 20000
+field065 0
+field066 0
+field067 0
+field068 0
+field069 0
+field070 0
+field071 0
+field072 0
+field073 0
+field074 0
+field075 0
+field076 0
+field077 0
+field078 0
+field079 0
+field080 0
+field081 0
+field082 0
+field083 0
+field084 0
+field085 0
+field086 0
+field087 0
+field088 0
+field089 0
+field090 0
+field091 4000000
+field092 0
+field093 0
+field094 0
+field095 0
+field096 0
+field097 0
+field098 0
+field099 0
+field100 0
+field101 0
+field102 0
+field103 0
+field104 0
+field105 0
+field106 0
+field107 0
+field108 0
+field109 0
+field110 0
+field111 0
+field112 0
+field113 0
+field114 0
+field115 0
+field116 0
+field117 0
+field118 0
+field119 0
+field120 4000000
+field121 0
+field122 0
+field123 0
+field124 0
+field125 0
+field126 0
+field127 0
+field128 0
+field129 0
+field130 0
+field131 0
+field132 0
+field133 0
+field134 0
+field135 0
+field136 0
+field137 0
+field138 0
+field139 0
+field140 0
+field141 0
+field142 0
+field143 0
+field144 0
+field145 4000000
+field146 0
+field147 0
+field148 0
+field149 0
+field150 20000
+field151 0
+field152 0
+field153 0
+field154 0
+field155 0
+field156 0
+field157 0
+field158 0
+field159 0
+field160 0
+field161 0
+field162 0
+field163 0
+field164 0
+field165 0
+field166 0
+field167 0
+field168 0
+field169 0
+field170 0
+field171 0
+field172 0
+field173 0
+field174 0
+field175 0
+field176 4000000
+field177 0
+field178 0
+field179 0
+field180 0
+field181 0
+field182 0
+field183 0
+field184 0
+field185 0
+field186 0
+field187 0
+field188 0
+field189 0
+field190 0
+field191 0
+field192 0
+field193 0
+field194 0
+field195 0
+field196 0
+field197 0
+field198 4000000
+field199 0
@@ -0,0 +1,145 @@
+// Compares longest-prefix-match lookups in a generated `PrefixTrie` against
+// a linear scan of the array of CIDR strings through a `Range`.
+#include "bench_prefix_trie.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace config::detail;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	/**
+	 * Generate a config with `count` random IPv4 prefixes.
+	 */
+	std::string make_document(size_t count, std::mt19937 &rng)
+	{
+		std::string doc = "allow = [";
+		for (size_t i = 0; i < count; i++)
+		{
+			unsigned length = 8 + rng() % 25;
+			uint32_t address =
+			  static_cast<uint32_t>(rng()) & ~((1ULL << (32 - length)) - 1);
+			doc += '"';
+			doc += std::to_string(address >> 24) + '.' +
+			       std::to_string((address >> 16) & 0xff) + '.' +
+			       std::to_string((address >> 8) & 0xff) + '.' +
+			       std::to_string(address & 0xff) + '/' +
+			       std::to_string(length);
+			doc += "\",";
+		}
+		doc += "];\n";
+		return doc;
+	}
+
+	/**
+	 * Longest-prefix match by scanning the array and parsing every element.
+	 */
+	std::optional<size_t> linear_lookup(const ucl_object_t *array,
+	                                    const IPAddress &   a)
+	{
+		std::optional<size_t> best;
+		unsigned              bestLength = 0;
+		size_t                index      = 0;
+		for (std::string_view str :
+		     Range<std::string_view, StringViewAdaptor>(array))
+		{
+			auto prefix = formats::CIDR::parse(str);
+			if (prefix && prefix->contains(a) &&
+			    (!best || (prefix->length > bestLength)))
+			{
+				best       = index;
+				bestLength = prefix->length;
+			}
+			index++;
+		}
+		return best;
+	}
+
+	/**
+	 * Returns the mean time in nanoseconds of calling `f` on each of the
+	 * addresses.  The results are checksummed to stop the compiler from
+	 * discarding the lookups.
+	 */
+	template<typename F>
+	double time_lookups(const std::vector<IPAddress> &addresses,
+	                    size_t &                      checksum,
+	                    F &&                          f)
+	{
+		auto start = Clock::now();
+		for (auto &a : addresses)
+		{
+			checksum += f(a).value_or(0);
+		}
+		std::chrono::duration<double, std::nano> elapsed =
+		  Clock::now() - start;
+		return elapsed.count() / addresses.size();
+	}
+} // namespace
+
+int main()
+{
+	std::mt19937 rng(42);
+	for (size_t count : {100, 10000, 1000000})
+	{
+		std::string doc        = make_document(count, rng);
+		auto        parseStart = Clock::now();
+		auto       *p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+		ucl_parser_add_string(p, doc.data(), doc.size());
+		auto *obj = ucl_parser_get_object(p);
+		ucl_parser_free(p);
+		auto configStart = Clock::now();
+		auto conf        = std::get<Config>(make_config(obj));
+		auto configEnd   = Clock::now();
+		auto trie        = conf.allow();
+		auto array       = ucl_object_lookup(obj, "allow");
+
+		// Keep the number of elements visited by the linear scan bounded.
+		size_t linearCount =
+		  std::min<size_t>(std::max<size_t>(10, 10000000 / count), 1000000);
+		std::vector<IPAddress> addresses(linearCount);
+		std::vector<IPAddress> trieAddresses(1000000);
+		for (auto *set : {&addresses, &trieAddresses})
+		{
+			for (auto &a : *set)
+			{
+				uint32_t value = rng();
+				a.family       = AF_INET;
+				for (int i = 0; i < 4; i++)
+				{
+					a.bytes[i] = value >> (24 - i * 8);
+				}
+			}
+		}
+		for (auto &a : addresses)
+		{
+			if (trie.lookup(a) != linear_lookup(array, a))
+			{
+				std::cerr << "Mismatch between trie and linear scan\n";
+				return EXIT_FAILURE;
+			}
+		}
+		size_t checksum = 0;
+		double trieNs =
+		  time_lookups(trieAddresses, checksum, [&](const IPAddress &a) {
+			  return trie.lookup(a);
+		  });
+		double linearNs =
+		  time_lookups(addresses, checksum, [&](const IPAddress &a) {
+			  return linear_lookup(array, a);
+		  });
+		std::chrono::duration<double, std::milli> parseMs =
+		  configStart - parseStart;
+		std::chrono::duration<double, std::milli> configMs =
+		  configEnd - configStart;
+		std::cout << count << " prefixes: parse " << parseMs.count()
+		          << " ms, make_config (validate + build trie) "
+		          << configMs.count() << " ms, trie lookup " << trieNs
+		          << " ns, linear scan " << linearNs << " ns (checksum "
+		          << checksum << ")\n";
+		ucl_object_unref(obj);
+	}
+	return EXIT_SUCCESS;
+}
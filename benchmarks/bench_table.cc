@@ -0,0 +1,161 @@
+// Compares reading every field of a config generated from a 200-field schema
+// with per-accessor lookups and with `--table-driven`, in which the accessors
+// call one generic decoder.  The code size of each variant is the size of its
+// `read_all_fields` function, which can be seen with
+// `nm -CS --size-sort bench_table | grep read_all_fields`.
+#define CONFIG_NAMESPACE_BEGIN                                                 \
+	namespace inlined                                                          \
+	{
+#define CONFIG_NAMESPACE_END }
+#include "bench_table_inlined.h"
+#undef CONFIG_NAMESPACE_BEGIN
+#define CONFIG_NAMESPACE_BEGIN                                                 \
+	namespace table                                                            \
+	{
+#include "bench_table_table.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	/**
+	 * The number of configs.
+	 */
+	constexpr size_t ConfigCount = 64;
+
+	/**
+	 * The number of passes over all of the configs.
+	 */
+	constexpr size_t Passes = 200;
+
+	/**
+	 * Generate a config in which every field is set.
+	 */
+	std::string make_document(size_t seed)
+	{
+		std::string doc;
+		for (size_t i = 0; i < 200; i++)
+		{
+			char name[16];
+			snprintf(name, sizeof(name), "field%03zu = ", i);
+			doc += name;
+			auto n = std::to_string((seed * 31 + i) % 1000);
+			switch (i % 4)
+			{
+				case 0:
+					doc += n;
+					break;
+				case 1:
+					doc += n + ".5";
+					break;
+				case 2:
+					doc += (seed + i) % 2 ? "true" : "false";
+					break;
+				case 3:
+					doc += "\"value " + n + "\"";
+					break;
+			}
+			doc += ";\n";
+		}
+		return doc;
+	}
+
+	/**
+	 * Returns the name of the property `field<I>`.
+	 */
+	template<size_t I>
+	constexpr config::detail::StringLiteral<9> field_name()
+	{
+		const char name[9] = {'f',
+		                      'i',
+		                      'e',
+		                      'l',
+		                      'd',
+		                      static_cast<char>('0' + I / 100),
+		                      static_cast<char>('0' + I / 10 % 10),
+		                      static_cast<char>('0' + I % 10),
+		                      '\0'};
+		return name;
+	}
+
+	/**
+	 * Read every field of `conf`.  Not inlined, so that each variant's code
+	 * size can be measured.
+	 */
+	template<typename Config>
+	[[gnu::noinline]] uint64_t read_all_fields(const Config &conf)
+	{
+		uint64_t sum  = 0;
+		auto     read = [&](auto value) {
+			if constexpr (std::is_same_v<decltype(value), std::string_view>)
+			{
+				sum += value.size();
+			}
+			else
+			{
+				sum += static_cast<uint64_t>(value);
+			}
+		};
+		[&]<size_t... I>(std::index_sequence<I...>)
+		{
+			(read(conf.template get<field_name<I>()>()), ...);
+		}
+		(std::make_index_sequence<200>());
+		return sum;
+	}
+
+	/**
+	 * Create a config from each document, read every field of each config,
+	 * and report the time per field.
+	 */
+	template<typename Config, typename MakeConfig>
+	void run(const char                     *name,
+	         const std::vector<std::string> &documents,
+	         MakeConfig                      factory)
+	{
+		std::vector<Config> configs;
+		configs.reserve(documents.size());
+		for (auto &doc : documents)
+		{
+			auto *p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+			ucl_parser_add_string(p, doc.data(), doc.size());
+			auto *obj = ucl_parser_get_object(p);
+			ucl_parser_free(p);
+			configs.push_back(std::get<Config>(factory(obj, false)));
+			ucl_object_unref(obj);
+		}
+		uint64_t sum   = 0;
+		auto     start = Clock::now();
+		for (size_t pass = 0; pass < Passes; pass++)
+		{
+			for (auto &conf : configs)
+			{
+				sum += read_all_fields(conf);
+			}
+		}
+		auto end = Clock::now();
+		std::cout << name << ": "
+		          << std::chrono::duration<double, std::nano>(end - start)
+		                 .count() /
+		               static_cast<double>(Passes * configs.size() * 200)
+		          << " ns/field (checksum " << sum << ")\n";
+	}
+} // namespace
+
+int main()
+{
+	std::vector<std::string> documents;
+	for (size_t i = 0; i < ConfigCount; i++)
+	{
+		documents.push_back(make_document(i));
+	}
+	run<inlined::Config>("Inlined accessors", documents, inlined::make_config);
+	run<table::Config>("Table-driven", documents, table::make_config);
+	return EXIT_SUCCESS;
+}
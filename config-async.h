@@ -0,0 +1,532 @@
+// Copyright David Chisnall
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "config-generic.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace CONFIG_DETAIL_NAMESPACE
+{
+	/**
+	 * A flag that can be used to cancel an asynchronous load.  Copies share
+	 * the same flag.  Cancellation is cooperative: the load checks the flag
+	 * between steps and completes with an error once it sees that it is set.
+	 */
+	class CancellationToken
+	{
+		/**
+		 * The shared flag.
+		 */
+		std::shared_ptr<std::atomic<bool>> flag =
+		  std::make_shared<std::atomic<bool>>(false);
+
+		public:
+		/**
+		 * Request cancellation of any load that uses this token.
+		 */
+		void cancel()
+		{
+			flag->store(true, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Returns true if cancellation has been requested.
+		 */
+		bool cancelled() const
+		{
+			return flag->load(std::memory_order_relaxed);
+		}
+	};
+
+	/**
+	 * A fixed-size pool of threads that runs the blocking parts of
+	 * asynchronous loads.  The destructor runs any tasks that are still
+	 * queued and then joins the threads.
+	 */
+	class WorkerPool
+	{
+		/**
+		 * Protects `queue` and `stopping`.
+		 */
+		std::mutex lock;
+
+		/**
+		 * Signalled when a task is queued or the pool is stopping.
+		 */
+		std::condition_variable wake;
+
+		/**
+		 * Tasks that have not yet started.
+		 */
+		std::deque<std::function<void()>> queue;
+
+		/**
+		 * Set by the destructor to tell the threads to exit once the queue is
+		 * empty.
+		 */
+		bool stopping = false;
+
+		/**
+		 * The worker threads.
+		 */
+		std::vector<std::thread> threads;
+
+		/**
+		 * The body of each worker thread.
+		 */
+		void run()
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (true)
+			{
+				wake.wait(guard, [&]() { return stopping || !queue.empty(); });
+				if (queue.empty())
+				{
+					return;
+				}
+				auto task = std::move(queue.front());
+				queue.pop_front();
+				guard.unlock();
+				task();
+				guard.lock();
+			}
+		}
+
+		public:
+		/**
+		 * Create a pool with `threadCount` threads.
+		 */
+		WorkerPool(unsigned threadCount = std::max(
+		             1U,
+		             std::thread::hardware_concurrency()))
+		{
+			for (unsigned i = 0; i < threadCount; i++)
+			{
+				threads.emplace_back([this]() { run(); });
+			}
+		}
+
+		WorkerPool(const WorkerPool &) = delete;
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (auto &thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		/**
+		 * Run `task` on one of the worker threads.
+		 */
+		void post(std::function<void()> task)
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				queue.push_back(std::move(task));
+			}
+			wake.notify_one();
+		}
+	};
+
+	/**
+	 * Returns the pool that reads and parses files for asynchronous loads
+	 * that are not given a pool, so that they never block the caller's
+	 * executor.  It has a single thread, which is started on first use.
+	 */
+	inline WorkerPool &parse_pool()
+	{
+		static WorkerPool pool(1);
+		return pool;
+	}
+
+	/**
+	 * Options for `make_config_async`.
+	 */
+	struct AsyncOptions
+	{
+		/**
+		 * The pool to run the load on.  If this is null then the file is
+		 * read and parsed on the thread of `parse_pool`, and then validated
+		 * on the caller's executor in steps that each validate at most
+		 * `chunkSize` top-level properties, first against the schema and
+		 * then with the generated checks, so that other work on the event
+		 * loop can interleave with it.
+		 */
+		WorkerPool *pool = nullptr;
+
+		/**
+		 * A token that can be used to cancel the load.
+		 */
+		CancellationToken token;
+
+		/**
+		 * The number of top-level properties to validate, or generated
+		 * checks to run, in each step when there is no pool.
+		 */
+		size_t chunkSize = 1;
+
+		/**
+		 * Remove properties that are not in the schema once the config is
+		 * valid.
+		 */
+		bool compact = false;
+	};
+
+	/**
+	 * The awaitable returned by `make_config_async`.  The coroutine that
+	 * awaits it is always resumed from `executor.post`, so `Executor` can be
+	 * any type with a `post` method that queues a callable to run on the
+	 * event loop.  The file is always read and parsed on another thread,
+	 * which then calls `executor.post`, so `post` must be safe to call from
+	 * any thread.
+	 */
+	template<typename Config, typename Executor>
+	class AsyncConfigLoad
+	{
+		/**
+		 * The result of the load.
+		 */
+		using Result = std::variant<Config, ucl_schema_error>;
+
+		/**
+		 * The state of a load.  This is shared between the awaitable and the
+		 * tasks that it posts, so that it outlives whichever finishes last.
+		 */
+		struct State
+		{
+			/**
+			 * The steps of the load, in order.
+			 */
+			enum Step
+			{
+				Parse,
+				Validate,
+				ValidateProperties,
+				ValidateGenerated,
+				Create,
+			};
+
+			/**
+			 * The schema to validate against.
+			 */
+			const ucl_object_t *schema;
+
+			/**
+			 * The generated checks, and the function that creates the
+			 * config.
+			 */
+			ValidationSteps<Config> steps;
+
+			/**
+			 * The file to load.
+			 */
+			std::string path;
+
+			/**
+			 * The executor that the awaiting coroutine is resumed on.
+			 */
+			Executor &executor;
+
+			/**
+			 * The options for this load.
+			 */
+			AsyncOptions options;
+
+			/**
+			 * The next step to run.
+			 */
+			Step step = Parse;
+
+			/**
+			 * The parsed document.
+			 */
+			UCLPtr obj{};
+
+			/**
+			 * The top-level properties that still need validating, with
+			 * their schemas, when validating in chunks.
+			 */
+			std::vector<std::pair<const ucl_object_t *, const ucl_object_t *>>
+			  properties{};
+
+			/**
+			 * The number of entries in `properties` that have been
+			 * validated.
+			 */
+			size_t validated = 0;
+
+			/**
+			 * The number of generated checks that have passed.
+			 */
+			size_t checked = 0;
+
+			/**
+			 * The values derived by the generated checks.
+			 */
+			std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+
+			/**
+			 * The result, once the load has finished.
+			 */
+			std::optional<Result> result{};
+
+			/**
+			 * Finish the load with an error.
+			 */
+			void fail(ucl_schema_error_code code, const char *message)
+			{
+				ucl_schema_error err{};
+				err.code = code;
+				snprintf(err.msg, sizeof(err.msg), "%s", message);
+				result = err;
+			}
+
+			/**
+			 * Check the document against the schema with the schemas of the
+			 * top-level properties replaced by empty schemas, and collect the
+			 * properties so that they can be validated in later steps.
+			 */
+			bool validate_shallow(ucl_schema_error *err)
+			{
+				const ucl_object_t *subschemas =
+				  ucl_object_lookup(schema, "properties");
+				if (subschemas == nullptr)
+				{
+					return ucl_object_validate(schema, obj, err);
+				}
+				UCLPtr shallow{ucl_object_copy(schema)};
+				// The `UCLPtr` holds its own reference.
+				ucl_object_unref(shallow);
+				auto *shallowSubschemas = const_cast<ucl_object_t *>(
+				  ucl_object_lookup(shallow, "properties"));
+				ucl_object_iter_t   it = nullptr;
+				const ucl_object_t *subschema;
+				while ((subschema = ucl_object_iterate(subschemas, &it, true)))
+				{
+					const char *key = ucl_object_key(subschema);
+					ucl_object_replace_key(shallowSubschemas,
+					                       ucl_object_typed_new(UCL_OBJECT),
+					                       key,
+					                       0,
+					                       true);
+					if (auto *value = ucl_object_lookup(obj, key))
+					{
+						properties.emplace_back(subschema, value);
+					}
+				}
+				return ucl_object_validate(shallow, obj, err);
+			}
+
+			/**
+			 * Run the next step.  If `chunked` is false then the whole
+			 * document is validated against the schema in one step and by
+			 * the generated checks in another.  Returns true once the load
+			 * has finished.
+			 */
+			bool advance(bool chunked)
+			{
+				if (options.token.cancelled())
+				{
+					fail(UCL_SCHEMA_UNKNOWN, "cancelled");
+					return true;
+				}
+				ucl_schema_error err{};
+				switch (step)
+				{
+					case Parse:
+					{
+						auto *p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+						ucl_parser_add_file(p, path.c_str());
+						if (const char *error = ucl_parser_get_error(p))
+						{
+							fail(UCL_SCHEMA_UNKNOWN, error);
+							ucl_parser_free(p);
+							return true;
+						}
+						obj = ucl_parser_get_object(p);
+						ucl_parser_free(p);
+						// The `UCLPtr` holds its own reference.
+						ucl_object_unref(obj);
+						step = Validate;
+						return false;
+					}
+					case Validate:
+					{
+						bool valid = chunked
+						               ? validate_shallow(&err)
+						               : ucl_object_validate(schema, obj, &err);
+						if (!valid)
+						{
+							result = err;
+							return true;
+						}
+						step = chunked ? ValidateProperties : ValidateGenerated;
+						return false;
+					}
+					case ValidateProperties:
+					{
+						size_t end =
+						  std::min(properties.size(),
+						           validated + std::max<size_t>(
+						                         options.chunkSize, 1));
+						for (; validated < end; validated++)
+						{
+							auto [subschema, value] = properties[validated];
+							if (!ucl_object_validate(subschema, value, &err))
+							{
+								result = err;
+								return true;
+							}
+						}
+						if (validated == properties.size())
+						{
+							step = ValidateGenerated;
+						}
+						return false;
+					}
+					case ValidateGenerated:
+					{
+						size_t end =
+						  chunked ? std::min(steps.count,
+						                     checked + std::max<size_t>(
+						                                 options.chunkSize, 1))
+						          : steps.count;
+						for (; checked < end; checked++)
+						{
+							if (!steps.run(checked, obj, &err, snapshot.get()))
+							{
+								result = err;
+								return true;
+							}
+						}
+						if (checked == steps.count)
+						{
+							step = Create;
+						}
+						return false;
+					}
+					case Create:
+						result = steps.create(
+						  obj, std::move(snapshot), options.compact);
+						return true;
+				}
+				return true;
+			}
+		};
+
+		/**
+		 * The state of this load.
+		 */
+		std::shared_ptr<State> state;
+
+		/**
+		 * Run the next step of `state` and then either resume `handle` or
+		 * queue the following step on the executor.
+		 */
+		static void step(std::shared_ptr<State>  state,
+		                 std::coroutine_handle<> handle)
+		{
+			if (state->advance(true))
+			{
+				handle.resume();
+				return;
+			}
+			state->executor.post([state, handle]() { step(state, handle); });
+		}
+
+		public:
+		/**
+		 * Constructor, does not start the load.
+		 */
+		AsyncConfigLoad(const ucl_object_t     *schema,
+		                ValidationSteps<Config> steps,
+		                std::string             path,
+		                Executor               &executor,
+		                AsyncOptions            options)
+		  : state(std::make_shared<State>(
+		      State{schema, steps, std::move(path), executor, options}))
+		{
+		}
+
+		/**
+		 * The load never completes synchronously.
+		 */
+		bool await_ready()
+		{
+			return false;
+		}
+
+		/**
+		 * Start the load.  This does no work on the calling thread.
+		 */
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			auto state = this->state;
+			if (WorkerPool *pool = state->options.pool)
+			{
+				pool->post([state, handle]() {
+					while (!state->advance(false)) {}
+					state->executor.post([handle]() { handle.resume(); });
+				});
+				return;
+			}
+			// Reading and parsing cannot be split into steps, so they run on
+			// the parse thread and only validation runs on the executor.
+			parse_pool().post([state, handle]() {
+				bool finished = state->advance(true);
+				state->executor.post([state, handle, finished]() {
+					if (finished)
+					{
+						handle.resume();
+						return;
+					}
+					step(state, handle);
+				});
+			});
+		}
+
+		/**
+		 * Returns the config, or the error that stopped the load.
+		 */
+		Result await_resume()
+		{
+			return std::move(*state->result);
+		}
+	};
+
+	template<typename Config, typename Executor, typename... Options>
+	auto async_make_config(const ucl_object_t     *schema,
+	                       ValidationSteps<Config> steps,
+	                       std::string             path,
+	                       Executor               &executor,
+	                       Options &&...options)
+	{
+		return AsyncConfigLoad<Config, Executor>(
+		  schema,
+		  steps,
+		  std::move(path),
+		  executor,
+		  AsyncOptions{std::forward<Options>(options)...});
+	}
+
+} // namespace CONFIG_DETAIL_NAMESPACE
@@ -1,12 +1,18 @@
 // Copyright David Chisnall
 // SPDX-License-Identifier: MIT
 #include "config-generic.h"
+#include <array>
+#include <bitset>
+#include <climits>
+#include <cmath>
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <unordered_set>
+#include <vector>
 
 using namespace config;
 using namespace config::detail;
@@ -20,6 +26,7 @@ namespace Schema
 	struct Boolean;
 	struct Number;
 	struct Duration;
+	struct Size;
 
 	/**
 	 * Base class for parts of a JSON Schema.
@@ -48,6 +55,7 @@ namespace Schema
 		                                     NamedType<"integer", Integer>,
 		                                     NamedType<"boolean", Boolean>,
 		                                     NamedType<"duration", Duration>,
+		                                     NamedType<"size", Size>,
 		                                     NamedType<"number", Number>>;
 
 		/**
@@ -93,6 +101,10 @@ namespace Schema
 			 * A duration in seconds.
 			 */
 			TypeDuration,
+			/**
+			 * A size in bytes.
+			 */
+			TypeSize,
 		};
 
 		/**
@@ -107,6 +119,7 @@ namespace Schema
 		                           Enum{"integer", TypeInteger},
 		                           Enum{"boolean", TypeBool},
 		                           Enum{"duration", TypeDuration},
+		                           Enum{"size", TypeSize},
 		                           Enum{"number", TypeNumber}>>;
 
 		/**
@@ -132,6 +145,33 @@ namespace Schema
 		{
 			return make_optional<StringViewAdaptor>(obj["description"]);
 		}
+
+		/**
+		 * The values that this schema accepts, if it has an `enum`.
+		 */
+		std::optional<Range<UCLPtr>> enumeration()
+		{
+			return make_optional<Range<UCLPtr>>(obj["enum"]);
+		}
+
+		/**
+		 * The only value that this schema accepts, if it has a `const` or an
+		 * `enum` with a single element, or null otherwise.
+		 */
+		const ucl_object_t *constant()
+		{
+			if (auto *value = ucl_object_lookup(obj, "const"))
+			{
+				return value;
+			}
+			auto *values = ucl_object_lookup(obj, "enum");
+			if ((ucl_object_type(values) == UCL_ARRAY) &&
+			    (ucl_array_find_index(values, 1) == nullptr))
+			{
+				return ucl_array_find_index(values, 0);
+			}
+			return nullptr;
+		}
 	};
 
 	/**
@@ -155,14 +195,105 @@ namespace Schema
 			// tuples are better represented as objects.
 			return SchemaBase(obj["items"]);
 		}
+
+		/**
+		 * Extension: if true, an array of CIDR strings is exposed as a
+		 * longest-prefix-match trie rather than as a range.
+		 */
+		bool prefixTrie()
+		{
+			return make_optional<BoolAdaptor, bool>(obj["x-prefix-trie"])
+			  .value_or(false);
+		}
+
+		/**
+		 * Extension: the name of a string property of the items that is used
+		 * as a unique key to look up items in an array of objects.
+		 */
+		std::optional<std::string_view> index()
+		{
+			return make_optional<StringViewAdaptor>(obj["x-index"]);
+		}
+
+		/**
+		 * The minimum number of items.
+		 */
+		std::optional<uint64_t> minItems()
+		{
+			return make_optional<UInt64Adaptor, uint64_t>(obj["minItems"]);
+		}
+
+		/**
+		 * The maximum number of items.
+		 */
+		std::optional<uint64_t> maxItems()
+		{
+			return make_optional<UInt64Adaptor, uint64_t>(obj["maxItems"]);
+		}
+
+		/**
+		 * Are the items required to be distinct?
+		 */
+		bool uniqueItems()
+		{
+			return make_optional<BoolAdaptor, bool>(obj["uniqueItems"])
+			  .value_or(false);
+		}
+
+		/**
+		 * The number of items, if `minItems` and `maxItems` require a fixed
+		 * number of at least one.
+		 */
+		std::optional<uint64_t> fixedLength()
+		{
+			auto min = minItems();
+			if (!min || (min != maxItems()) || (*min == 0))
+			{
+				return std::nullopt;
+			}
+			return min;
+		}
 	};
 
 	/**
-	 * A JSON schema string.  This is a trivial type.
+	 * A JSON schema string.  This can constrain the string with a regular
+	 * expression and describe its format.
 	 */
 	struct String : public SchemaBase
 	{
 		using SchemaBase::SchemaBase;
+
+		/**
+		 * The regular expression that valid strings must match.
+		 */
+		std::optional<std::string_view> pattern()
+		{
+			return make_optional<StringViewAdaptor>(obj["pattern"]);
+		}
+
+		/**
+		 * The semantic format of the string, for example `ipv4` or `uri`.
+		 */
+		std::optional<std::string_view> format()
+		{
+			return make_optional<StringViewAdaptor>(obj["format"]);
+		}
+
+		/**
+		 * The minimum length of the string, in code points.
+		 */
+		std::optional<uint64_t> minLength()
+		{
+			return make_optional<UInt64Adaptor, uint64_t>(obj["minLength"]);
+		}
+
+		/**
+		 * The maximum length of the string, in code points.
+		 */
+		std::optional<uint64_t> maxLength()
+		{
+			return make_optional<UInt64Adaptor, uint64_t>(obj["maxLength"]);
+		}
 	};
 
 	/**
@@ -229,6 +360,15 @@ namespace Schema
 		using Number::Number;
 	};
 
+	/**
+	 * A size in bytes, allows all of the constraints on integers.  Values may
+	 * be numbers or strings with a size suffix, such as `64kb`.
+	 */
+	struct Size : Number
+	{
+		using Number::Number;
+	};
+
 	/**
 	 * Boolean, a trivial type in JSON schema.
 	 */
@@ -270,6 +410,17 @@ namespace Schema
 			return make_optional<Range<std::string_view, StringViewAdaptor>>(
 			  obj["required"]);
 		}
+
+		/**
+		 * Returns true if `additionalProperties` is false, so valid objects
+		 * have only the properties in `properties`.
+		 */
+		bool closed()
+		{
+			UCLPtr additional = obj["additionalProperties"];
+			return (ucl_object_type(additional) == UCL_BOOLEAN) &&
+			       !ucl_object_toboolean(additional);
+		}
 	};
 
 	/**
@@ -304,159 +455,1848 @@ namespace Schema
 
 using namespace Schema;
 
-namespace
+/**
+ * Compiler from the regular expressions used in JSON Schema `pattern`
+ * properties to minimal DFAs.  This supports the subset of ECMA 262 regular
+ * expressions that is also valid POSIX extended syntax (which is what libucl
+ * uses) and can be matched without backtracking: literals, `.`, bracket
+ * expressions, the `\d`, `\w` and `\s` classes, groups, alternation, the
+ * greedy and lazy quantifiers and `^` / `$` anchors at the start and end of a
+ * top-level alternative.  Anything else (back references, look-around, word
+ * boundaries) is rejected and left for libucl to check at run time.
+ *
+ * Patterns are matched against UTF-8 bytes, with `.` and negated bracket
+ * expressions matching a complete, valid multi-byte sequence.  They follow
+ * POSIX extended syntax as libucl compiles it (without `REG_NEWLINE`), so `.`
+ * and negated bracket expressions match a newline, and `.` does not match
+ * NUL.  Overlong encodings, surrogates and code points above U+10FFFF are not
+ * characters, as in `utf8_length`.
+ */
+namespace Regex
 {
 	/**
-	 * The namespace for the helpers defined in `config-generic.h`.  This can
-	 * be overridden on the command line.
+	 * A set of input bytes.
 	 */
-	std::string configNamespace = "::config::detail::";
+	using ByteSet = std::bitset<256>;
 
-	template<typename T>
-	void emit_class(Object o, std::string_view name, T &out);
+	/**
+	 * Node in the abstract syntax tree for a regular expression.
+	 */
+	struct Node
+	{
+		/**
+		 * The kinds of node.
+		 */
+		enum Kind
+		{
+			/**
+			 * Matches the empty string.
+			 */
+			Empty,
+			/**
+			 * Matches a single byte from `bytes`.
+			 */
+			Bytes,
+			/**
+			 * Matches each of the children in sequence.
+			 */
+			Concat,
+			/**
+			 * Matches any one of the children.
+			 */
+			Alternate,
+			/**
+			 * Matches between `min` and `max` repetitions of the only child.
+			 */
+			Repeat,
+		} kind = Empty;
+
+		/**
+		 * The set of bytes that a `Bytes` node matches.
+		 */
+		ByteSet bytes;
+
+		/**
+		 * Children of compound nodes.
+		 */
+		std::vector<std::shared_ptr<Node>> children;
+
+		/**
+		 * The minimum number of repetitions for `Repeat` nodes.
+		 */
+		unsigned min = 0;
+
+		/**
+		 * The maximum number of repetitions for `Repeat` nodes, `Unbounded`
+		 * if there is no upper limit.
+		 */
+		unsigned max = 0;
+
+		/**
+		 * Value of `max` for unbounded repetition.
+		 */
+		static constexpr unsigned Unbounded = UINT_MAX;
+	};
+
+	using NodePtr = std::shared_ptr<Node>;
 
 	/**
-	 * Schema visitor.  This visits a schema and collects the information
-	 * required to provide the accessor for the described type.
+	 * Construct a node matching one byte from a set.
 	 */
-	class SchemaVisitor
+	NodePtr bytes(ByteSet set)
+	{
+		auto n   = std::make_shared<Node>();
+		n->kind  = Node::Bytes;
+		n->bytes = set;
+		return n;
+	}
+
+	/**
+	 * Construct a node matching one byte in the inclusive range `lo`-`hi`.
+	 */
+	NodePtr bytes(unsigned lo, unsigned hi)
+	{
+		ByteSet set;
+		for (unsigned i = lo; i <= hi; i++)
+		{
+			set.set(i);
+		}
+		return bytes(set);
+	}
+
+	/**
+	 * Construct a compound node.
+	 */
+	NodePtr compound(Node::Kind kind, std::vector<NodePtr> children)
+	{
+		auto n      = std::make_shared<Node>();
+		n->kind     = kind;
+		n->children = std::move(children);
+		return n;
+	}
+
+	/**
+	 * Construct a node that repeats `child` between `min` and `max` times.
+	 */
+	NodePtr repeat(NodePtr child, unsigned min, unsigned max)
+	{
+		auto n  = compound(Node::Repeat, {child});
+		n->min  = min;
+		n->max  = max;
+		return n;
+	}
+
+	/**
+	 * Construct a node that matches one valid UTF-8 encoded character.  ASCII
+	 * characters match only if they are in `ascii`.  The second byte of a
+	 * three- or four-byte sequence is restricted, as in the Unicode table of
+	 * well-formed sequences, to exclude overlong encodings, surrogates, and
+	 * code points above U+10FFFF.
+	 */
+	NodePtr utf8_character(ByteSet ascii)
+	{
+		auto continuation = [] { return bytes(0x80, 0xbf); };
+		auto sequence     = [&](NodePtr lead, NodePtr second, size_t rest) {
+			std::vector<NodePtr> parts{std::move(lead), std::move(second)};
+			for (size_t i = 0; i < rest; i++)
+			{
+				parts.push_back(continuation());
+			}
+			return compound(Node::Concat, std::move(parts));
+		};
+		return compound(
+		  Node::Alternate,
+		  {bytes(ascii),
+		   sequence(bytes(0xc2, 0xdf), continuation(), 0),
+		   sequence(bytes(0xe0, 0xe0), bytes(0xa0, 0xbf), 1),
+		   sequence(bytes(0xe1, 0xec), continuation(), 1),
+		   sequence(bytes(0xed, 0xed), bytes(0x80, 0x9f), 1),
+		   sequence(bytes(0xee, 0xef), continuation(), 1),
+		   sequence(bytes(0xf0, 0xf0), bytes(0x90, 0xbf), 2),
+		   sequence(bytes(0xf1, 0xf3), continuation(), 2),
+		   sequence(bytes(0xf4, 0xf4), bytes(0x80, 0x8f), 2)});
+	}
+
+	/**
+	 * Recursive-descent parser for regular expressions.  Produces an AST
+	 * that matches the pattern anywhere in the input, unless it is anchored.
+	 */
+	class Parser
 	{
-		public:
 		/**
-		 * The return type for the accessor for this schema.
+		 * The pattern being parsed.
 		 */
-		std::string returnType;
+		std::string_view pattern;
 
 		/**
-		 * The adaptor type to use for this schema.
+		 * The current position in `pattern`.
 		 */
-		std::string adaptor;
+		size_t pos = 0;
 
 		/**
-		 * The namespace in which the adaptor is defined.
+		 * Set to false if the pattern uses a feature that is not supported.
 		 */
-		std::string_view adaptorNamespace = configNamespace;
+		bool ok = true;
 
 		/**
-		 * The lifetime attribute for this property, if one is required.  For
-		 * strings, the returned `string_view` has a lifetime bound by the
-		 * underlying schema.  Other types are typically either owning
-		 * references or value types.
+		 * Nesting depth of groups.  Anchors are accepted only at depth 0.
 		 */
-		std::string_view lifetimeAttribute;
+		unsigned depth = 0;
 
 		/**
-		 * The name of this property.
+		 * Returns the next character without consuming it, or 0 at the end.
 		 */
-		std::string_view name;
+		char peek()
+		{
+			return pos < pattern.size() ? pattern[pos] : 0;
+		}
 
 		/**
-		 * Any new types that were declared to handle this property.
+		 * Returns true if the whole pattern has been consumed.
 		 */
-		std::stringstream &types;
+		bool at_end()
+		{
+			return pos >= pattern.size();
+		}
 
 		/**
-		 * Construct a schema visitor with a specified name, writing to an
-		 * output string stream.
+		 * Mark the pattern as unsupported.  Returns a node that matches the
+		 * empty string so that the caller can continue.
 		 */
-		SchemaVisitor(std::string_view n, std::stringstream &t)
-		  : name(n), types(t)
+		NodePtr fail()
 		{
+			ok  = false;
+			pos = pattern.size();
+			return std::make_shared<Node>();
 		}
 
 		/**
-		 * Handle a number.  This is common code for all of the number
-		 * subclasses.  It provides an adaptor that is the smallest type that
-		 * satisfies all of the constraints.
+		 * Parse a decimal number for a bounded repetition.
 		 */
-		void handleNumber(Number &num, bool isInteger)
+		std::optional<unsigned> number()
 		{
-			if (!isInteger)
+			unsigned value  = 0;
+			bool     digits = false;
+			while (isdigit(static_cast<unsigned char>(peek())))
 			{
-				auto multipleOf = num.multipleOf();
-				if (multipleOf)
+				value  = value * 10 + (pattern[pos++] - '0');
+				digits = true;
+				if (value > 1000)
 				{
-					isInteger =
-					  (((double)(uint64_t)*multipleOf) == *multipleOf);
+					return std::nullopt;
 				}
 			}
-			if (!isInteger)
+			if (!digits)
 			{
-				returnType = "double";
-				adaptor    = "DoubleAdaptor";
-				return;
+				return std::nullopt;
 			}
-			int64_t min = std::numeric_limits<int64_t>::min();
-			int64_t max = std::numeric_limits<int64_t>::max();
-			min =
-			  std::max(min, static_cast<int64_t>(num.minimum().value_or(min)));
-			min = std::max(
-			  min, static_cast<int64_t>(num.exclusiveMinimum().value_or(min)));
-			max =
-			  std::min(max, static_cast<int64_t>(num.maximum().value_or(max)));
-			max = std::min(
-			  max, static_cast<int64_t>(num.exclusiveMaximum().value_or(max)));
-			auto try_type =
-			  [&](auto intty, std::string_view ty, std::string_view a) {
-				  if ((min >= std::numeric_limits<decltype(intty)>::min()) &&
-				      (max <= std::numeric_limits<decltype(intty)>::max()))
-				  {
-					  returnType = ty;
-					  adaptor    = a;
-				  }
-			  };
-			try_type(int64_t(), "int64_t", "Int64Adaptor");
-			try_type(uint64_t(), "uint64_t", "UInt64Adaptor");
-			try_type(int32_t(), "int32_t", "Int32Adaptor");
-			try_type(uint32_t(), "uint32_t", "UInt32Adaptor");
-			try_type(int16_t(), "int16_t", "Int16Adaptor");
-			try_type(uint16_t(), "uint16_t", "UInt16Adaptor");
-			try_type(int8_t(), "int8_t", "Int8Adaptor");
-			try_type(uint8_t(), "uint8_t", "UInt8Adaptor");
+			return value;
 		}
 
 		/**
-		 * Handle a string schema.
+		 * Parse `count` hex digits.
 		 */
-		void operator()(String)
+		std::optional<unsigned> hex(size_t count)
 		{
-			returnType        = "std::string_view";
-			adaptor           = "StringViewAdaptor";
-			lifetimeAttribute = "CONFIG_LIFETIME_BOUND";
+			if (pos + count > pattern.size())
+			{
+				return std::nullopt;
+			}
+			unsigned value = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				unsigned char c = pattern[pos++];
+				if (!isxdigit(c))
+				{
+					return std::nullopt;
+				}
+				value = value * 16 +
+				        (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+			}
+			return value;
 		}
 
 		/**
-		 * Handle a boolean schema.
+		 * Returns the set of bytes for a class escape (`\d`, `\w`, `\s`, or
+		 * their negations), or nothing if `c` is not a class escape.  The
+		 * negated flag is set for the upper-case forms.
 		 */
-		void operator()(Boolean)
+		static std::optional<ByteSet> class_escape(unsigned char c,
+		                                           bool          &negated)
 		{
-			returnType = "bool";
-			adaptor    = "BoolAdaptor";
+			ByteSet set;
+			negated = isupper(c);
+			switch (tolower(c))
+			{
+				case 'd':
+					for (char i = '0'; i <= '9'; i++)
+					{
+						set.set(i);
+					}
+					return set;
+				case 'w':
+					for (unsigned i = 0; i < 128; i++)
+					{
+						if (isalnum(i) || (i == '_'))
+						{
+							set.set(i);
+						}
+					}
+					return set;
+				case 's':
+					for (char i : {' ', '\t', '\n', '\r', '\f', '\v'})
+					{
+						set.set(i);
+					}
+					return set;
+			}
+			return std::nullopt;
 		}
 
 		/**
-		 * Handle an integer schema.
+		 * Parse a single-character escape (after the backslash).  Returns the
+		 * code point, or nothing if this is not a supported escape.
 		 */
-		void operator()(Integer i)
+		std::optional<unsigned> character_escape()
 		{
-			handleNumber(i, true);
+			unsigned char c = pattern[pos++];
+			switch (c)
+			{
+				case 't':
+					return '\t';
+				case 'n':
+					return '\n';
+				case 'r':
+					return '\r';
+				case 'f':
+					return '\f';
+				case 'v':
+					return '\v';
+				case 'x':
+					return hex(2);
+				case 'u':
+					return hex(4);
+			}
+			if (ispunct(c))
+			{
+				return c;
+			}
+			return std::nullopt;
 		}
 
 		/**
-		 * Handle a duration.
+		 * Returns a node matching the UTF-8 encoding of a code point.
 		 */
-		void operator()(Duration d)
+		static NodePtr code_point(unsigned c)
 		{
-			// Find the numeric type that satisfies the constraints.
-			handleNumber(d, false);
-			// Wrap the number type to give a duration.
-			std::string type = returnType;
-			adaptor          = "DurationAdaptor<";
-			adaptor += type;
-			adaptor += '>';
-			returnType = "std::chrono::duration<";
-			returnType += type;
-			returnType += '>';
+			std::vector<unsigned> encoded;
+			if (c < 0x80)
+			{
+				encoded = {c};
+			}
+			else if (c < 0x800)
+			{
+				encoded = {0xc0 | (c >> 6), 0x80 | (c & 0x3f)};
+			}
+			else
+			{
+				encoded = {0xe0 | (c >> 12),
+				           0x80 | ((c >> 6) & 0x3f),
+				           0x80 | (c & 0x3f)};
+			}
+			std::vector<NodePtr> nodes;
+			for (unsigned b : encoded)
+			{
+				nodes.push_back(bytes(b, b));
+			}
+			return compound(Node::Concat, std::move(nodes));
+		}
+
+		/**
+		 * Parse a bracket expression, after the opening `[`.  Only ASCII
+		 * members are supported.
+		 */
+		NodePtr bracket()
+		{
+			ByteSet set;
+			bool    negated = false;
+			if (peek() == '^')
+			{
+				negated = true;
+				pos++;
+			}
+			bool first = true;
+			while (!at_end() && ((peek() != ']') || first))
+			{
+				first = false;
+				unsigned lo;
+				char     c = pattern[pos++];
+				if (c == '\\')
+				{
+					if (at_end())
+					{
+						return fail();
+					}
+					bool negatedEscape;
+					if (auto escaped = class_escape(peek(), negatedEscape))
+					{
+						pos++;
+						if (negatedEscape)
+						{
+							// Negated escapes inside brackets would also
+							// need to match non-ASCII characters.
+							return fail();
+						}
+						set |= *escaped;
+						continue;
+					}
+					auto escaped = character_escape();
+					if (!escaped)
+					{
+						return fail();
+					}
+					lo = *escaped;
+				}
+				else if (c == '[')
+				{
+					// POSIX character classes are not supported.
+					return fail();
+				}
+				else
+				{
+					lo = static_cast<unsigned char>(c);
+				}
+				unsigned hi = lo;
+				if ((peek() == '-') && (pos + 1 < pattern.size()) &&
+				    (pattern[pos + 1] != ']'))
+				{
+					pos++;
+					c = pattern[pos++];
+					if (c == '\\')
+					{
+						auto escaped = character_escape();
+						if (!escaped)
+						{
+							return fail();
+						}
+						hi = *escaped;
+					}
+					else
+					{
+						hi = static_cast<unsigned char>(c);
+					}
+				}
+				if ((hi >= 0x80) || (lo > hi))
+				{
+					return fail();
+				}
+				for (unsigned i = lo; i <= hi; i++)
+				{
+					set.set(i);
+				}
+			}
+			if (at_end())
+			{
+				return fail();
+			}
+			pos++;
+			if (negated)
+			{
+				ByteSet ascii;
+				for (unsigned i = 0; i < 128; i++)
+				{
+					ascii.set(i);
+				}
+				return utf8_character(ascii & ~set);
+			}
+			return bytes(set);
+		}
+
+		/**
+		 * Parse an atom: a literal, class, group, or escape.
+		 */
+		NodePtr atom()
+		{
+			char c = pattern[pos++];
+			switch (c)
+			{
+				case '(':
+				{
+					if (peek() == '?')
+					{
+						if ((pos + 1 < pattern.size()) &&
+						    (pattern[pos + 1] == ':'))
+						{
+							pos += 2;
+						}
+						else
+						{
+							return fail();
+						}
+					}
+					depth++;
+					auto inner = alternation();
+					depth--;
+					if (peek() != ')')
+					{
+						return fail();
+					}
+					pos++;
+					return inner;
+				}
+				case '[':
+					return bracket();
+				case '.':
+				{
+					ByteSet ascii;
+					for (unsigned i = 0; i < 128; i++)
+					{
+						ascii.set(i);
+					}
+					// POSIX `.` matches a newline but not NUL.
+					ascii.reset(0);
+					return utf8_character(ascii);
+				}
+				case '\\':
+				{
+					if (at_end())
+					{
+						return fail();
+					}
+					bool negated;
+					if (auto set = class_escape(peek(), negated))
+					{
+						pos++;
+						if (negated)
+						{
+							ByteSet ascii;
+							for (unsigned i = 0; i < 128; i++)
+							{
+								ascii.set(i);
+							}
+							return utf8_character(ascii & ~*set);
+						}
+						return bytes(*set);
+					}
+					auto escaped = character_escape();
+					if (!escaped)
+					{
+						return fail();
+					}
+					return code_point(*escaped);
+				}
+				case '*':
+				case '+':
+				case '?':
+				case '^':
+				case '$':
+				case ')':
+				case '|':
+					return fail();
+			}
+			unsigned char byte = c;
+			// Keep multi-byte UTF-8 sequences together so that quantifiers
+			// apply to the whole character.
+			if (byte >= 0xc0)
+			{
+				std::vector<NodePtr> sequence{bytes(byte, byte)};
+				while ((static_cast<unsigned char>(peek()) & 0xc0) == 0x80)
+				{
+					byte = pattern[pos++];
+					sequence.push_back(bytes(byte, byte));
+				}
+				return compound(Node::Concat, std::move(sequence));
+			}
+			return bytes(byte, byte);
+		}
+
+		/**
+		 * Parse any quantifiers following an atom.
+		 */
+		NodePtr quantified(NodePtr node)
+		{
+			while (!at_end())
+			{
+				unsigned min, max;
+				switch (peek())
+				{
+					case '*':
+						min = 0;
+						max = Node::Unbounded;
+						pos++;
+						break;
+					case '+':
+						min = 1;
+						max = Node::Unbounded;
+						pos++;
+						break;
+					case '?':
+						min = 0;
+						max = 1;
+						pos++;
+						break;
+					case '{':
+					{
+						pos++;
+						auto lo = number();
+						if (!lo)
+						{
+							return fail();
+						}
+						min = max = *lo;
+						if (peek() == ',')
+						{
+							pos++;
+							max = Node::Unbounded;
+							if (peek() != '}')
+							{
+								auto hi = number();
+								if (!hi || (*hi < min))
+								{
+									return fail();
+								}
+								max = *hi;
+							}
+						}
+						if (peek() != '}')
+						{
+							return fail();
+						}
+						pos++;
+						break;
+					}
+					default:
+						return node;
+				}
+				// Lazy quantifiers match the same language.
+				if (peek() == '?')
+				{
+					pos++;
+				}
+				node = repeat(node, min, max);
+			}
+			return node;
+		}
+
+		/**
+		 * Parse a sequence of quantified atoms, up to the end of the
+		 * enclosing alternative.  At the top level, this handles anchors and
+		 * makes the sequence match anywhere in the input unless anchored.
+		 */
+		NodePtr sequence()
+		{
+			std::vector<NodePtr> nodes;
+			bool                 anchoredStart = false;
+			bool                 anchoredEnd   = false;
+			if ((depth == 0) && (peek() == '^'))
+			{
+				anchoredStart = true;
+				pos++;
+			}
+			while (!at_end() && (peek() != '|') && (peek() != ')'))
+			{
+				if ((depth == 0) && (peek() == '$'))
+				{
+					pos++;
+					if (!at_end() && (peek() != '|'))
+					{
+						return fail();
+					}
+					anchoredEnd = true;
+					break;
+				}
+				nodes.push_back(quantified(atom()));
+			}
+			if (depth == 0)
+			{
+				auto anything =
+				  repeat(bytes(ByteSet().set()), 0, Node::Unbounded);
+				if (!anchoredStart)
+				{
+					nodes.insert(nodes.begin(), anything);
+				}
+				if (!anchoredEnd)
+				{
+					nodes.push_back(anything);
+				}
+			}
+			return compound(Node::Concat, std::move(nodes));
+		}
+
+		/**
+		 * Parse a set of alternatives separated by `|`.
+		 */
+		NodePtr alternation()
+		{
+			std::vector<NodePtr> alternatives{sequence()};
+			while (peek() == '|')
+			{
+				pos++;
+				alternatives.push_back(sequence());
+			}
+			return compound(Node::Alternate, std::move(alternatives));
+		}
+
+		public:
+		/**
+		 * Constructor, takes the pattern to parse.
+		 */
+		Parser(std::string_view p) : pattern(p) {}
+
+		/**
+		 * Parse the pattern.  Returns nothing if it uses unsupported
+		 * features.
+		 */
+		NodePtr parse()
+		{
+			auto root = alternation();
+			if (!ok || !at_end())
+			{
+				return nullptr;
+			}
+			return root;
+		}
+	};
+
+	/**
+	 * Nondeterministic finite automaton, built from the AST with Thompson's
+	 * construction.  Each state has at most one transition on a set of
+	 * bytes, plus any number of epsilon transitions.
+	 */
+	struct NFA
+	{
+		/**
+		 * A state in the automaton.
+		 */
+		struct State
+		{
+			/**
+			 * The bytes that move to `next`.
+			 */
+			ByteSet bytes;
+
+			/**
+			 * The target of the byte transition, or -1 if there is none.
+			 */
+			int next = -1;
+
+			/**
+			 * States reachable without consuming input.
+			 */
+			std::vector<int> epsilon;
+		};
+
+		/**
+		 * All of the states in the automaton.
+		 */
+		std::vector<State> states;
+
+		/**
+		 * The accepting state.
+		 */
+		int accept;
+
+		/**
+		 * Add a new state, returning its index.
+		 */
+		int add()
+		{
+			states.emplace_back();
+			return states.size() - 1;
+		}
+
+		/**
+		 * Build the states for `node`, starting from `start`.  Returns the
+		 * state reached at the end of the node.  Fails if the automaton grows
+		 * too large.
+		 */
+		std::optional<int> build(const Node &node, int start)
+		{
+			if (states.size() > 100000)
+			{
+				return std::nullopt;
+			}
+			switch (node.kind)
+			{
+				case Node::Empty:
+					return start;
+				case Node::Bytes:
+				{
+					int end             = add();
+					states[start].bytes = node.bytes;
+					states[start].next  = end;
+					return end;
+				}
+				case Node::Concat:
+				{
+					std::optional<int> end = start;
+					for (auto &child : node.children)
+					{
+						// Bytes nodes need a fresh state to hang the
+						// transition from.
+						int next = add();
+						states[*end].epsilon.push_back(next);
+						if (!(end = build(*child, next)))
+						{
+							return std::nullopt;
+						}
+					}
+					return end;
+				}
+				case Node::Alternate:
+				{
+					int end = add();
+					for (auto &child : node.children)
+					{
+						int branch = add();
+						states[start].epsilon.push_back(branch);
+						auto branchEnd = build(*child, branch);
+						if (!branchEnd)
+						{
+							return std::nullopt;
+						}
+						states[*branchEnd].epsilon.push_back(end);
+					}
+					return end;
+				}
+				case Node::Repeat:
+				{
+					std::optional<int> end   = start;
+					auto              &child = *node.children[0];
+					for (unsigned i = 0; i < node.min; i++)
+					{
+						int next = add();
+						states[*end].epsilon.push_back(next);
+						if (!(end = build(child, next)))
+						{
+							return std::nullopt;
+						}
+					}
+					if (node.max == Node::Unbounded)
+					{
+						int loop = add();
+						int exit = add();
+						states[*end].epsilon.push_back(loop);
+						states[loop].epsilon.push_back(exit);
+						int body = add();
+						states[loop].epsilon.push_back(body);
+						auto bodyEnd = build(child, body);
+						if (!bodyEnd)
+						{
+							return std::nullopt;
+						}
+						states[*bodyEnd].epsilon.push_back(loop);
+						return exit;
+					}
+					int exit = add();
+					for (unsigned i = node.min; i < node.max; i++)
+					{
+						states[*end].epsilon.push_back(exit);
+						int next = add();
+						states[*end].epsilon.push_back(next);
+						if (!(end = build(child, next)))
+						{
+							return std::nullopt;
+						}
+					}
+					states[*end].epsilon.push_back(exit);
+					return exit;
+				}
+			}
+			return std::nullopt;
+		}
+
+		/**
+		 * Expand `set` (a sorted list of states) to include every state
+		 * reachable from it by epsilon transitions.
+		 */
+		void closure(std::vector<int> &set)
+		{
+			std::vector<bool> seen(states.size());
+			std::vector<int>  worklist = set;
+			for (int s : set)
+			{
+				seen[s] = true;
+			}
+			while (!worklist.empty())
+			{
+				int s = worklist.back();
+				worklist.pop_back();
+				for (int next : states[s].epsilon)
+				{
+					if (!seen[next])
+					{
+						seen[next] = true;
+						set.push_back(next);
+						worklist.push_back(next);
+					}
+				}
+			}
+			std::sort(set.begin(), set.end());
+		}
+	};
+
+	/**
+	 * A minimal DFA, in the form consumed by `DFA` in `config-generic.h`.
+	 */
+	struct Automaton
+	{
+		/**
+		 * Map from bytes to equivalence classes.
+		 */
+		std::array<unsigned, 256> byteClasses;
+
+		/**
+		 * The number of equivalence classes.
+		 */
+		size_t classes = 0;
+
+		/**
+		 * Transition table, indexed by state and then by class.  State 0 is
+		 * the dead state and state 1 is the start state.
+		 */
+		std::vector<std::vector<unsigned>> transitions;
+
+		/**
+		 * Whether each state is accepting.
+		 */
+		std::vector<bool> accepting;
+	};
+
+	/**
+	 * The maximum number of states in a generated DFA.  Patterns that need
+	 * more are left for libucl to check.
+	 */
+	constexpr size_t MaxStates = 4096;
+
+	/**
+	 * Compile a pattern to a minimal DFA.  Returns nothing if the pattern is
+	 * not supported or the automaton would be too large.
+	 */
+	std::optional<Automaton> compile(std::string_view pattern)
+	{
+		auto ast = Parser(pattern).parse();
+		if (!ast)
+		{
+			return std::nullopt;
+		}
+		NFA  nfa;
+		int  start = nfa.add();
+		auto end   = nfa.build(*ast, start);
+		if (!end)
+		{
+			return std::nullopt;
+		}
+		nfa.accept = *end;
+
+		// Partition the bytes into classes that behave identically on every
+		// transition.
+		std::vector<ByteSet> labels;
+		for (auto &s : nfa.states)
+		{
+			if ((s.next != -1) &&
+			    (std::find(labels.begin(), labels.end(), s.bytes) ==
+			     labels.end()))
+			{
+				labels.push_back(s.bytes);
+			}
+		}
+		Automaton                           result;
+		std::map<std::vector<bool>, size_t> signatures;
+		std::vector<unsigned>               representatives;
+		for (unsigned b = 0; b < 256; b++)
+		{
+			std::vector<bool> signature;
+			for (auto &label : labels)
+			{
+				signature.push_back(label.test(b));
+			}
+			auto [it, inserted] =
+			  signatures.try_emplace(signature, signatures.size());
+			if (inserted)
+			{
+				representatives.push_back(b);
+			}
+			result.byteClasses[b] = it->second;
+		}
+		size_t classes = representatives.size();
+
+		// Subset construction.  State 0 is the empty set (the dead state).
+		std::map<std::vector<int>, unsigned> dfaStates;
+		std::vector<std::vector<int>>        sets;
+		auto intern = [&](std::vector<int> set) {
+			auto [it, inserted] = dfaStates.try_emplace(set, sets.size());
+			if (inserted)
+			{
+				sets.push_back(std::move(set));
+			}
+			return it->second;
+		};
+		intern({});
+		std::vector<int> initial{start};
+		nfa.closure(initial);
+		intern(initial);
+		std::vector<std::vector<unsigned>> transitions;
+		for (size_t i = 0; i < sets.size(); i++)
+		{
+			if (sets.size() > MaxStates * 4)
+			{
+				return std::nullopt;
+			}
+			std::vector<unsigned> row(classes);
+			for (size_t c = 0; c < classes; c++)
+			{
+				std::vector<int> next;
+				for (int s : sets[i])
+				{
+					auto &state = nfa.states[s];
+					if ((state.next != -1) &&
+					    state.bytes.test(representatives[c]))
+					{
+						next.push_back(state.next);
+					}
+				}
+				std::sort(next.begin(), next.end());
+				next.erase(std::unique(next.begin(), next.end()), next.end());
+				nfa.closure(next);
+				row[c] = intern(std::move(next));
+			}
+			transitions.push_back(std::move(row));
+		}
+		std::vector<bool> accepting;
+		for (auto &set : sets)
+		{
+			accepting.push_back(std::binary_search(
+			  set.begin(), set.end(), nfa.accept));
+		}
+
+		// Minimise with Moore's algorithm: refine a partition of the states
+		// until all states in a block agree on acceptance and on the blocks
+		// that their transitions reach.
+		std::vector<unsigned> block(sets.size());
+		for (size_t i = 0; i < sets.size(); i++)
+		{
+			block[i] = accepting[i];
+		}
+		size_t blocks = 0;
+		while (true)
+		{
+			std::map<std::vector<unsigned>, unsigned> refined;
+			std::vector<unsigned>                     next(sets.size());
+			for (size_t i = 0; i < sets.size(); i++)
+			{
+				std::vector<unsigned> signature{block[i]};
+				for (unsigned t : transitions[i])
+				{
+					signature.push_back(block[t]);
+				}
+				next[i] =
+				  refined.try_emplace(signature, refined.size()).first->second;
+			}
+			block.swap(next);
+			if (refined.size() == blocks)
+			{
+				break;
+			}
+			blocks = refined.size();
+		}
+
+		// Renumber the blocks so that the dead state is 0 and the start state
+		// is 1.  If the start state is dead (the pattern can never match)
+		// then it still needs a distinct number.
+		std::vector<int> number(blocks, -1);
+		unsigned         states = 0;
+		number[block[0]]        = states++;
+		std::vector<unsigned> representative{0};
+		if (block[1] == block[0])
+		{
+			representative.push_back(0);
+			states++;
+		}
+		for (size_t i = 1; i < sets.size(); i++)
+		{
+			if (number[block[i]] == -1)
+			{
+				number[block[i]] = states++;
+				representative.push_back(i);
+			}
+		}
+		if (states > MaxStates)
+		{
+			return std::nullopt;
+		}
+		for (unsigned r : representative)
+		{
+			std::vector<unsigned> row;
+			for (unsigned t : transitions[r])
+			{
+				row.push_back(number[block[t]]);
+			}
+			result.transitions.push_back(std::move(row));
+			result.accepting.push_back(accepting[r]);
+		}
+
+		// Merge classes whose columns in the minimised table are identical.
+		std::map<std::vector<unsigned>, unsigned> columns;
+		std::vector<unsigned>                     classMap(classes);
+		std::vector<unsigned>                     keptClasses;
+		for (size_t c = 0; c < classes; c++)
+		{
+			std::vector<unsigned> column;
+			for (auto &row : result.transitions)
+			{
+				column.push_back(row[c]);
+			}
+			auto [it, inserted] = columns.try_emplace(column, columns.size());
+			if (inserted)
+			{
+				keptClasses.push_back(c);
+			}
+			classMap[c] = it->second;
+		}
+		for (auto &c : result.byteClasses)
+		{
+			c = classMap[c];
+		}
+		for (auto &row : result.transitions)
+		{
+			std::vector<unsigned> merged;
+			for (unsigned c : keptClasses)
+			{
+				merged.push_back(row[c]);
+			}
+			row = std::move(merged);
+		}
+		result.classes = keptClasses.size();
+		return result;
+	}
+} // namespace Regex
+
+namespace
+{
+	/**
+	 * The namespace for the helpers defined in `config-generic.h`.  This can
+	 * be overridden on the command line.
+	 */
+	std::string configNamespace = "::config::detail::";
+
+	/**
+	 * Set if any generated accessor reads values from a snapshot.  If so, the
+	 * generated `make_config` must create one.
+	 */
+	bool snapshotRequired = false;
+
+	/**
+	 * String formats that are decoded when a config is created.  Maps from
+	 * the value of the `format` keyword to the format descriptor in
+	 * `config-generic.h` and the type that accessors return, which is empty
+	 * for formats that are validated but exposed as strings.
+	 */
+	const std::unordered_map<std::string_view,
+	                         std::pair<std::string_view, std::string_view>>
+	  stringFormats = {
+	    {"ipv4", {"IPv4", "IPv4Address"}},
+	    {"ipv6", {"IPv6", "IPv6Address"}},
+	    {"cidr", {"CIDR", "IPPrefix"}},
+	    {"hostname", {"Hostname", ""}},
+	    {"uri", {"Uri", "URI"}},
+	};
+
+	/**
+	 * Set if the scalar properties of the config class are decoded into
+	 * fields when it is constructed, rather than looked up on each access.
+	 */
+	bool materialize = false;
+
+	/**
+	 * Set if the accessors of the config class count how often they are
+	 * called, so that a profile can be written for `layoutProfile`.
+	 */
+	bool countAccesses = false;
+
+	/**
+	 * The number of times that each property of the config class was
+	 * accessed, read from a profile.  If this is not empty, the most
+	 * frequently accessed materialized fields are packed into the first cache
+	 * line and the others are moved behind a pointer.
+	 */
+	std::unordered_map<std::string, uint64_t> layoutProfile;
+
+	/**
+	 * Set if each class has a table describing its properties and the
+	 * accessors call generic routines that decode a property from its table
+	 * entry, rather than each accessor containing its own copy of the lookup
+	 * and conversion.
+	 */
+	bool tableDriven = false;
+
+	/**
+	 * The size and alignment of the accessor return types that can be
+	 * materialized.  The generated code asserts that these are correct.
+	 */
+	const std::unordered_map<std::string_view, std::pair<size_t, size_t>>
+	  materializedTypes = {
+	    {"bool", {1, 1}},
+	    {"int8_t", {1, 1}},
+	    {"uint8_t", {1, 1}},
+	    {"int16_t", {2, 2}},
+	    {"uint16_t", {2, 2}},
+	    {"int32_t", {4, 4}},
+	    {"uint32_t", {4, 4}},
+	    {"int64_t", {8, 8}},
+	    {"uint64_t", {8, 8}},
+	    {"double", {8, 8}},
+	    {"std::string_view", {16, 8}},
+	};
+
+	/**
+	 * The size of a cache line, which the hot fields are packed into.
+	 */
+	constexpr size_t CacheLineSize = 64;
+
+	/**
+	 * The largest `maxItems` for which an array of scalars in the config
+	 * class is materialized as a `SmallVector`, with its items stored inline.
+	 */
+	constexpr uint64_t SmallVectorMaxItems = 16;
+
+	/**
+	 * A property of the config class that is decoded when the class is
+	 * constructed.
+	 */
+	struct MaterializedField
+	{
+		/**
+		 * The name of the accessor and the field.
+		 */
+		std::string name{};
+
+		/**
+		 * The type of the field, which the accessor returns.
+		 */
+		std::string type{};
+
+		/**
+		 * The expression that decodes the field from the object `o`.
+		 */
+		std::string initializer{};
+
+		/**
+		 * The doc comment for the accessor.
+		 */
+		std::string doc{};
+
+		/**
+		 * The statement that counts calls to the accessor, if any.
+		 */
+		std::string counter{};
+
+		/**
+		 * The lifetime attribute for the accessor.
+		 */
+		std::string_view lifetimeAttribute{};
+
+		/**
+		 * The number of accesses in the layout profile.
+		 */
+		uint64_t count = 0;
+
+		/**
+		 * The size of the field.
+		 */
+		size_t size = 0;
+
+		/**
+		 * The alignment of the field.
+		 */
+		size_t align = 1;
+
+		/**
+		 * Set if the field is in the first cache line.
+		 */
+		bool hot = true;
+
+		/**
+		 * Set if the accessor returns a reference to the field, rather than
+		 * a copy, because the field is an array.
+		 */
+		bool byReference = false;
+
+		/**
+		 * Set if the field has an accessor with the same name.  The field
+		 * that holds packed fields does not.
+		 */
+		bool hasAccessor = true;
+	};
+
+	/**
+	 * Returns `str` as a C++ expression of type `std::string_view`.
+	 */
+	std::string string_literal(std::string_view str)
+	{
+		std::string literal = "std::string_view(\"";
+		for (unsigned char c : str)
+		{
+			if ((c == '"') || (c == '\\'))
+			{
+				literal += '\\';
+				literal += static_cast<char>(c);
+			}
+			else if ((c >= ' ') && (c < 0x7f))
+			{
+				literal += static_cast<char>(c);
+			}
+			else
+			{
+				char escape[5];
+				snprintf(escape, sizeof(escape), "\\%03o", c);
+				literal += escape;
+			}
+		}
+		literal += "\", ";
+		literal += std::to_string(str.size());
+		literal += ')';
+		return literal;
+	}
+
+	/**
+	 * Returns `d` as a C++ expression of type `double`.
+	 */
+	std::string double_literal(double d)
+	{
+		if (std::isnan(d))
+		{
+			return "std::numeric_limits<double>::quiet_NaN()";
+		}
+		if (std::isinf(d))
+		{
+			return d < 0 ? "-std::numeric_limits<double>::infinity()"
+			             : "std::numeric_limits<double>::infinity()";
+		}
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.17g", d);
+		return buffer;
+	}
+
+	/**
+	 * Returns `i` as a C++ expression of type `long long`.
+	 */
+	std::string integer_literal(int64_t i)
+	{
+		if (i == std::numeric_limits<int64_t>::min())
+		{
+			return "(-9223372036854775807LL - 1)";
+		}
+		return std::to_string(i) + "LL";
+	}
+
+	/**
+	 * Returns the number `o` as a C++ expression of `type`, converted in
+	 * the same way as by the adaptor for `type`.
+	 */
+	std::string number_literal(std::string_view type, const ucl_object_t *o)
+	{
+		if (type == "bool")
+		{
+			return ucl_object_toboolean(o) ? "true" : "false";
+		}
+		if (type == "double")
+		{
+			return double_literal(ucl_object_todouble(o));
+		}
+		std::string literal = "static_cast<";
+		literal += type;
+		literal += ">(";
+		literal += integer_literal(ucl_object_toint(o));
+		literal += ')';
+		return literal;
+	}
+
+	/**
+	 * A boolean or string enumeration property of the config class that is
+	 * packed into a bit field when the class is constructed.
+	 */
+	struct PackedField
+	{
+		/**
+		 * The name of the accessor.
+		 */
+		std::string name{};
+
+		/**
+		 * The name of the property.
+		 */
+		std::string property{};
+
+		/**
+		 * The values of a string enumeration, as C++ expressions, or empty
+		 * for a boolean.
+		 */
+		std::vector<std::string> values{};
+
+		/**
+		 * The doc comment for the accessor.
+		 */
+		std::string doc{};
+
+		/**
+		 * The statement that counts calls to the accessor, if any.
+		 */
+		std::string counter{};
+
+		/**
+		 * Set if the property is required.
+		 */
+		bool isRequired = false;
+
+		/**
+		 * The number of bits.  Zero means absent, for optional booleans, and
+		 * absent or not one of the values, for enumerations.
+		 */
+		size_t width = 0;
+
+		/**
+		 * The offset of the first bit.
+		 */
+		size_t offset = 0;
+	};
+
+	template<typename T>
+	bool
+	emit_class(Object o, std::string_view name, T &out, bool isRoot = false);
+
+	/**
+	 * Schema visitor.  This visits a schema and collects the information
+	 * required to provide the accessor for the described type.
+	 */
+	class SchemaVisitor
+	{
+		public:
+		/**
+		 * The return type for the accessor for this schema.
+		 */
+		std::string returnType;
+
+		/**
+		 * The adaptor type to use for this schema.
+		 */
+		std::string adaptor;
+
+		/**
+		 * The namespace in which the adaptor is defined.
+		 */
+		std::string_view adaptorNamespace = configNamespace;
+
+		/**
+		 * The lifetime attribute for this property, if one is required.  For
+		 * strings, the returned `string_view` has a lifetime bound by the
+		 * underlying schema.  Other types are typically either owning
+		 * references or value types.
+		 */
+		std::string_view lifetimeAttribute;
+
+		/**
+		 * The name of a function that checks constraints that were compiled
+		 * out of the embedded schema, or empty if there are none.  The
+		 * function is called with the UCL object for the property and a
+		 * pointer to a `ucl_schema_error` and returns false if the object is
+		 * not valid.
+		 */
+		std::string validator;
+
+		/**
+		 * Set if the adaptor must be constructed with the snapshot as well as
+		 * the UCL object.
+		 */
+		bool needsSnapshot = false;
+
+		/**
+		 * The name of a function that removes unused properties from the UCL
+		 * object for this property, or empty if this property does not
+		 * contain any objects.
+		 */
+		std::string compactor;
+
+		/**
+		 * The smallest valid value of a size.
+		 */
+		uint64_t minSize = 0;
+
+		/**
+		 * The largest valid value of a size.
+		 */
+		uint64_t maxSize = std::numeric_limits<uint64_t>::max();
+
+		/**
+		 * The number that a size must be a multiple of.
+		 */
+		uint64_t sizeMultipleOf = 1;
+
+		/**
+		 * The number of items, for an array with a fixed number of items, or
+		 * zero otherwise.
+		 */
+		uint64_t fixedLength = 0;
+
+		/**
+		 * The maximum number of items, for an array that has one, or zero
+		 * otherwise.
+		 */
+		uint64_t maxItems = 0;
+
+		/**
+		 * The type of the items, for an array.
+		 */
+		std::string itemType;
+
+		/**
+		 * The qualified name of the adaptor for the items, for an array.
+		 */
+		std::string itemAdaptor;
+
+		/**
+		 * The values that this property can have, as C++ expressions, if it
+		 * is a string with an `enum` of strings.
+		 */
+		std::vector<std::string> enumValues;
+
+		/**
+		 * The C++ expression for the only value that this property can have,
+		 * or empty if it can have more than one.
+		 */
+		std::string constant;
+
+		/**
+		 * The name of this property.
+		 */
+		std::string_view name;
+
+		/**
+		 * Any new types that were declared to handle this property.
+		 */
+		std::stringstream &types;
+
+		/**
+		 * Construct a schema visitor with a specified name, writing to an
+		 * output string stream.
+		 */
+		SchemaVisitor(std::string_view n, std::stringstream &t)
+		  : name(n), types(t)
+		{
+		}
+
+		/**
+		 * Add a validator for this property.  If there is already a
+		 * validator, the two are combined.
+		 */
+		void add_validator(std::string_view v)
+		{
+			if (validator.empty())
+			{
+				validator = v;
+				return;
+			}
+			std::string combined = configNamespace;
+			combined += "validate_all<";
+			if (validator.starts_with(combined))
+			{
+				// Already combined, append to the list.
+				validator.pop_back();
+				validator += ", ";
+			}
+			else
+			{
+				combined += validator;
+				combined += ", ";
+				validator = std::move(combined);
+			}
+			validator += v;
+			validator += '>';
+		}
+
+		/**
+		 * Check whether the schema `s`, which this visitor has visited,
+		 * accepts a single value of a scalar type.  If so, `constant` is set
+		 * to that value, so that the accessor can return it without looking
+		 * at the object, because validation guarantees that the property has
+		 * that value if it is present.
+		 *
+		 * libucl's validator does not support `const`, so a `const` is
+		 * replaced with an `enum` that has a single element.
+		 */
+		void fold_constant(SchemaBase s)
+		{
+			auto *schema = (ucl_object_t *)s.obj;
+			if (auto *value = ucl_object_lookup(schema, "const");
+			    value && !ucl_object_lookup(schema, "enum"))
+			{
+				auto *values = ucl_object_typed_new(UCL_ARRAY);
+				ucl_array_append(values, ucl_object_copy(value));
+				ucl_object_replace_key(schema, values, "enum", 4, false);
+				ucl_object_delete_key(schema, "const");
+			}
+			auto *value = s.constant();
+			if ((value == nullptr) || needsSnapshot)
+			{
+				return;
+			}
+			auto type = ucl_object_type(value);
+			if (returnType == "std::string_view")
+			{
+				if (type == UCL_STRING)
+				{
+					size_t      length;
+					const char *str = ucl_object_tolstring(value, &length);
+					constant        = string_literal({str, length});
+				}
+			}
+			else if (returnType == "bool")
+			{
+				if (type == UCL_BOOLEAN)
+				{
+					constant = number_literal(returnType, value);
+				}
+			}
+			else if (returnType == "double")
+			{
+				if ((type == UCL_INT) || (type == UCL_FLOAT))
+				{
+					constant = number_literal(returnType, value);
+				}
+			}
+			else if (materializedTypes.contains(returnType) &&
+			         (type == UCL_INT))
+			{
+				constant = number_literal(returnType, value);
+			}
+		}
+
+		/**
+		 * Handle a number.  This is common code for all of the number
+		 * subclasses.  It provides an adaptor that is the smallest type that
+		 * satisfies all of the constraints.
+		 */
+		void handleNumber(Number &num, bool isInteger)
+		{
+			if (!isInteger)
+			{
+				auto multipleOf = num.multipleOf();
+				if (multipleOf)
+				{
+					isInteger =
+					  (((double)(uint64_t)*multipleOf) == *multipleOf);
+				}
+			}
+			if (!isInteger)
+			{
+				returnType = "double";
+				adaptor    = "DoubleAdaptor";
+				return;
+			}
+			int64_t min = std::numeric_limits<int64_t>::min();
+			int64_t max = std::numeric_limits<int64_t>::max();
+			min =
+			  std::max(min, static_cast<int64_t>(num.minimum().value_or(min)));
+			min = std::max(
+			  min, static_cast<int64_t>(num.exclusiveMinimum().value_or(min)));
+			max =
+			  std::min(max, static_cast<int64_t>(num.maximum().value_or(max)));
+			max = std::min(
+			  max, static_cast<int64_t>(num.exclusiveMaximum().value_or(max)));
+			auto try_type =
+			  [&](auto intty, std::string_view ty, std::string_view a) {
+				  if ((min >= std::numeric_limits<decltype(intty)>::min()) &&
+				      (max <= std::numeric_limits<decltype(intty)>::max()))
+				  {
+					  returnType = ty;
+					  adaptor    = a;
+				  }
+			  };
+			try_type(int64_t(), "int64_t", "Int64Adaptor");
+			try_type(uint64_t(), "uint64_t", "UInt64Adaptor");
+			try_type(int32_t(), "int32_t", "Int32Adaptor");
+			try_type(uint32_t(), "uint32_t", "UInt32Adaptor");
+			try_type(int16_t(), "int16_t", "Int16Adaptor");
+			try_type(uint16_t(), "uint16_t", "UInt16Adaptor");
+			try_type(int8_t(), "int8_t", "Int8Adaptor");
+			try_type(uint8_t(), "uint8_t", "UInt8Adaptor");
+		}
+
+		/**
+		 * Handle a string with a known format.  The string is checked by the
+		 * generated validator and, for formats that decode to something other
+		 * than a string, the accessor returns the value that was decoded
+		 * when the snapshot was created.
+		 */
+		void handleFormat(std::string_view format)
+		{
+			auto known = stringFormats.find(format);
+			if (known == stringFormats.end())
+			{
+				return;
+			}
+			auto [descriptor, type] = known->second;
+			std::string formatName  = configNamespace;
+			formatName += "formats::";
+			formatName += descriptor;
+			std::string v = configNamespace;
+			v += "validate_format<";
+			v += formatName;
+			v += '>';
+			add_validator(v);
+			if (type.empty())
+			{
+				return;
+			}
+			returnType = configNamespace;
+			returnType += type;
+			adaptor = "FormatAdaptor<";
+			adaptor += formatName;
+			adaptor += '>';
+			needsSnapshot    = true;
+			snapshotRequired = true;
+			// URIs are views into the string, other types are values.
+			if (format != "uri")
+			{
+				lifetimeAttribute = "";
+			}
+		}
+
+		/**
+		 * Handle a string schema.  If the string has a pattern that can be
+		 * compiled to a DFA, this generates the DFA and removes the pattern
+		 * from the schema so that libucl does not need to check it again.
+		 */
+		void operator()(String s)
+		{
+			returnType        = "std::string_view";
+			adaptor           = "StringViewAdaptor";
+			lifetimeAttribute = "CONFIG_LIFETIME_BOUND";
+			if (auto format = s.format())
+			{
+				handleFormat(*format);
+			}
+			// Lengths are checked by generated code, which counts code points
+			// and rejects invalid UTF-8 in a single vectorised pass.
+			auto minLength = s.minLength();
+			auto maxLength = s.maxLength();
+			if (minLength || maxLength)
+			{
+				std::string v = configNamespace;
+				v += "validate_length<";
+				v += std::to_string(minLength.value_or(0));
+				v += "ULL, ";
+				v += maxLength ? std::to_string(*maxLength) + "ULL"
+				               : std::string("SIZE_MAX");
+				v += '>';
+				add_validator(v);
+				ucl_object_delete_key((ucl_object_t *)s.obj, "minLength");
+				ucl_object_delete_key((ucl_object_t *)s.obj, "maxLength");
+			}
+			if (auto values = s.enumeration();
+			    values && (returnType == "std::string_view"))
+			{
+				for (const ucl_object_t *value : *values)
+				{
+					if (ucl_object_type(value) != UCL_STRING)
+					{
+						enumValues.clear();
+						break;
+					}
+					size_t      length;
+					const char *str = ucl_object_tolstring(value, &length);
+					enumValues.push_back(string_literal({str, length}));
+				}
+			}
+			auto pattern = s.pattern();
+			if (!pattern)
+			{
+				return;
+			}
+			auto dfa = Regex::compile(*pattern);
+			if (!dfa)
+			{
+				fprintf(stderr,
+				        "Pattern for %.*s is not supported by the DFA "
+				        "compiler, leaving it for libucl\n",
+				        static_cast<int>(name.size()),
+				        name.data());
+				return;
+			}
+			std::string dfaName{name};
+			dfaName += "_pattern";
+			// Don't let the pattern terminate the comment.
+			std::string comment{*pattern};
+			for (size_t pos = 0;
+			     (pos = comment.find("*/", pos)) != std::string::npos;)
+			{
+				comment.replace(pos, 2, "*\\/");
+			}
+			types << "\n/**\n* DFA for the pattern `" << comment
+			      << "`\n*/\nstatic constexpr " << configNamespace << "DFA<"
+			      << dfa->transitions.size() << ", " << dfa->classes << ", "
+			      << (dfa->transitions.size() <= 256 ? "uint8_t" : "uint16_t")
+			      << "> " << dfaName << " = {{";
+			for (unsigned c : dfa->byteClasses)
+			{
+				types << c << ',';
+			}
+			types << "}, {";
+			for (auto &row : dfa->transitions)
+			{
+				types << '{';
+				for (unsigned t : row)
+				{
+					types << t << ',';
+				}
+				types << "},";
+			}
+			types << "}, {";
+			for (bool accepting : dfa->accepting)
+			{
+				types << (accepting ? "true," : "false,");
+			}
+			types << "}};\n";
+			std::string v = configNamespace;
+			v += "validate_pattern<";
+			v += dfaName;
+			v += '>';
+			add_validator(v);
+			ucl_object_delete_key((ucl_object_t *)s.obj, "pattern");
+		}
+
+		/**
+		 * Handle a boolean schema.
+		 */
+		void operator()(Boolean)
+		{
+			returnType = "bool";
+			adaptor    = "BoolAdaptor";
+		}
+
+		/**
+		 * Handle an integer schema.
+		 */
+		void operator()(Integer i)
+		{
+			handleNumber(i, true);
+		}
+
+		/**
+		 * Handle a duration.
+		 */
+		void operator()(Duration d)
+		{
+			// Find the numeric type that satisfies the constraints.
+			handleNumber(d, false);
+			// Wrap the number type to give a duration.
+			std::string type = returnType;
+			adaptor          = "DurationAdaptor<";
+			adaptor += type;
+			adaptor += '>';
+			returnType = "std::chrono::duration<";
+			returnType += type;
+			returnType += '>';
 			ucl_object_replace_key((ucl_object_t *)d.obj,
 			                       ucl_object_fromstring("number"),
 			                       "type",
@@ -465,141 +2305,1647 @@ namespace
 		}
 
 		/**
-		 * Handle an integer schema.
+		 * Handle a size.  The accessor returns a byte count in the narrowest
+		 * unsigned type that can hold every valid value.  libucl decodes
+		 * unquoted suffixes but quoted ones (for example, in JSON) remain
+		 * strings and fractional values are floats, so the embedded schema
+		 * accepts numbers and strings and the generated validator checks the
+		 * range constraints after decoding.
+		 */
+		void operator()(Size sz)
+		{
+			uint64_t min        = 0;
+			uint64_t max        = std::numeric_limits<uint64_t>::max();
+			uint64_t multipleOf = 1;
+
+			// Convert a bound from the schema, saturating at the ends of the
+			// range of byte counts.
+			auto clamp = [](double d) -> uint64_t {
+				if (d <= 0)
+				{
+					return 0;
+				}
+				if (d >= 18446744073709551616.0)
+				{
+					return std::numeric_limits<uint64_t>::max();
+				}
+				return static_cast<uint64_t>(d);
+			};
+			if (auto m = sz.minimum())
+			{
+				min = std::max(min, clamp(std::ceil(*m)));
+			}
+			if (auto m = sz.exclusiveMinimum())
+			{
+				min = std::max(min, clamp(std::floor(*m) + 1));
+			}
+			if (auto m = sz.maximum())
+			{
+				max = std::min(max, clamp(std::floor(*m)));
+			}
+			if (auto m = sz.exclusiveMaximum())
+			{
+				max = std::min(max, clamp(std::ceil(*m) - 1));
+			}
+			if (auto m = sz.multipleOf())
+			{
+				multipleOf = std::max<uint64_t>(1, clamp(*m));
+			}
+			std::string_view type = "uint64_t";
+			if (max <= std::numeric_limits<uint8_t>::max())
+			{
+				type = "uint8_t";
+			}
+			else if (max <= std::numeric_limits<uint16_t>::max())
+			{
+				type = "uint16_t";
+			}
+			else if (max <= std::numeric_limits<uint32_t>::max())
+			{
+				type = "uint32_t";
+			}
+			minSize        = min;
+			maxSize        = max;
+			sizeMultipleOf = multipleOf;
+			returnType     = configNamespace;
+			returnType += "ByteSize<";
+			returnType += type;
+			returnType += '>';
+			adaptor = "SizeAdaptor<";
+			adaptor += type;
+			adaptor += '>';
+			needsSnapshot    = true;
+			snapshotRequired = true;
+			std::string v    = configNamespace;
+			v += "validate_size<";
+			v += std::to_string(min);
+			v += "ULL, ";
+			v += std::to_string(max);
+			v += "ULL, ";
+			v += std::to_string(multipleOf);
+			v += "ULL>";
+			add_validator(v);
+			auto *schema = (ucl_object_t *)sz.obj;
+			for (const char *key : {"minimum",
+			                        "exclusiveMinimum",
+			                        "maximum",
+			                        "exclusiveMaximum",
+			                        "multipleOf"})
+			{
+				ucl_object_delete_key(schema, key);
+			}
+			auto *types = ucl_object_typed_new(UCL_ARRAY);
+			ucl_array_append(types, ucl_object_fromstring("number"));
+			ucl_array_append(types, ucl_object_fromstring("string"));
+			ucl_object_replace_key(schema, types, "type", 4, false);
+		}
+
+		/**
+		 * Handle an integer schema.
+		 */
+		void operator()(Number n)
+		{
+			handleNumber(n, false);
+		}
+
+		/**
+		 * Handle an object schema.  This does a recursive visit to generate a
+		 * new class that represents the object.
+		 */
+		void operator()(Object o)
+		{
+			returnType = name;
+			returnType += "Class";
+			needsSnapshot = true;
+			// Nested objects keep their hashes in the snapshot.
+			snapshotRequired = true;
+			if (emit_class(o, returnType, types))
+			{
+				validator = returnType;
+				validator += "::validate";
+			}
+			compactor = returnType;
+			compactor += "::compact";
+			adaptor          = returnType;
+			adaptorNamespace = "";
+		}
+
+		/**
+		 * Handle an array.  This performs a recursive visit to generate a new
+		 * class representing the array element type.
+		 *
+		 * Note that this currently handles only arrays of a single object
+		 * type, not heterogeneous arrays.
+		 */
+		void operator()(Array a)
+		{
+			std::string itemName{name};
+			itemName += "Item";
+			SchemaVisitor item(itemName, types);
+			auto          items    = a.items();
+			auto          itemKind = items.type();
+			items.get().visit(item);
+			returnType = configNamespace;
+			returnType += "Range<";
+			returnType += item.returnType;
+			returnType += ", ";
+			returnType += item.adaptorNamespace;
+			returnType += item.adaptor;
+			returnType += ", true>";
+			adaptor          = returnType;
+			adaptor          = adaptor.substr(configNamespace.size());
+			adaptorNamespace = configNamespace;
+			needsSnapshot    = item.needsSnapshot;
+			if (!item.compactor.empty())
+			{
+				compactor = configNamespace;
+				compactor += "compact_items<";
+				compactor += item.compactor;
+				compactor += '>';
+			}
+			if (a.prefixTrie())
+			{
+				ucl_object_delete_key((ucl_object_t *)a.obj, "x-prefix-trie");
+				if (item.returnType == configNamespace + "IPPrefix")
+				{
+					returnType = configNamespace;
+					returnType += "PrefixTrie";
+					adaptor          = "PrefixTrieAdaptor";
+					needsSnapshot    = true;
+					snapshotRequired = true;
+					validator        = configNamespace;
+					validator += "validate_prefix_trie<";
+					validator += item.validator;
+					validator += '>';
+					return;
+				}
+				fprintf(stderr,
+				        "x-prefix-trie on %.*s ignored, items must be strings "
+				        "with the cidr format\n",
+				        static_cast<int>(name.size()),
+				        name.data());
+			}
+			if (auto key = a.index())
+			{
+				std::string keyName{*key};
+				ucl_object_delete_key((ucl_object_t *)a.obj, "x-index");
+				auto keySchema = items.obj["properties"][keyName.c_str()];
+				if (make_optional<StringViewAdaptor, std::string_view>(
+				      keySchema["type"]) == "string")
+				{
+					emit_index(item, keyName);
+					return;
+				}
+				fprintf(stderr,
+				        "x-index on %.*s ignored, items must be objects with "
+				        "a string property called %s\n",
+				        static_cast<int>(name.size()),
+				        name.data(),
+				        keyName.c_str());
+			}
+			if (!item.validator.empty())
+			{
+				validator = configNamespace;
+				validator += "validate_items<";
+				validator += item.validator;
+				validator += '>';
+			}
+			// libucl compares every pair of items.  Strings and integers are
+			// checked by generated code with a hash set instead.
+			if (a.uniqueItems() && ((itemKind == SchemaBase::TypeString) ||
+			                        (itemKind == SchemaBase::TypeInteger)))
+			{
+				std::string v = configNamespace;
+				v += "validate_unique<";
+				v += (itemKind == SchemaBase::TypeString) ? "std::string_view"
+				                                          : "int64_t";
+				v += '>';
+				add_validator(v);
+				ucl_object_delete_key((ucl_object_t *)a.obj, "uniqueItems");
+			}
+			itemType    = item.returnType;
+			itemAdaptor = item.adaptorNamespace;
+			itemAdaptor += item.adaptor;
+			maxItems = a.maxItems().value_or(0);
+			// Arrays with a fixed number of items can be indexed without
+			// checking whether the item exists.
+			if (auto length = a.fixedLength())
+			{
+				fixedLength = *length;
+				returnType  = configNamespace;
+				returnType += "FixedRange<";
+				returnType += itemType;
+				returnType += ", ";
+				returnType += itemAdaptor;
+				returnType += ", ";
+				returnType += std::to_string(fixedLength);
+				returnType += '>';
+				adaptor = returnType.substr(configNamespace.size());
+			}
+		}
+
+		/**
+		 * Emit a range class for an array of objects that has an `x-index`.
+		 * The class provides a `find_by_<key>` method that uses a hash index,
+		 * built by the validator and held in the snapshot.
+		 */
+		void emit_index(SchemaVisitor &item, const std::string &key)
+		{
+			std::string base = configNamespace;
+			base += "IndexedRange<";
+			base += item.returnType;
+			base += ", ";
+			base += item.adaptorNamespace;
+			base += item.adaptor;
+			base += ", \"";
+			base += key;
+			base += "\">";
+			std::string method = "find_by_" + key;
+			std::replace(method.begin(), method.end(), '-', '_');
+			returnType = name;
+			returnType += "Range";
+			types << "class " << returnType << " : public " << base
+			      << "{ public: using IndexedRange::IndexedRange;\n"
+			      << "/**\n* Returns the item whose `" << key
+			      << "` is `key`, if there is one.\n*/\n"
+			      << "std::optional<" << item.returnType << "> " << method
+			      << "(std::string_view key) const { return find(key); }};\n";
+			adaptor          = returnType;
+			adaptorNamespace = "";
+			needsSnapshot    = true;
+			snapshotRequired = true;
+			validator        = configNamespace;
+			validator += "validate_index<\"";
+			validator += key;
+			validator += '"';
+			if (!item.validator.empty())
+			{
+				validator += ", ";
+				validator += item.validator;
+			}
+			validator += '>';
+		}
+	};
+
+	/**
+	 * Emit a class.  The class is defined by the object schema `o` and should
+	 * have the name given by the `name` argument.  It will be written to the
+	 * `out` stream.
+	 *
+	 * Returns true if the class has a static `validate` method that must be
+	 * called to check constraints that are not in the embedded schema.
+	 */
+	template<typename T>
+	bool emit_class(Object o, std::string_view name, T &out, bool isRoot)
+	{
+		// Place to write new types.
+		std::stringstream types;
+		// Place to write methods.
+		std::stringstream methods;
+		// The checks for the validate method, one for each property that has
+		// any.
+		std::vector<std::string> validations;
+		// Place to write the cases of the `get` method.
+		std::stringstream getters;
+		// Place to write the names of properties, which `compact` keeps.
+		std::stringstream propertyNames;
+		// Place to write calls to compact the values of properties.
+		std::stringstream compactions;
+		// Place to write the names of properties for the access profile.
+		std::stringstream profileNames;
+		// Place to write the entries of the field table.
+		std::stringstream fieldTable;
+		// Place to write the comparisons for `operator==`.
+		std::stringstream comparisons;
+		// Place to write the statements that compute the hash.
+		std::stringstream hashes;
+		// Properties that are decoded when the class is constructed.
+		std::vector<MaterializedField> fields;
+		// Properties that are packed into bits when the class is constructed.
+		std::vector<PackedField> packed;
+		// The number of accesses to packed properties in the layout profile.
+		uint64_t packedCount = 0;
+		// The number of properties.
+		size_t propertyCount = 0;
+		// Set if an accessor reads the document, rather than a field.
+		bool needsDocument = false;
+		// Set of the required properties.
+		std::unordered_set<std::string_view> required_properties;
+
+		// Collect the required properties in a set.
+		if (auto required = o.required())
+		{
+			for (auto prop : *required)
+			{
+				required_properties.insert(prop);
+			}
+		}
+
+		// Generate a method for each property.
+		for (auto prop : o.properties())
+		{
+			std::string_view prop_name   = prop.key();
+			std::string_view method_name = prop_name;
+
+			std::string method_name_buffer;
+
+			bool isRequired = required_properties.contains(prop_name);
+
+			// FIXME: Do a proper regex match
+			if (method_name.find('-') != std::string::npos)
+			{
+				method_name_buffer = method_name;
+				std::replace(method_name_buffer.begin(),
+				             method_name_buffer.end(),
+				             '-',
+				             '_');
+				method_name = method_name_buffer;
+			}
+
+			// If there is a description, put it in a doc comment
+			std::string doc;
+			if (auto description = prop.description())
+			{
+				doc = "\n/**\n* ";
+				doc += *description;
+				doc += "\n*/\n";
+				ucl_object_delete_key(prop.obj, "description");
+			}
+
+			// Visit the schema describing this property to collect any types.
+			SchemaVisitor v(method_name, types);
+			prop.get().visit(v);
+			v.fold_constant(prop);
+			// A required property with a single valid value has the same
+			// value in every valid object.
+			bool isConstant = isRequired && !v.constant.empty();
+			if (!v.validator.empty())
+			{
+				validations.push_back("if (auto *p = ucl_object_lookup(o, \"" +
+				                      std::string(prop_name) + "\")) { if (!" +
+				                      v.validator +
+				                      "(p, err, snapshot)) { return false; } }\n");
+			}
+			propertyNames << '"' << prop_name << "\",";
+			if (!v.compactor.empty())
+			{
+				compactions << "if (auto *p = (ucl_object_t *)"
+				               "ucl_object_lookup(o, \""
+				            << prop_name << "\")) { " << v.compactor
+				            << "(p); }\n";
+			}
+			getters << "if constexpr (std::string_view(Key) == \"" << prop_name
+			        << "\") { return " << method_name << "(); } else ";
+			if (!isConstant)
+			{
+				comparisons << "&& (" << method_name << "() == other."
+				            << method_name << "())";
+				hashes << "hash = " << configNamespace << "hash_combine(hash, "
+				       << configNamespace << "value_hash(" << method_name
+				       << "()));\n";
+			}
+			std::string counter;
+			if (isRoot && countAccesses && !isConstant)
+			{
+				counter = "accessCounts[" + std::to_string(propertyCount) +
+				          "].fetch_add(1, std::memory_order_relaxed);";
+			}
+			profileNames << '"' << prop_name << "\",";
+			// Scalar properties can be decoded by the generic routine.
+			auto materializedType = materializedTypes.find(v.returnType);
+			bool isScalar         = !v.needsSnapshot &&
+			                (materializedType != materializedTypes.end());
+			std::string tableEntry;
+			if (tableDriven)
+			{
+				tableEntry = "fieldTable[" + std::to_string(propertyCount) +
+				             ']';
+				fieldTable << "{\"" << prop_name << "\", " << prop_name.size()
+				           << ", " << configNamespace
+				           << (isScalar ? "field_kind<" + v.returnType + '>'
+				                        : std::string("FieldKind::Object"))
+				           << "},\n";
+			}
+			propertyCount++;
+			// Scalar properties of the config class, and arrays of a fixed
+			// number of scalars, can be decoded once.
+			std::string fieldType    = v.returnType;
+			std::string fieldAdaptor = std::string(v.adaptorNamespace);
+			fieldAdaptor += v.adaptor;
+			std::string_view fieldLifetime = v.lifetimeAttribute;
+			auto             fieldItem = materializedTypes.find(v.itemType);
+			bool             canMaterialize = isScalar;
+			bool             byReference    = false;
+			size_t           size           = 0;
+			size_t           align          = 0;
+			if (isScalar)
+			{
+				std::tie(size, align) = materializedType->second;
+			}
+			else if ((v.fixedLength > 0) && !v.needsSnapshot &&
+			         (fieldItem != materializedTypes.end()))
+			{
+				std::string length = std::to_string(v.fixedLength);
+				fieldType = "std::array<" + v.itemType + ", " + length + '>';
+				fieldAdaptor = configNamespace + "FixedArrayAdaptor<" +
+				               v.itemType + ", " + v.itemAdaptor + ", " +
+				               length + '>';
+				fieldLifetime  = "CONFIG_LIFETIME_BOUND";
+				canMaterialize = true;
+				byReference    = true;
+				size           = fieldItem->second.first * v.fixedLength;
+				align          = fieldItem->second.second;
+			}
+			else if ((v.maxItems > 0) && (v.maxItems <= SmallVectorMaxItems) &&
+			         !v.needsSnapshot && (fieldItem != materializedTypes.end()))
+			{
+				std::string capacity = std::to_string(v.maxItems);
+				fieldType = configNamespace + "SmallVector<" + v.itemType +
+				            ", " + capacity + '>';
+				fieldAdaptor = configNamespace + "SmallVectorAdaptor<" +
+				               v.itemType + ", " + v.itemAdaptor + ", " +
+				               capacity + '>';
+				fieldLifetime  = "CONFIG_LIFETIME_BOUND";
+				canMaterialize = true;
+				byReference    = true;
+				align          = fieldItem->second.second;
+				// The items are followed by a one-byte length.
+				size = fieldItem->second.first * v.maxItems + 1;
+				size = (size + align - 1) / align * align;
+			}
+			// Booleans and string enumerations of the config class are
+			// packed into as few bits as possible.
+			bool isEnum = !v.enumValues.empty();
+			if (isRoot && materialize && !isConstant &&
+			    ((v.returnType == "bool") || isEnum))
+			{
+				PackedField field{std::string(method_name),
+				                  std::string(prop_name),
+				                  std::move(v.enumValues),
+				                  std::move(doc),
+				                  std::move(counter),
+				                  isRequired};
+				if (isEnum)
+				{
+					field.width = std::bit_width(field.values.size());
+				}
+				else
+				{
+					field.width = isRequired ? 1 : 2;
+				}
+				auto profiled = layoutProfile.find(std::string(prop_name));
+				if (profiled != layoutProfile.end())
+				{
+					packedCount += profiled->second;
+				}
+				packed.push_back(std::move(field));
+				continue;
+			}
+			if (isRoot && materialize && canMaterialize && !isConstant)
+			{
+				std::string lookup = "ucl_object_lookup(o, \"";
+				lookup += prop_name;
+				lookup += "\")";
+				MaterializedField field{std::string(method_name)};
+				if (isRequired)
+				{
+					field.type        = fieldType;
+					field.initializer = fieldAdaptor + "(" + lookup + ")";
+				}
+				else
+				{
+					field.type        = "std::optional<" + fieldType + ">";
+					field.initializer = configNamespace + "make_optional<" +
+					                    fieldAdaptor + ", " + fieldType +
+					                    ">(" + lookup + ")";
+					// The flag is padded to the alignment of the value.
+					size += align;
+				}
+				field.doc               = std::move(doc);
+				field.counter           = std::move(counter);
+				field.lifetimeAttribute = fieldLifetime;
+				field.byReference       = byReference;
+				field.size              = size;
+				field.align             = align;
+				auto profiled = layoutProfile.find(std::string(prop_name));
+				if (profiled != layoutProfile.end())
+				{
+					field.count = profiled->second;
+				}
+				fields.push_back(std::move(field));
+				continue;
+			}
+			needsDocument |= !isConstant;
+			methods << doc;
+			// Generate the method.  If it is not a required property, it must
+			// return a `std::optional<T>`.
+			std::string_view snapshotArg = v.needsSnapshot ? ", snapshot" : "";
+			std::string      lookup      = "obj[\"";
+			lookup += prop_name;
+			lookup += "\"]";
+			if (tableDriven)
+			{
+				lookup = configNamespace + "lookup_field(obj, " + tableEntry +
+				         ')';
+			}
+			if (isConstant)
+			{
+				methods << "static constexpr " << v.returnType << ' '
+				        << method_name << "() { return " << v.constant << ";}";
+			}
+			else if (!v.constant.empty())
+			{
+				methods << "std::optional<" << v.returnType << "> "
+				        << method_name << "() const {" << counter << "if ("
+				        << (tableDriven ? lookup
+				                        : "ucl_object_lookup(obj, \"" +
+				                            std::string(prop_name) + "\")")
+				        << " == nullptr) { return std::nullopt; } return "
+				        << v.constant << ";}";
+			}
+			else if (tableDriven && isScalar)
+			{
+				methods << (isRequired ? v.returnType
+				                       : "std::optional<" + v.returnType + '>')
+				        << ' ' << method_name << "() const "
+				        << v.lifetimeAttribute << " {" << counter << "return "
+				        << configNamespace
+				        << (isRequired ? "table_field<" : "table_optional_field<")
+				        << v.returnType << ">(obj, " << tableEntry << ");}";
+			}
+			else if (isRequired)
+			{
+				methods << v.returnType << ' ' << method_name << "() const "
+				        << v.lifetimeAttribute << " {" << counter
+				        << "return " << v.adaptorNamespace << v.adaptor << '('
+				        << lookup << snapshotArg << ");}";
+			}
+			else
+			{
+				methods << "std::optional<" << v.returnType << "> "
+				        << method_name << "() const " << v.lifetimeAttribute
+				        << " {" << counter << "return " << configNamespace
+				        << "make_optional<"
+				        << v.adaptorNamespace << v.adaptor << ", "
+				        << v.returnType << ">(" << lookup << snapshotArg
+				        << ");}";
+			}
+			methods << "\n\n";
+		}
+
+		// Allocate the packed fields to 64-bit words, first fit in schema
+		// order.  The words are laid out like any other field.
+		std::vector<size_t> usedBits;
+		for (auto &field : packed)
+		{
+			size_t word = 0;
+			while ((word < usedBits.size()) &&
+			       (usedBits[word] + field.width > 64))
+			{
+				word++;
+			}
+			if (word == usedBits.size())
+			{
+				usedBits.push_back(0);
+			}
+			field.offset = word * 64 + usedBits[word];
+			usedBits[word] += field.width;
+		}
+		if (!packed.empty())
+		{
+			MaterializedField field{"packedBits"};
+			field.type = configNamespace + "PackedBits<" +
+			             std::to_string(usedBits.size()) + '>';
+			field.initializer = "pack_bits(o)";
+			field.count       = packedCount;
+			field.size        = usedBits.size() * 8;
+			field.align       = 8;
+			field.hasAccessor = false;
+			fields.push_back(std::move(field));
+		}
+
+		// With a profile, pack the most frequently accessed fields into the
+		// first cache line and move the rest behind a pointer.
+		bool split = !layoutProfile.empty() && !fields.empty();
+		if (split)
+		{
+			std::vector<MaterializedField *> byCount;
+			for (auto &field : fields)
+			{
+				byCount.push_back(&field);
+				field.hot = false;
+			}
+			std::stable_sort(
+			  byCount.begin(), byCount.end(), [](auto *a, auto *b) {
+				  return a->count > b->count;
+			  });
+			// Sizes are multiples of alignments, so if the hot fields are
+			// sorted by alignment there is no padding between them.
+			size_t hotSize = 0;
+			for (auto *field : byCount)
+			{
+				if ((field->count > 0) &&
+				    (hotSize + field->size <= CacheLineSize))
+				{
+					field->hot = true;
+					hotSize += field->size;
+				}
+			}
+		}
+		// Emit a struct holding the hot or cold fields.  Hot fields are sorted
+		// by alignment, cold fields are kept in schema order.
+		auto emit_fields = [&](std::string_view structName, bool hot) {
+			std::vector<MaterializedField *> members;
+			for (auto &field : fields)
+			{
+				if (field.hot == hot)
+				{
+					members.push_back(&field);
+				}
+			}
+			if (hot && split)
+			{
+				std::stable_sort(
+				  members.begin(), members.end(), [](auto *a, auto *b) {
+					  return a->align > b->align;
+				  });
+			}
+			out << "struct " << structName << " {";
+			for (auto *field : members)
+			{
+				out << field->type << ' ' << field->name << ";\n";
+			}
+			out << structName << "(const ucl_object_t *o)";
+			char separator = ':';
+			for (auto *field : members)
+			{
+				out << separator << field->name << '(' << field->initializer
+				    << ')';
+				separator = ',';
+			}
+			out << "{}};\n";
+			for (auto *field : members)
+			{
+				out << "static_assert(sizeof(" << field->type
+				    << ") == " << field->size << ");\n";
+			}
+			return !members.empty();
+		};
+
+		// Generate the class definition
+		out << "class " << (split ? "alignas(64) " : "") << name << "{";
+		std::string_view hotName   = split ? "hot" : "fields";
+		bool             hasFields = false;
+		bool             hasCold   = false;
+		if (!fields.empty())
+		{
+			hasFields = emit_fields(split ? "Hot" : "Fields", true);
+			out << (split ? "Hot" : "Fields") << ' ' << hotName << ";\n";
+			if (split)
+			{
+				out << "static_assert(sizeof(Hot) <= " << CacheLineSize
+				    << ");\n";
+				hasCold = emit_fields("Cold", false);
+				if (hasCold)
+				{
+					out << configNamespace << "ColdPtr<Cold> cold;\n";
+				}
+			}
+		}
+		if (fieldTable.tellp() > 0)
+		{
+			out << "/**\n* The properties of this class, in schema order.\n*/\n"
+			    << "static constexpr " << configNamespace
+			    << "FieldDescriptor fieldTable[] = {" << fieldTable.str()
+			    << "};\n";
+		}
+		out << configNamespace << "UCLPtr obj; " << configNamespace
+		    << "SnapshotPtr snapshot; " << configNamespace
+		    << "CachedHash hashCache; public:\n";
+
+		// Generate the constructor.
+		out << name << "(const ucl_object_t *o, " << configNamespace
+		    << "SnapshotPtr s = nullptr) : ";
+		if (hasFields)
+		{
+			out << hotName << "(o), ";
+		}
+		if (hasCold)
+		{
+			out << "cold(o), ";
+		}
+		out << "obj(o), snapshot(std::move(s)) {}\n";
+
+		out << types.str();
+		out << methods.str();
+		// Generate the accessors for the materialized fields.  Each one
+		// returns the expression `source`, so that they can be emitted again
+		// for the `View` of the columns of a pool.
+		auto field_accessor = [](const MaterializedField &field,
+		                         std::string_view         source) {
+			std::stringstream accessor;
+			accessor << field.doc << (field.byReference ? "const " : "")
+			         << field.type << (field.byReference ? " &" : " ")
+			         << field.name << "() const " << field.lifetimeAttribute
+			         << " {" << field.counter << "return " << source
+			         << ";}\n\n";
+			return accessor.str();
+		};
+		// Returns the expression for a materialized field of this class.
+		auto field_member = [&](const MaterializedField &field) {
+			return (field.hot ? std::string(hotName) + '.'
+			                  : std::string("cold->")) +
+			       field.name;
+		};
+		std::string packedBits;
+		for (auto &field : fields)
+		{
+			if (!field.hasAccessor)
+			{
+				packedBits = field_member(field) + '.';
+				continue;
+			}
+			out << field_accessor(field, field_member(field));
+		}
+
+		// Generate the accessors for the packed fields, which read the bits
+		// from the `PackedBits` expression `source`, and the method that
+		// packs them.
+		auto packed_accessor = [](const PackedField &field,
+		                          const std::string &source) {
+			std::stringstream accessor;
+			std::string       bits = source + "get<" +
+			                   std::to_string(field.offset) + ", " +
+			                   std::to_string(field.width) + ">()";
+			std::string_view type =
+			  field.values.empty() ? "bool" : "std::string_view";
+			accessor << field.doc;
+			if (field.isRequired)
+			{
+				accessor << type << ' ' << field.name << "() const {"
+				         << field.counter << "return ";
+			}
+			else
+			{
+				accessor << "std::optional<" << type << "> " << field.name
+				         << "() const {" << field.counter << "auto value = "
+				         << bits << "; if (value == 0) { "
+				         << "return std::nullopt; } return ";
+				bits = "value";
+			}
+			if (!field.values.empty())
+			{
+				accessor << field.name << "Values[" << bits << "];}\n\n";
+			}
+			else if (field.isRequired)
+			{
+				accessor << bits << " != 0;}\n\n";
+			}
+			else
+			{
+				accessor << bits << " == 2;}\n\n";
+			}
+			return accessor.str();
+		};
+		std::stringstream packings;
+		for (auto &field : packed)
+		{
+			std::string set = "bits.set<" + std::to_string(field.offset) +
+			                  ", " + std::to_string(field.width) + ">(";
+			std::string lookup = "ucl_object_lookup(o, \"" + field.property +
+			                     "\")";
+			std::string values = field.name + "Values";
+			out << packed_accessor(field, packedBits);
+			if (!field.values.empty())
+			{
+				out << "static constexpr std::string_view " << values
+				    << "[] = {std::string_view(\"\", 0), ";
+				for (auto &value : field.values)
+				{
+					out << value << ", ";
+				}
+				out << "};\n\n";
+				packings << set << configNamespace << "enum_code(" << lookup
+				         << ", " << values << "));\n";
+			}
+			else if (field.isRequired)
+			{
+				packings << set << "static_cast<bool>(" << configNamespace
+				         << "BoolAdaptor(" << lookup << ")));\n";
+			}
+			else
+			{
+				packings << "if (auto *p = " << lookup << ") { " << set
+				         << "static_cast<bool>(" << configNamespace
+				         << "BoolAdaptor(p)) ? 2 : 1); }\n";
+			}
+		}
+		if (!packed.empty())
+		{
+			out << "/**\n* Pack the booleans and string enumerations of `o` "
+			       "into bits.\n*/\n"
+			    << "static " << configNamespace << "PackedBits<"
+			    << usedBits.size() << "> pack_bits(const ucl_object_t *o) {"
+			    << configNamespace << "PackedBits<" << usedBits.size()
+			    << "> bits;\n"
+			    << packings.str() << "return bits;}\n";
+		}
+
+		// Generate a method that removes the properties that are not in the
+		// schema.
+		out << "/**\n* Remove properties that are not in the schema from `o` "
+		       "and from any objects that it contains.\n*/\n"
+		    << "static void compact(ucl_object_t *o) {" << configNamespace
+		    << "compact_object(o, {" << propertyNames.str() << "});\n"
+		    << compactions.str() << "}\n";
+
+		// Generate equality and hashing over the properties in the schema.
+		// Objects that share a UCL object are equal without comparing their
+		// properties, and objects whose hashes are already known and differ
+		// are not equal.  Comparing does not compute hashes, which would
+		// visit every property on both sides before the comparison does.
+		// Hashes and the results of comparisons are kept in the snapshot,
+		// where there is one, so that they survive the objects returned by
+		// accessors and each pair of subtrees is compared once.
+		out << "/**\n* Returns true if every property in the schema is equal "
+		       "in this and `other`.\n*/\n"
+		    << "bool operator==(const " << name << " &other) const {"
+		    << "if (static_cast<const ucl_object_t *>(obj) == other.obj) { "
+		       "return true; }\n"
+		    << "if (!" << configNamespace
+		    << "may_be_equal(known_hash(), other.known_hash())) { return "
+		       "false; }\n"
+		    << "auto compare = [&]() { return true " << comparisons.str()
+		    << "; };\n"
+		    << "return (snapshot && other.snapshot) ? snapshot->equal(obj, "
+		       "other.snapshot, other.obj, compare) : compare(); }\n"
+		    << "/**\n* Returns the hash if it has already been computed, by "
+		       "this object or by another for the same part of the "
+		       "snapshot, or zero.\n*/\n"
+		    << "uint64_t known_hash() const { if (uint64_t hash = "
+		       "hashCache.peek()) { return hash; }\n"
+		    << "return snapshot ? snapshot->peek_hash(obj) : 0; }\n"
+		    << "/**\n* Returns a hash of the properties in the schema.  This "
+		       "is computed once and kept by copies and by the snapshot.\n*/"
+		       "\n"
+		    << "uint64_t hash() const { return hashCache.get([&]() { "
+		    << "auto compute = [&]() { uint64_t hash = 0;\n"
+		    << hashes.str() << "return hash; };\n"
+		    << "return snapshot ? snapshot->hash(obj, compute) : compute(); "
+		       "}); }\n";
+
+		// Generate a method that reports the memory used by a config, for
+		// caches that are bounded by size.
+		if (isRoot)
+		{
+			out << "/**\n* Returns the number of bytes used by this config, its "
+			       "document, and its snapshot.  See `ucl_object_bytes` and "
+			       "`Snapshot::bytes` for what is measured.\n*/\n"
+			    << "size_t bytes() const { return sizeof(*this) + "
+			    << configNamespace << "ucl_object_bytes(obj) + "
+			    << "(snapshot ? snapshot->bytes() : 0)"
+			    << (hasCold ? " + cold.heap_bytes()" : "") << ";}\n";
+		}
+
+		// Generate a method that maps property names to accessors at compile
+		// time, used to resolve JSON Pointers.
+		std::string getMethod =
+		  "/**\n* Returns the property called `Key`.\n*/\ntemplate<" +
+		  configNamespace + "StringLiteral Key> auto get() const {" +
+		  getters.str() + "{ static_assert(" + configNamespace +
+		  "NoSuchProperty<Key>, \"No such property\"); } }\n";
+		out << getMethod;
+
+		// Generate the columns that `ConfigPool` stores configs in, with an
+		// array for each materialized field, and a view of one row with the
+		// same accessors as this class.  The documents and snapshots are
+		// only stored if an accessor reads them.
+		if (isRoot && materialize)
+		{
+			std::stringstream columns;
+			std::stringstream stores;
+			std::stringstream clears;
+			std::stringstream interns;
+			std::stringstream view;
+			for (auto &field : fields)
+			{
+				columns << "std::array<" << field.type << ", N> " << field.name
+				        << "{};\n";
+				stores << field.name << "[row] = " << configNamespace
+				       << "intern_field(arena, config." << field_member(field)
+				       << ");\n";
+				clears << field.name << "[row] = {};\n";
+				interns << field.name << "[i] = " << configNamespace
+				        << "intern_field(*arena, " << field.name << "[i]);\n";
+				if (field.hasAccessor)
+				{
+					view << field_accessor(field,
+					                       "columns->" + field.name + "[row]");
+				}
+			}
+			for (auto &field : packed)
+			{
+				view << packed_accessor(field, "columns->packedBits[row].");
+			}
+			if (needsDocument)
+			{
+				columns << "std::array<" << configNamespace
+				        << "UCLPtr, N> obj{};\nstd::array<" << configNamespace
+				        << "SnapshotPtr, N> snapshot{};\n";
+				stores << "obj[row] = config.obj;\n"
+				          "snapshot[row] = config.snapshot;\n";
+				clears << "obj[row] = " << configNamespace
+				       << "UCLPtr();\nsnapshot[row] = nullptr;\n";
+			}
+			out << "/**\n* The configs of up to `N` tenants, stored as an "
+			       "array for each field, for `ConfigPool`.  Strings are "
+			       "interned in `strings`.\n*/\n"
+			    << "template<size_t N> struct Columns {" << columns.str()
+			    << "/**\n* Set for the rows that hold a config.\n*/\n"
+			    << "std::array<bool, N> present{};\n"
+			    << "/**\n* The strings that the fields refer to.\n*/\n"
+			    << "std::shared_ptr<const " << configNamespace
+			    << "StringArena> strings;\n"
+			    << "/**\n* Store `config` in `row`, interning its strings in "
+			       "`arena`.\n*/\n"
+			    << "void store(size_t row, const " << name << " &config, "
+			    << configNamespace << "StringArena &arena) {" << stores.str()
+			    << "present[row] = true;}\n"
+			    << "/**\n* Remove the config in `row`.\n*/\n"
+			    << "void clear(size_t row) {" << clears.str()
+			    << "present[row] = false;}\n"
+			    << "/**\n* Copy the strings of every row into `arena`, which "
+			       "replaces `strings`.\n*/\n"
+			    << "void intern_strings(std::shared_ptr<" << configNamespace
+			    << "StringArena> arena) { for (size_t i = 0; i < N; i++) { if "
+			       "(present[i]) {"
+			    << interns.str() << "} } strings = std::move(arena); }\n};\n"
+			    << "/**\n* A config in a row of `Columns`, with the same "
+			       "accessors as this class.  The view keeps the columns "
+			       "alive.\n*/\n"
+			    << "template<size_t N> class View { std::shared_ptr<const "
+			       "Columns<N>> columns; size_t row;\n";
+			if (needsDocument)
+			{
+				out << "const " << configNamespace << "UCLPtr &obj; const "
+				    << configNamespace << "SnapshotPtr &snapshot;\n";
+			}
+			out << "public:\n/**\n* Constructor, for the config in `r` of "
+			       "`c`.\n*/\n"
+			    << "View(std::shared_ptr<const Columns<N>> c, size_t r) : "
+			       "columns(std::move(c)), row(r)"
+			    << (needsDocument ? ", obj(columns->obj[r]), "
+			                        "snapshot(columns->snapshot[r])"
+			                      : "")
+			    << " {}\n"
+			    << methods.str() << view.str() << getMethod << "};\n";
+		}
+
+		// Generate the counters that produce a profile for the layout.
+		if (isRoot && countAccesses && (propertyCount > 0))
+		{
+			out << "/**\n* The number of calls to each accessor.\n*/\n"
+			    << "static inline std::atomic<uint64_t> accessCounts["
+			    << propertyCount << "];\n"
+			    << "/**\n* Write the number of calls to each accessor to `f`, "
+			       "in the format read by `config-gen --layout-profile`.\n*/"
+			       "\n"
+			    << "static void write_access_profile(FILE *f) {"
+			    << "static const char *names[] = {" << profileNames.str()
+			    << "};\n"
+			    << "for (size_t i = 0; i < " << propertyCount
+			    << "; i++) { fprintf(f, \"%s %llu\\n\", names[i], "
+			       "static_cast<unsigned long long>(accessCounts[i].load()));"
+			       " } }\n";
+		}
+
+		// The root class's checks are also split into a step for each
+		// property, so that an asynchronous load can run a few at a time.
+		bool hasValidator = !validations.empty();
+		if (isRoot)
+		{
+			out << "/**\n* The number of steps that `validate_step` splits "
+			       "`validate` into, one for each top-level property that has "
+			       "constraints that are not checked by the embedded "
+			       "schema.\n*/\n"
+			    << "static constexpr size_t validationSteps = "
+			    << validations.size() << ";\n"
+			    << "/**\n* Run step `i` of `validate`.\n*/\n"
+			    << "static bool validate_step(size_t i, [[maybe_unused]] const "
+			       "ucl_object_t *o, [[maybe_unused]] ucl_schema_error *err, "
+			       "[[maybe_unused]] "
+			    << configNamespace << "Snapshot *snapshot) { switch (i) {";
+			for (size_t i = 0; i < validations.size(); i++)
+			{
+				out << "case " << i << ": {" << validations[i] << "break; }\n";
+			}
+			out << "} return true; }\n";
+		}
+		if (hasValidator)
+		{
+			out << "/**\n* Check the constraints that are not checked by the "
+			       "embedded schema.\n*/\n"
+			    << "static bool validate(const ucl_object_t *o, "
+			       "ucl_schema_error *err, "
+			    << configNamespace << "Snapshot *snapshot) {";
+			if (isRoot)
+			{
+				out << "for (size_t i = 0; i < validationSteps; i++) { if "
+				       "(!validate_step(i, o, err, snapshot)) { return false; "
+				       "} }\n";
+			}
+			else
+			{
+				for (auto &validation : validations)
+				{
+					out << validation;
+				}
+			}
+			out << "return true; }\n";
+		}
+
+		out << "};\n";
+		return hasValidator;
+	}
+
+	/**
+	 * Bounds on the shape of the documents that are valid for a schema.
+	 */
+	struct SchemaBounds
+	{
+		/**
+		 * The greatest nesting depth, with scalars at depth one.
+		 */
+		size_t depth = 1;
+
+		/**
+		 * The greatest number of values, including objects and arrays.
+		 */
+		size_t nodes = 1;
+
+		/**
+		 * The greatest number of items in any array.
+		 */
+		size_t arrayLength = 0;
+	};
+
+	/**
+	 * Returns the bounds on the documents that are valid for the schema `s`,
+	 * or nothing if they are unbounded because an object allows properties
+	 * that are not in the schema or an array has no `maxItems`.  Counts
+	 * saturate rather than overflowing.
+	 */
+	std::optional<SchemaBounds> schema_bounds(SchemaBase s)
+	{
+		auto add = [](size_t a, size_t b) {
+			return (a > SIZE_MAX - b) ? SIZE_MAX : a + b;
+		};
+		auto multiply = [](size_t a, size_t b) {
+			return ((b != 0) && (a > SIZE_MAX / b)) ? SIZE_MAX : a * b;
+		};
+		if (ucl_object_type(s.obj["type"]) != UCL_STRING)
+		{
+			return std::nullopt;
+		}
+		switch (s.type())
+		{
+			case SchemaBase::TypeObject:
+			{
+				Object o(s.obj);
+				if (!o.closed())
+				{
+					return std::nullopt;
+				}
+				SchemaBounds bounds;
+				for (auto prop : o.properties())
+				{
+					auto inner = schema_bounds(prop);
+					if (!inner)
+					{
+						return std::nullopt;
+					}
+					bounds.depth = std::max(bounds.depth, inner->depth + 1);
+					bounds.nodes = add(bounds.nodes, inner->nodes);
+					bounds.arrayLength =
+					  std::max(bounds.arrayLength, inner->arrayLength);
+				}
+				return bounds;
+			}
+			case SchemaBase::TypeArray:
+			{
+				Array a(s.obj);
+				auto  maxItems = a.maxItems();
+				auto  inner    = schema_bounds(a.items());
+				if (!maxItems || !inner)
+				{
+					return std::nullopt;
+				}
+				size_t length = std::min<uint64_t>(*maxItems, SIZE_MAX);
+				return SchemaBounds{inner->depth + 1,
+				                    add(1, multiply(length, inner->nodes)),
+				                    std::max(length, inner->arrayLength)};
+			}
+			default:
+				return SchemaBounds{};
+		}
+	}
+
+	/**
+	 * Emits a config document as `constexpr` values.  Each object schema
+	 * becomes an aggregate class with the same name and accessors as the
+	 * generated class, which holds the decoded values rather than a UCL
+	 * object, and each array becomes a span over a `constexpr` array.
+	 *
+	 * The document must already have been checked against the embedded
+	 * schema.  The constraints that generated code checks instead of libucl
+	 * are checked while baking.
+	 */
+	class Baker
+	{
+		/**
+		 * The name of the baked config, used as a prefix for the names of the
+		 * arrays that it refers to.
+		 */
+		std::string instanceName;
+
+		/**
+		 * Definitions of the arrays that baked values refer to.  Arrays are
+		 * defined before any array that refers to them.
 		 */
-		void operator()(Number n)
+		std::stringstream arrays;
+
+		/**
+		 * The number of arrays that have been defined.
+		 */
+		size_t arrayCount = 0;
+
+		/**
+		 * Output for types that are not needed.
+		 */
+		std::stringstream discarded;
+
+		/**
+		 * Report that the value at `path` in the document cannot be baked and
+		 * exit.
+		 */
+		[[noreturn]] static void fail(const std::string &path,
+		                              const char        *message)
 		{
-			handleNumber(n, false);
+			fprintf(stderr,
+			        "Cannot bake %s: %s\n",
+			        path.empty() ? "/" : path.c_str(),
+			        message);
+			exit(EXIT_FAILURE);
 		}
 
 		/**
-		 * Handle an object schema.  This does a recursive visit to generate a
-		 * new class that represents the object.
+		 * Returns the name of the accessor for the property `property`.
 		 */
-		void operator()(Object o)
+		static std::string member_name(std::string_view property)
 		{
-			returnType = name;
-			returnType += "Class";
-			emit_class(o, returnType, types);
-			adaptor          = returnType;
-			adaptorNamespace = "";
+			std::string name{property};
+			std::replace(name.begin(), name.end(), '-', '_');
+			return name;
 		}
 
 		/**
-		 * Handle an array.  This performs a recursive visit to generate a new
-		 * class representing the array element type.
-		 *
-		 * Note that this currently handles only arrays of a single object
-		 * type, not heterogeneous arrays.
+		 * Returns the names of the required properties of `o`.
 		 */
-		void operator()(Array a)
+		static std::unordered_set<std::string_view> required(Object o)
 		{
-			std::string itemName{name};
-			itemName += "Item";
-			SchemaVisitor item(itemName, types);
-			auto          items = a.items();
-			items.get().visit(item);
-			returnType = configNamespace;
-			returnType += "Range<";
-			returnType += item.returnType;
-			returnType += ", ";
-			returnType += item.adaptorNamespace;
-			returnType += item.adaptor;
-			returnType += ", true>";
-			adaptor          = returnType;
-			adaptor          = adaptor.substr(configNamespace.size());
-			adaptorNamespace = configNamespace;
+			std::unordered_set<std::string_view> names;
+			if (auto required = o.required())
+			{
+				for (auto name : *required)
+				{
+					names.insert(name);
+				}
+			}
+			return names;
 		}
-	};
-
-	/**
-	 * Emit a class.  The class is defined by the object schema `o` and should
-	 * have the name given by the `name` argument.  It will be written to the
-	 * `out` stream.
-	 */
-	template<typename T>
-	void emit_class(Object o, std::string_view name, T &out)
-	{
-		// Place to write new types.
-		std::stringstream types;
-		// Place to write methods.
-		std::stringstream methods;
-		// Set of the required properties.
-		std::unordered_set<std::string_view> required_properties;
 
-		// Collect the required properties in a set.
-		if (auto required = o.required())
+		/**
+		 * Returns the bytes of an address as the body of a C++ array
+		 * initialiser.
+		 */
+		template<size_t N>
+		static std::string bytes_literal(const std::array<uint8_t, N> &bytes)
 		{
-			for (auto prop : *required)
+			std::string literal = "{";
+			for (uint8_t byte : bytes)
 			{
-				required_properties.insert(prop);
+				literal += std::to_string(byte);
+				literal += ',';
 			}
+			literal += '}';
+			return literal;
 		}
 
-		// Generate the class definition
-		out << "class " << name << "{" << configNamespace
-		    << "UCLPtr obj; public:\n";
+		/**
+		 * Visit a copy of the schema `s` for a property called `name`, so
+		 * that `s` is not modified, and return the visitor.  The copy has no
+		 * pattern, because patterns are checked by `bake_scalar`.
+		 */
+		SchemaVisitor visit_copy(SchemaBase s, std::string_view name)
+		{
+			UCLPtr copy{ucl_object_copy(s.obj)};
+			// The `UCLPtr` holds its own reference.
+			ucl_object_unref(copy);
+			ucl_object_delete_key(copy, "pattern");
+			SchemaVisitor visitor(name, discarded);
+			SchemaBase(copy).get().visit(visitor);
+			return visitor;
+		}
 
-		// Generate the constructor.
-		out << name << "(const ucl_object_t *o) : obj(o) {}\n";
+		/**
+		 * Returns the type of values of the schema `s` for a property called
+		 * `name` in the class `scope`.
+		 */
+		std::string
+		type_of(SchemaBase s, std::string_view name, std::string_view scope)
+		{
+			std::string qualified{scope};
+			qualified += "::";
+			switch (s.type())
+			{
+				case SchemaBase::TypeObject:
+					qualified += name;
+					qualified += "Class";
+					return qualified;
+				case SchemaBase::TypeArray:
+				{
+					std::string itemName{name};
+					itemName += "Item";
+					Array       a(s.obj);
+					std::string span = "std::span<const ";
+					span += type_of(a.items(), itemName, scope);
+					// Arrays with a fixed number of items have a fixed extent.
+					if (auto length = a.fixedLength())
+					{
+						span += ", ";
+						span += std::to_string(*length);
+					}
+					span += '>';
+					return span;
+				}
+				default:
+					return visit_copy(s, name).returnType;
+			}
+		}
 
-		// Generate a method for each property.
-		for (auto prop : o.properties())
+		/**
+		 * Write the classes for any objects in the schema `s`, for a
+		 * property called `name` in the class `scope`, to `out`.
+		 */
+		void emit_types(SchemaBase        s,
+		                std::string_view  name,
+		                const std::string &scope,
+		                std::ostream      &out)
 		{
-			std::string_view prop_name   = prop.key();
-			std::string_view method_name = prop_name;
+			if (s.type() == SchemaBase::TypeObject)
+			{
+				std::string className{name};
+				className += "Class";
+				emit_class(Object(s.obj), className, scope, out);
+			}
+			else if (s.type() == SchemaBase::TypeArray)
+			{
+				std::string itemName{name};
+				itemName += "Item";
+				emit_types(Array(s.obj).items(), itemName, scope, out);
+			}
+		}
 
-			std::string method_name_buffer;
+		/**
+		 * Returns the value `v` of the scalar schema `s`, for a property
+		 * called `name`, as a C++ expression.
+		 */
+		std::string bake_scalar(SchemaBase          s,
+		                        std::string_view    name,
+		                        const ucl_object_t *v,
+		                        const std::string  &path)
+		{
+			auto             visitor = visit_copy(s, name);
+			std::string_view type    = visitor.returnType;
+			if (s.type() == SchemaBase::TypeString)
+			{
+				std::string_view str    = StringViewAdaptor(v);
+				String           schema(s.obj);
 
-			bool isRequired = required_properties.contains(prop_name);
+				auto minLength = schema.minLength();
+				auto maxLength = schema.maxLength();
+				if (minLength || maxLength)
+				{
+					auto length = utf8_length(str);
+					if (!length)
+					{
+						fail(path, "string is not valid UTF-8");
+					}
+					if ((*length < minLength.value_or(0)) ||
+					    (*length > maxLength.value_or(SIZE_MAX)))
+					{
+						fail(path, "string length is not allowed");
+					}
+				}
+				if (auto pattern = schema.pattern())
+				{
+					// Patterns that could not be compiled were checked by
+					// libucl.
+					if (auto dfa = Regex::compile(*pattern))
+					{
+						unsigned state = 1;
+						for (unsigned char c : str)
+						{
+							state =
+							  dfa->transitions[state][dfa->byteClasses[c]];
+						}
+						if (!dfa->accepting[state])
+						{
+							fail(path, "string does not match pattern");
+						}
+					}
+				}
+				auto format = schema.format().value_or("");
+				auto parse  = [&](auto parser) {
+					auto value = parser.parse(str);
+					if (!value)
+					{
+						fail(path, "string is not in the required format");
+					}
+					return *value;
+				};
+				std::string literal = configNamespace;
+				if (format == "ipv4")
+				{
+					literal += "IPv4Address{";
+					literal += bytes_literal(parse(formats::IPv4{}).bytes);
+					return literal + '}';
+				}
+				if (format == "ipv6")
+				{
+					literal += "IPv6Address{";
+					literal += bytes_literal(parse(formats::IPv6{}).bytes);
+					return literal + '}';
+				}
+				if (format == "cidr")
+				{
+					auto prefix = parse(formats::CIDR{});
+					literal += "IPPrefix{{";
+					literal += std::to_string(prefix.address.family);
+					literal += ", ";
+					literal += bytes_literal(prefix.address.bytes);
+					literal += "}, ";
+					literal += std::to_string(prefix.length);
+					return literal + '}';
+				}
+				if (format == "uri")
+				{
+					auto uri = parse(formats::Uri{});
+					literal += "URI{";
+					for (auto component :
+					     {uri.scheme, uri.userinfo, uri.host})
+					{
+						literal += string_literal(component);
+						literal += ", ";
+					}
+					literal += std::to_string(uri.port);
+					for (auto component : {uri.path, uri.query, uri.fragment})
+					{
+						literal += ", ";
+						literal += string_literal(component);
+					}
+					return literal + '}';
+				}
+				if (format == "hostname")
+				{
+					parse(formats::Hostname{});
+				}
+				return string_literal(str);
+			}
+			if (s.type() == SchemaBase::TypeSize)
+			{
+				auto bytes = decode_size(v);
+				if (!bytes)
+				{
+					fail(path, "value is not a valid size");
+				}
+				if ((*bytes < visitor.minSize) || (*bytes > visitor.maxSize) ||
+				    ((*bytes % visitor.sizeMultipleOf) != 0))
+				{
+					fail(path, "size is not allowed by the schema");
+				}
+				std::string literal{type};
+				literal += "(static_cast<";
+				literal += type.substr(type.find('<') + 1);
+				literal.pop_back();
+				literal += ">(";
+				literal += std::to_string(*bytes);
+				literal += "ULL))";
+				return literal;
+			}
+			if (s.type() == SchemaBase::TypeDuration)
+			{
+				auto        count = type.substr(type.find('<') + 1);
+				std::string literal{type};
+				literal += "(static_cast<";
+				literal += count.substr(0, count.size() - 1);
+				literal += ">(";
+				literal += double_literal(ucl_object_todouble(v));
+				literal += "))";
+				return literal;
+			}
+			return number_literal(type, v);
+		}
 
-			// FIXME: Do a proper regex match
-			if (method_name.find('-') != std::string::npos)
+		/**
+		 * Returns the value `v` of the array schema `a`, for a property called
+		 * `name` in the class `scope`, as a C++ expression.  The elements are
+		 * written to a new array.
+		 */
+		std::string bake_array(Array               a,
+		                       std::string_view    name,
+		                       const std::string  &scope,
+		                       const ucl_object_t *v,
+		                       const std::string  &path)
+		{
+			std::string itemName{name};
+			itemName += "Item";
+			auto        items    = a.items();
+			std::string itemType = type_of(items, itemName, scope);
+			std::vector<std::string>             values;
+			std::unordered_set<std::string_view> keys;
+			std::unordered_set<std::string>      distinct;
+			auto                                 key = a.index();
+			Range<UCLPtr>                        elements(v);
+			// The schema that the document was validated against has no
+			// `uniqueItems` for strings and integers.
+			bool isString = items.type() == SchemaBase::TypeString;
+			bool unique   = a.uniqueItems() &&
+			              (isString || (items.type() == SchemaBase::TypeInteger));
+			for (const ucl_object_t *element : elements)
 			{
-				method_name_buffer = method_name;
-				std::replace(method_name_buffer.begin(),
-				             method_name_buffer.end(),
-				             '-',
-				             '_');
-				method_name = method_name_buffer;
+				std::string elementPath = path;
+				elementPath += '/';
+				elementPath += std::to_string(values.size());
+				values.push_back(
+				  bake_value(items, itemName, scope, element, elementPath));
+				if (key)
+				{
+					std::string_view k = StringViewAdaptor(
+					  ucl_object_lookup_len(element, key->data(), key->size()));
+					if (!keys.insert(k).second)
+					{
+						fail(elementPath, "duplicate index key");
+					}
+				}
+				if (unique &&
+				    !distinct
+				       .insert(isString
+				                 ? std::string(std::string_view(StringViewAdaptor(element)))
+				                 : std::to_string(ucl_object_toint(element)))
+				       .second)
+				{
+					fail(elementPath, "duplicate item");
+				}
+			}
+			std::string span = type_of(a, name, scope) + '(';
+			if (values.empty())
+			{
+				return span + ')';
+			}
+			std::string storage = instanceName;
+			storage += "_array";
+			storage += std::to_string(arrayCount++);
+			arrays << "inline constexpr " << itemType << ' ' << storage
+			       << "[] = {";
+			for (auto &value : values)
+			{
+				arrays << value << ",\n";
 			}
+			arrays << "};\n";
+			return span + storage + ')';
+		}
 
-			// If there is a description, put it in a doc comment
-			if (auto description = prop.description())
+		/**
+		 * Returns the value `v` of the object schema `o`, whose class is
+		 * `className`, as a C++ expression.
+		 */
+		std::string bake_object(Object              o,
+		                        const std::string  &className,
+		                        const ucl_object_t *v,
+		                        const std::string  &path)
+		{
+			std::string value = className + "{{";
+			for (auto prop : o.properties())
 			{
-				methods << "\n/**\n* " << *description << "\n*/\n";
-				ucl_object_delete_key(prop.obj, "description");
+				std::string_view key    = prop.key();
+				std::string      member = member_name(key);
+				value += '.';
+				value += member;
+				value += " = ";
+				auto *property = ucl_object_lookup_len(v, key.data(), key.size());
+				if (property == nullptr)
+				{
+					value += "std::nullopt";
+				}
+				else
+				{
+					value += bake_value(prop,
+					                    member,
+					                    className,
+					                    property,
+					                    path + '/' + std::string(key));
+				}
+				value += ",\n";
 			}
+			return value + "}}";
+		}
 
-			// Visit the schema describing this property to collect any types.
-			SchemaVisitor v(method_name, types);
-			prop.get().visit(v);
-			// Generate the method.  If it is not a required property, it must
-			// return a `std::optional<T>`.
-			if (isRequired)
+		/**
+		 * Returns the value `v` of the schema `s`, for a property called
+		 * `name` in the class `scope`, as a C++ expression.
+		 */
+		std::string bake_value(SchemaBase          s,
+		                       std::string_view    name,
+		                       const std::string  &scope,
+		                       const ucl_object_t *v,
+		                       const std::string  &path)
+		{
+			switch (s.type())
 			{
-				methods << v.returnType << ' ' << method_name << "() const "
-				        << v.lifetimeAttribute << " {"
-				        << "return " << v.adaptorNamespace << v.adaptor
-				        << "(obj[\"" << prop_name << "\"]);}";
+				case SchemaBase::TypeObject:
+					return bake_object(Object(s.obj),
+					                   type_of(s, name, scope),
+					                   v,
+					                   path);
+				case SchemaBase::TypeArray:
+					return bake_array(Array(s.obj), name, scope, v, path);
+				default:
+					return bake_scalar(s, name, v, path);
 			}
-			else
+		}
+
+		/**
+		 * Write a class called `name`, whose qualified name is `qualified`,
+		 * for the object schema `o` to `out`.
+		 */
+		void emit_class(Object              o,
+		                std::string_view    name,
+		                const std::string  &scope,
+		                std::ostream       &out)
+		{
+			std::string qualified = scope.empty() ? "" : scope + "::";
+			qualified += name;
+			std::stringstream types;
+			std::stringstream fields;
+			std::stringstream accessors;
+			auto              requiredProperties = required(o);
+			for (auto prop : o.properties())
 			{
-				methods << "std::optional<" << v.returnType << "> "
-				        << method_name << "() const " << v.lifetimeAttribute
-				        << " {"
-				        << "return " << configNamespace << "make_optional<"
-				        << v.adaptorNamespace << v.adaptor << ", "
-				        << v.returnType << ">(obj[\"" << prop_name << "\"]);}";
+				std::string member = member_name(prop.key());
+				emit_types(prop, member, qualified, types);
+				std::string type = type_of(prop, member, qualified);
+				if (!requiredProperties.contains(prop.key()))
+				{
+					type = "std::optional<" + type + '>';
+				}
+				fields << type << ' ' << member << ";\n";
+				if (auto description = prop.description())
+				{
+					accessors << "\n/**\n* " << *description << "\n*/\n";
+				}
+				accessors << "constexpr " << type << ' ' << member
+				          << "() const { return fields." << member << ";}\n";
 			}
-			methods << "\n\n";
+			out << "struct " << name << " {" << types.str()
+			    << "/**\n* The values of the properties.\n*/\n"
+			    << "struct Fields {" << fields.str() << "} fields;\n"
+			    << accessors.str() << "};\n";
 		}
 
-		out << types.str();
-		out << methods.str();
+		public:
+		/**
+		 * Constructor.  The baked config will be called `name`.
+		 */
+		Baker(std::string name) : instanceName(std::move(name)) {}
 
-		out << "};\n";
-	}
+		/**
+		 * Write the class for the root schema `root`, called `className`, and
+		 * the constant for the document `document` to `out`.
+		 */
+		void bake(Object              root,
+		          const std::string  &className,
+		          const ucl_object_t *document,
+		          std::ostream       &out)
+		{
+			emit_class(root, className, "", out);
+			std::string value = bake_object(root, className, document, "");
+			out << arrays.str() << "/**\n* The config that was baked into this "
+			                       "header.\n*/\n"
+			    << "inline constexpr " << className << ' ' << instanceName
+			    << " = " << value << ";\n";
+		}
+	};
 } // namespace
 
 int main(int argc, char **argv)
@@ -611,6 +3957,12 @@ int main(int argc, char **argv)
 	  {"detail-namespace", required_argument, nullptr, 'd'},
 	  {"output", required_argument, nullptr, 'o'},
 	  {"embed-schema", required_argument, nullptr, 'e'},
+	  {"materialize", no_argument, nullptr, 'm'},
+	  {"layout-profile", required_argument, nullptr, 'p'},
+	  {"count-accesses", no_argument, nullptr, 'a'},
+	  {"module", required_argument, nullptr, 'M'},
+	  {"table-driven", no_argument, nullptr, 't'},
+	  {"bake", required_argument, nullptr, 'b'},
 	  {nullptr, 0, nullptr, 0},
 	};
 
@@ -618,12 +3970,21 @@ int main(int argc, char **argv)
 
 	bool embedSchema = false;
 
+	// The name of the module to generate, or null to generate a header.
+	const char *moduleName = nullptr;
+
+	// A config document to bake into the header, or null.
+	const char *bakeDocument = nullptr;
+
 	if (argc > 2)
 	{
 		int c = -1;
 		int option_index;
-		while ((c = getopt_long(
-		          argc, argv, "d:ec:o:", long_options, &option_index)) != -1)
+		while ((c = getopt_long(argc,
+		                        argv,
+		                        "d:ec:o:mp:aM:tb:",
+		                        long_options,
+		                        &option_index)) != -1)
 		{
 			switch (c)
 			{
@@ -658,6 +4019,56 @@ int main(int argc, char **argv)
 					file_out = std::make_unique<std::ofstream>(optarg);
 					break;
 				}
+				case 'm':
+				{
+					materialize = true;
+					break;
+				}
+				case 'p':
+				{
+					// Each line is a property name and an access count, as
+					// written by the generated `write_access_profile`.
+					std::ifstream profile(optarg);
+					if (!profile)
+					{
+						fprintf(stderr, "Unable to read profile %s\n", optarg);
+						return EXIT_FAILURE;
+					}
+					std::string line;
+					while (std::getline(profile, line))
+					{
+						std::istringstream fields(line);
+						std::string        property;
+						uint64_t           count;
+						if ((fields >> property >> count) &&
+						    (property[0] != '#'))
+						{
+							layoutProfile[property] += count;
+						}
+					}
+					materialize = true;
+					break;
+				}
+				case 'a':
+				{
+					countAccesses = true;
+					break;
+				}
+				case 'M':
+				{
+					moduleName = optarg;
+					break;
+				}
+				case 't':
+				{
+					tableDriven = true;
+					break;
+				}
+				case 'b':
+				{
+					bakeDocument = optarg;
+					break;
+				}
 			}
 		}
 	}
@@ -688,21 +4099,99 @@ int main(int argc, char **argv)
 	Root conf(obj);
 	ucl_object_unref(obj);
 
-	// Generic headers
-	out << "#pragma once\n\n"
-	    << "#include \"config-generic.h\"\n\n"
-	    << "#include <variant>\n\n"
-	    << "// Machine generated from " << in_filename
-	    << " by "
-	       "https://github.com/davidchisnall/config-gen DO NOT EDIT\n\n"
-	    << "#ifdef CONFIG_NAMESPACE_BEGIN\nCONFIG_NAMESPACE_BEGIN\n#endif\n";
+	if (bakeDocument)
+	{
+		// Bake from a copy of the schema, because generating the classes
+		// removes the constraints that generated code checks from the schema
+		// that libucl checks.
+		UCLPtr copy{ucl_object_copy(conf.obj)};
+		// The `UCLPtr` holds its own reference.
+		ucl_object_unref(copy);
+		Object original(copy);
+		std::stringstream unused;
+		emit_class(conf, configClass, unused, true);
+		p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+		ucl_parser_add_file(p, bakeDocument);
+		if (ucl_parser_get_error(p))
+		{
+			fprintf(
+			  stderr, "Error parsing config: %s\n", ucl_parser_get_error(p));
+			return EXIT_FAILURE;
+		}
+		UCLPtr document{ucl_parser_get_object(p)};
+		ucl_parser_free(p);
+		// The `UCLPtr` holds its own reference.
+		ucl_object_unref(document);
+		ucl_schema_error err;
+		if (!ucl_object_validate(conf.obj, document, &err))
+		{
+			fprintf(stderr, "Config is not valid: %s\n", err.msg);
+			return EXIT_FAILURE;
+		}
+		out << "#pragma once\n\n"
+		    << "#include \"config-generic.h\"\n\n"
+		    << "#include <chrono>\n#include <limits>\n#include <optional>\n"
+		    << "#include <span>\n#include <string_view>\n\n"
+		    << "// Machine generated from " << in_filename << " and "
+		    << bakeDocument
+		    << " by https://github.com/davidchisnall/config-gen DO NOT EDIT\n\n"
+		    << "#ifdef CONFIG_NAMESPACE_BEGIN\nCONFIG_NAMESPACE_BEGIN\n"
+		       "#endif\n";
+		if (auto desc = conf.description())
+		{
+			out << "/**\n* " << *desc << "\n*/";
+		}
+		Baker("baked_config").bake(original, configClass, document, out);
+		out << "#ifdef CONFIG_NAMESPACE_END\nCONFIG_NAMESPACE_END\n#endif\n\n";
+		return EXIT_SUCCESS;
+	}
+
+	// Generic headers.  A module imports the `config.generic` module, built
+	// from `config-generic.cppm`, and re-exports it along with everything
+	// that it declares.  Headers that the generated code uses directly go in
+	// the global module fragment, as does the one macro that it uses.
+	if (moduleName)
+	{
+		out << "// Machine generated from " << in_filename
+		    << " by "
+		       "https://github.com/davidchisnall/config-gen DO NOT EDIT\n\n"
+		    << "module;\n"
+		    << "#include <atomic>\n#include <chrono>\n#include <exception>\n"
+		    << "#include <memory>\n#include <optional>\n#include <stdio.h>\n"
+		    << "#include <string>\n#include <string_view>\n#include <ucl.h>\n"
+		    << "#include <utility>\n#include <variant>\n"
+		    << "#ifdef __clang__\n"
+		    << "#define CONFIG_LIFETIME_BOUND [[clang::lifetimebound]]\n"
+		    << "#else\n#define CONFIG_LIFETIME_BOUND\n#endif\n"
+		    << "export module " << moduleName << ";\n"
+		    << "export import config.generic;\n\n"
+		    << "export {\n";
+	}
+	else
+	{
+		out << "#pragma once\n\n"
+		    << "#include \"config-generic.h\"\n\n"
+		    << "#include <variant>\n\n"
+		    << (countAccesses ? "#include <atomic>\n\n" : "")
+		    << "// Machine generated from " << in_filename
+		    << " by "
+		       "https://github.com/davidchisnall/config-gen DO NOT EDIT\n\n";
+	}
+	// The macros must be defined when the module interface unit is
+	// compiled, because macros in the importers do not reach it.
+	out << "#ifdef CONFIG_NAMESPACE_BEGIN\nCONFIG_NAMESPACE_BEGIN\n#endif\n";
 
 	// Emit the config class
 	if (auto desc = conf.description())
 	{
 		out << "/**\n* " << *desc << "\n*/";
 	}
-	emit_class(conf, configClass, out);
+	// Generating the classes modifies the schema, so find the bounds first.
+	auto              bounds = schema_bounds(conf);
+	std::stringstream classes;
+	bool              hasValidator =
+	  emit_class(conf, configClass, classes, true);
+	out << classes.str();
 	// If we've been asked to embed the schema and a constructor, do so
 	if (embedSchema)
 	{
@@ -722,9 +4211,56 @@ int main(int argc, char **argv)
 		replace("\\", "\\\\");
 		replace("\"", "\\\"");
 		replace("\n", "\\n");
-		out << "inline std::variant<" << configClass
+		out << "/**\n* Return a config that wraps `obj`, which must already "
+		       "have been checked against the embedded schema.  Checks the "
+		       "constraints that are not in the embedded schema.  If "
+		       "`compact` is true, properties that are not in the schema are "
+		       "removed from `obj` once it is valid.\n*/\n"
+		    << "inline std::variant<" << configClass
 		    << ", ucl_schema_error> "
-		       "make_config(ucl_object_t *obj) {"
+		       "make_config_unchecked(ucl_object_t *obj, bool compact = "
+		       "false) {"
+		    << "ucl_schema_error err;\n";
+		// Removing properties does not invalidate the snapshot, which refers
+		// only to values that are in the schema.
+		std::string compact = "if (compact) { ";
+		compact += configClass;
+		compact += "::compact(obj); }\n";
+		if (snapshotRequired)
+		{
+			out << "auto snapshot = std::make_shared<" << configNamespace
+			    << "Snapshot>();\n"
+			    << "if (!" << configClass
+			    << "::validate(obj, &err, snapshot.get())) { return err; }"
+			    << compact << "return " << configClass
+			    << "(obj, std::move(snapshot));\n";
+		}
+		else
+		{
+			if (hasValidator)
+			{
+				out << "if (!" << configClass
+				    << "::validate(obj, &err, nullptr)) { return err; }";
+			}
+			out << compact << "return " << configClass << "(obj);\n";
+		}
+		out << "}\n\n";
+		out << "/**\n* Return a config that wraps `obj`, which has already "
+		       "been checked against the embedded schema and by every step of "
+		       "`"
+		    << configClass
+		    << "::validate_step`, which recorded derived values in "
+		       "`snapshot`.  If `compact` is true, properties that are not in "
+		       "the schema are removed from `obj`.\n*/\n"
+		    << "inline " << configClass
+		    << " make_config_validated(ucl_object_t *obj, "
+		       "[[maybe_unused]] std::shared_ptr<"
+		    << configNamespace << "Snapshot> snapshot, bool compact) {"
+		    << compact << "return " << configClass
+		    << (snapshotRequired ? "(obj, std::move(snapshot));\n}\n\n"
+		                         : "(obj);\n}\n\n");
+		out << "/**\n* Returns the embedded schema.\n*/\n"
+		    << "inline const ucl_object_t *embedded_schema() {"
 		    << "static const ucl_object_t *schema = []() {"
 		    << "static const char embeddedSchema[] = \"" << schema << "\";\n"
 		    << "struct ucl_parser *p = "
@@ -736,10 +4272,84 @@ int main(int argc, char **argv)
 		    << "ucl_parser_free(p);\n"
 		    << "return obj;\n"
 		    << "}();"
+		    << "return schema;\n}\n\n";
+		out << "/**\n* Validate `obj` and return a config that wraps it.  If "
+		       "`compact` is true, properties that are not in the schema are "
+		       "removed from `obj` once it is valid.\n*/\n"
+		    << "inline std::variant<" << configClass
+		    << ", ucl_schema_error> "
+		       "make_config(ucl_object_t *obj, bool compact = false) {"
 		    << "ucl_schema_error err;\n"
-		    << "if (!ucl_object_validate(schema, obj, &err)) { return err; }"
-		    << "return " << configClass << "(obj);\n"
-		    << "}\n\n";
+		    << "if (!ucl_object_validate(embedded_schema(), obj, &err)) { "
+		       "return err; }"
+		    << "return make_config_unchecked(obj, compact);\n}\n\n";
+		out << "/**\n* Read, parse, and validate the config file at `path` "
+		       "without blocking the caller.  Requires `config-async.h`.\n*/"
+		       "\n"
+		    << "template<typename Executor, typename... Options>\n"
+		    << "auto make_config_async(std::string path, Executor &executor, "
+		       "Options &&...options) {"
+		    << "return " << configNamespace << "async_make_config<"
+		    << configClass << ">(embedded_schema(), " << configNamespace
+		    << "ValidationSteps<" << configClass << ">{" << configClass
+		    << "::validationSteps, " << configClass
+		    << "::validate_step, make_config_validated}, std::move(path), "
+		       "executor, std::forward<Options>(options)...);\n}\n\n";
+		// The fingerprint covers the schema and everything generated from
+		// it, so a cache of validated documents is not reused if either
+		// changes.
+		std::string generated = classes.str();
+		uint64_t    fingerprint =
+		  hash_bytes(generated.data(),
+		             generated.size(),
+		             hash_bytes(schema.data(), schema.size()));
+		out << "/**\n* Parse `text` and return a config for it, using `cache` "
+		       "to skip validating documents that have been validated "
+		       "before.\n*/\n"
+		    << "inline std::variant<" << configClass
+		    << ", ucl_schema_error> "
+		       "make_config_cached(std::string_view text, "
+		    << configNamespace << "ConfigCache<" << configClass
+		    << "> &cache, bool compact = false) {"
+		    << "return " << configNamespace << "cached_make_config<"
+		    << configClass
+		    << ", make_config, make_config_unchecked>(text, 0x" << std::hex
+		    << fingerprint << std::dec << "ULL, cache, compact);\n}\n\n";
+		// Documents that are valid for a schema with no additional
+		// properties and bounded arrays cannot be larger than the schema
+		// allows, so larger ones can be rejected before validation.
+		out << "/**\n* Limits implied by the schema.  Zero where the schema "
+		       "does not bound a value.\n*/\n"
+		    << "inline constexpr " << configNamespace
+		    << "ConfigLimits schema_limits{";
+		if (bounds)
+		{
+			auto bound = [](size_t value) {
+				return value == SIZE_MAX ? 0 : value;
+			};
+			out << ".maxDepth = " << bound(bounds->depth)
+			    << ", .maxNodes = " << bound(bounds->nodes)
+			    << "ULL, .maxArrayLength = " << bound(bounds->arrayLength)
+			    << "ULL";
+		}
+		out << "};\n\n"
+		    << "/**\n* Parse `text`, which is not trusted, and return a "
+		       "config for it.  Fails without validating the document if it "
+		       "exceeds `limits` or `schema_limits`.  Macros such as "
+		       "`.include` are not expanded.\n*/\n"
+		    << "inline std::variant<" << configClass
+		    << ", ucl_schema_error> "
+		       "make_config_limited(std::string_view text, const "
+		    << configNamespace
+		    << "ConfigLimits &limits = {}, bool compact = false) {"
+		    << "return " << configNamespace << "limited_make_config<"
+		    << configClass
+		    << ", make_config>(text, limits.tightened(schema_limits), "
+		       "compact);\n}\n\n";
 	}
 	out << "#ifdef CONFIG_NAMESPACE_END\nCONFIG_NAMESPACE_END\n#endif\n\n";
+	if (moduleName)
+	{
+		out << "}\n";
+	}
 }
@@ -0,0 +1,61 @@
+// Copyright David Chisnall
+// SPDX-License-Identifier: MIT
+//
+// The `config.generic` module, which provides everything in
+// `config-generic.h` to the modules generated by `config-gen --module`, so
+// that each translation unit that imports a generated config does not parse
+// the header again.
+module;
+
+// Headers that `config-generic.h` depends on belong in the global module
+// fragment, so that they are not attached to this module.  The include
+// guards stop them from being included again in the module purview.
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <ucl.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__GLIBC__)
+#	include <malloc.h>
+#elif defined(__APPLE__)
+#	include <malloc/malloc.h>
+#elif defined(__FreeBSD__)
+#	include <malloc_np.h>
+#endif
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#	include <tmmintrin.h>
+#endif
+
+export module config.generic;
+
+#define CONFIG_EXPORT export
+#include "config-generic.h"
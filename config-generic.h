@@ -3,16 +3,49 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <assert.h>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstddef>
 #include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <type_traits>
 #include <ucl.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <variant>
+#include <vector>
 
+#include <arpa/inet.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__GLIBC__)
+#	include <malloc.h>
+#elif defined(__APPLE__)
+#	include <malloc/malloc.h>
+#elif defined(__FreeBSD__)
+#	include <malloc_np.h>
+#endif
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#	include <tmmintrin.h>
+#endif
 
 #ifndef CONFIG_DETAIL_NAMESPACE
 #	define CONFIG_DETAIL_NAMESPACE config::detail
@@ -22,8 +55,13 @@
 #else
 #	define CONFIG_LIFETIME_BOUND
 #endif
+// Defined as `export` by `config-generic.cppm`, which builds this header as
+// the `config.generic` module.
+#ifndef CONFIG_EXPORT
+#	define CONFIG_EXPORT
+#endif
 
-namespace CONFIG_DETAIL_NAMESPACE
+CONFIG_EXPORT namespace CONFIG_DETAIL_NAMESPACE
 {
 	/**
 	 * Smart pointer to a UCL object, manages the lifetime of the object.
@@ -125,11 +163,415 @@ namespace CONFIG_DETAIL_NAMESPACE
 		}
 	};
 
+	/**
+	 * Returns the number of bytes in the block at `p`, which was returned by
+	 * `malloc` for a request of `requested` bytes.  This is the usable size
+	 * reported by the C library, which includes rounding up to the
+	 * allocator's size classes, or `requested` where that is not available.
+	 * The block is not read or modified.  It is not a pointer to `const`
+	 * because compilers assume that a function taking one reads it, and
+	 * warn when it has just been allocated.
+	 */
+	inline size_t malloc_bytes(void *p, size_t requested)
+	{
+#if defined(__GLIBC__) || defined(__FreeBSD__)
+		(void)requested;
+		return malloc_usable_size(p);
+#elif defined(__APPLE__)
+		(void)requested;
+		return malloc_size(p);
+#else
+		(void)p;
+		return requested;
+#endif
+	}
+
+	/**
+	 * Allocator that allocates with `malloc` and keeps a running total of
+	 * the sizes of the blocks that it has allocated and not yet freed, so
+	 * that the memory used by a container is measured rather than computed
+	 * from the sizes of its nodes.  Copies, including rebound copies, share
+	 * the total.
+	 */
+	template<typename T>
+	class CountingAllocator
+	{
+		static_assert(alignof(T) <= alignof(std::max_align_t),
+		              "malloc does not support over-aligned types");
+
+		template<typename U>
+		friend class CountingAllocator;
+
+		/**
+		 * The running total.
+		 */
+		std::atomic<size_t> *total;
+
+		public:
+		using value_type = T;
+
+		/**
+		 * Constructor, adds the blocks that this allocates to `counter`,
+		 * which must outlive every container that uses the allocator.
+		 */
+		CountingAllocator(std::atomic<size_t> *counter) : total(counter) {}
+
+		/**
+		 * Rebinding constructor, shares the total of `other`.
+		 */
+		template<typename U>
+		CountingAllocator(const CountingAllocator<U> &other)
+		  : total(other.total)
+		{
+		}
+
+		/**
+		 * Allocate space for `n` objects.
+		 */
+		T *allocate(size_t n)
+		{
+			void *p = malloc(n * sizeof(T));
+			if (p == nullptr)
+			{
+				throw std::bad_alloc();
+			}
+			total->fetch_add(malloc_bytes(p, n * sizeof(T)),
+			                 std::memory_order_relaxed);
+			return static_cast<T *>(p);
+		}
+
+		/**
+		 * Free space for `n` objects, allocated by `allocate`.
+		 */
+		void deallocate(T *p, size_t n)
+		{
+			total->fetch_sub(malloc_bytes(p, n * sizeof(T)),
+			                 std::memory_order_relaxed);
+			free(p);
+		}
+
+		/**
+		 * Allocators are equal if they share a total.
+		 */
+		template<typename U>
+		bool operator==(const CountingAllocator<U> &other) const
+		{
+			return total == other.total;
+		}
+	};
+
+	/**
+	 * Returns an estimate of the number of bytes of heap memory owned by
+	 * `value`, for the types that are stored in snapshots.  Types can report
+	 * their own usage with a `heap_bytes` method.  Hash tables are counted as
+	 * a bucket array and one node per element, as in the libstdc++ and libc++
+	 * layouts.  Allocator overhead is not counted.
+	 */
+	template<typename T>
+	size_t heap_bytes(const T &value)
+	{
+		if constexpr (requires { value.heap_bytes(); })
+		{
+			return value.heap_bytes();
+		}
+		else if constexpr (requires { value.bucket_count(); })
+		{
+			size_t node = sizeof(void *) + sizeof(typename T::value_type) +
+			              sizeof(size_t);
+			return value.bucket_count() * sizeof(void *) +
+			       value.size() * node;
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	/**
+	 * Returns the number of bytes that libucl has allocated for the object
+	 * tree `o`.  Each object and the copies of keys and string values that
+	 * libucl owns are measured with `malloc_bytes`.  Keys and strings that
+	 * point into the parser's input are not owned by the tree and are not
+	 * counted.  The element tables of arrays and objects are internal to
+	 * libucl, so they are estimated from the number of elements.  Memory
+	 * shared with another tree is counted in both.
+	 */
+	inline size_t ucl_object_bytes(const ucl_object_t *o)
+	{
+		if (o == nullptr)
+		{
+			return 0;
+		}
+		// The indexes of the copies of the key and value in `trash_stack`,
+		// `UCL_TRASH_KEY` and `UCL_TRASH_VALUE` in libucl.
+		constexpr size_t TrashKey   = 0;
+		constexpr size_t TrashValue = 1;
+		size_t           bytes =
+		  malloc_bytes(const_cast<ucl_object_t *>(o), sizeof(ucl_object_t));
+		if (o->flags & UCL_OBJECT_ALLOCATED_KEY)
+		{
+			bytes += malloc_bytes(o->trash_stack[TrashKey], o->keylen + 1);
+		}
+		if (o->flags & UCL_OBJECT_ALLOCATED_VALUE)
+		{
+			bytes += malloc_bytes(o->trash_stack[TrashValue], o->len + 1);
+		}
+		switch (ucl_object_type(o))
+		{
+			case UCL_ARRAY:
+			case UCL_OBJECT:
+			{
+				// Arrays are a vector of pointers.  Objects are a hash table
+				// of pointers and a list of the elements in insertion order.
+				size_t perElement = ucl_object_type(o) == UCL_ARRAY
+				                      ? sizeof(void *)
+				                      : 4 * sizeof(void *);
+				ucl_object_iter_t iter = nullptr;
+				while (auto *child = ucl_object_iterate(o, &iter, false))
+				{
+					bytes += perElement + ucl_object_bytes(child);
+				}
+				break;
+			}
+			default:
+				break;
+		}
+		return bytes;
+	}
+
+	/**
+	 * Snapshot.  Holds values that are derived from a UCL object tree once,
+	 * when a config is created, so that accessors do not need to recompute
+	 * them.  Values are keyed by the UCL object that they were derived from
+	 * and must not outlive the tree.
+	 *
+	 * A snapshot is populated by the generated `validate` methods and is
+	 * immutable once it has been handed to the generated classes, so it can be
+	 * shared between threads.  The only exceptions are the hashes of subtrees
+	 * and the results of comparing them, which the generated `hash` methods
+	 * and equality operators record on first use and which are protected by a
+	 * lock.
+	 */
+	class Snapshot
+	{
+		/**
+		 * The number of bytes allocated for the containers in this snapshot
+		 * and for the values that they hold.  Declared first, so that it
+		 * outlives them.
+		 */
+		mutable std::atomic<size_t> allocated{0};
+
+		/**
+		 * Hash table whose memory is counted in `allocated`.
+		 */
+		template<typename Key, typename Value>
+		using Map = std::unordered_map<
+		  Key,
+		  Value,
+		  std::hash<Key>,
+		  std::equal_to<Key>,
+		  CountingAllocator<std::pair<const Key, Value>>>;
+
+		/**
+		 * The derived values, keyed by the object that they were derived
+		 * from.
+		 */
+		Map<const ucl_object_t *, std::shared_ptr<const void>> values{
+		  &allocated};
+
+		/**
+		 * The number of bytes of heap memory that the values report owning,
+		 * with `heap_bytes`.
+		 */
+		size_t valueHeapBytes = 0;
+
+		/**
+		 * The result of comparing a subtree of this snapshot's tree with a
+		 * subtree of another tree.
+		 */
+		struct Equality
+		{
+			/**
+			 * The snapshot of the other tree.  Held weakly, so that its
+			 * control block, which identifies it, is not reused while this
+			 * result is kept.
+			 */
+			std::weak_ptr<const Snapshot> other;
+
+			/**
+			 * Whether the two subtrees are equal.
+			 */
+			bool equal;
+		};
+
+		/**
+		 * Protects `hashes`, `equalities`, and `sweepAt`.
+		 */
+		mutable std::mutex hashLock;
+
+		/**
+		 * The hashes of the subtrees that have been hashed, keyed by their
+		 * root.  These outlive the generated classes that compute them,
+		 * which are created afresh by each accessor.
+		 */
+		mutable Map<const ucl_object_t *, uint64_t> hashes{&allocated};
+
+		/**
+		 * The key of `equalities`: a root in this tree and a root in another.
+		 */
+		using EqualityKey =
+		  std::pair<const ucl_object_t *, const ucl_object_t *>;
+
+		/**
+		 * The results of comparing subtrees, keyed by the root in this tree
+		 * and then the root in the other tree.  A tree does not change while
+		 * its snapshot is alive, so a result applies whenever the other side
+		 * has the same snapshot.
+		 */
+		mutable std::map<
+		  EqualityKey,
+		  Equality,
+		  std::less<EqualityKey>,
+		  CountingAllocator<std::pair<const EqualityKey, Equality>>>
+		  equalities{&allocated};
+
+		/**
+		 * The size of `equalities` at which results for snapshots that no
+		 * longer exist are removed.
+		 */
+		mutable size_t sweepAt = 64;
+
+		public:
+		/**
+		 * Record `value` as the value derived from `o`.  Each object has at
+		 * most one derived value.
+		 */
+		template<typename T>
+		void insert(const ucl_object_t *o, T &&value)
+		{
+			using Value = std::decay_t<T>;
+			valueHeapBytes += heap_bytes(value);
+			// The value shares a block with the pointer's control block,
+			// which is counted by the allocator.
+			values[o] = std::allocate_shared<const Value>(
+			  CountingAllocator<Value>(&allocated), std::forward<T>(value));
+		}
+
+		/**
+		 * Returns the number of bytes used by this snapshot.  The blocks
+		 * allocated for its hash tables and for the values that they hold are
+		 * measured, as reported by `malloc_bytes`.  Memory that the values
+		 * own is what they report with `heap_bytes`.
+		 */
+		size_t bytes() const
+		{
+			return sizeof(*this) + allocated.load(std::memory_order_relaxed) +
+			       valueHeapBytes;
+		}
+
+		/**
+		 * Returns the hash of the subtree rooted at `o` if it has been
+		 * computed, or zero.
+		 */
+		uint64_t peek_hash(const ucl_object_t *o) const
+		{
+			std::lock_guard guard(hashLock);
+			auto            i = hashes.find(o);
+			return (i == hashes.end()) ? 0 : i->second;
+		}
+
+		/**
+		 * Returns the hash of the subtree rooted at `o`, calling `compute`
+		 * to compute it the first time.  Zero means not computed, so is never
+		 * returned.
+		 */
+		template<typename Compute>
+		uint64_t hash(const ucl_object_t *o, Compute &&compute) const
+		{
+			{
+				std::lock_guard guard(hashLock);
+				if (auto i = hashes.find(o); i != hashes.end())
+				{
+					return i->second;
+				}
+			}
+			// Computed without the lock, because hashing a subtree hashes the
+			// subtrees that it contains.  Threads that race compute the same
+			// value.
+			uint64_t        result = std::max<uint64_t>(compute(), 1);
+			std::lock_guard guard(hashLock);
+			hashes.emplace(o, result);
+			return result;
+		}
+
+		/**
+		 * Returns whether the subtree rooted at `o` is equal to the subtree
+		 * rooted at `other` in the tree that `otherSnapshot` was built from,
+		 * calling `compare` to compare them the first time.
+		 */
+		template<typename Compare>
+		bool equal(const ucl_object_t                  *o,
+		           const std::shared_ptr<const Snapshot> &otherSnapshot,
+		           const ucl_object_t                  *other,
+		           Compare                            &&compare) const
+		{
+			auto key = std::make_pair(o, other);
+			{
+				std::lock_guard guard(hashLock);
+				if (auto i = equalities.find(key);
+				    (i != equalities.end()) &&
+				    !i->second.other.owner_before(otherSnapshot) &&
+				    !otherSnapshot.owner_before(i->second.other))
+				{
+					return i->second.equal;
+				}
+			}
+			// Compared without the lock, because comparing a subtree compares
+			// the subtrees that it contains.
+			bool            result = compare();
+			std::lock_guard guard(hashLock);
+			if (equalities.size() >= sweepAt)
+			{
+				std::erase_if(equalities, [](const auto &entry) {
+					return entry.second.other.expired();
+				});
+				sweepAt = std::max<size_t>(64, equalities.size() * 2);
+			}
+			equalities[key] = {otherSnapshot, result};
+			return result;
+		}
+
+		/**
+		 * Look up the value derived from `o`.  Returns null if there is no
+		 * such value.  The caller is responsible for asking for the type that
+		 * was inserted.
+		 */
+		template<typename T>
+		const T *find(const ucl_object_t *o) const
+		{
+			auto i = values.find(o);
+			if (i == values.end())
+			{
+				return nullptr;
+			}
+			return static_cast<const T *>(i->second.get());
+		}
+	};
+
+	/**
+	 * Shared pointer to a snapshot.  Generated classes hold one of these so
+	 * that views into a config can outlive the object that created them.
+	 */
+	using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
 	/**
 	 * Range.  Exposes a UCL collection as an iterable range of type `T`, with
 	 * `Adaptor` used to convert from the underlying UCL object to `T`.  If
 	 * `IterateProperties` is true then this iterates over the properties of an
 	 * object, rather than just over UCL arrays.
+	 *
+	 * If `Adaptor` can be constructed from an object and a snapshot, the
+	 * range's snapshot is passed to each element.
 	 */
 	template<typename T, typename Adaptor = T, bool IterateProperties = false>
 	class Range
@@ -144,6 +586,11 @@ namespace CONFIG_DETAIL_NAMESPACE
 		 */
 		enum ucl_iterate_type iterate_type;
 
+		/**
+		 * The snapshot passed to the adaptor for each element.
+		 */
+		SnapshotPtr snapshot;
+
 		/**
 		 * Iterator type for this range.
 		 */
@@ -169,6 +616,29 @@ namespace CONFIG_DETAIL_NAMESPACE
 			 */
 			enum ucl_iterate_type iterate_type;
 
+			/**
+			 * The snapshot for the elements.
+			 */
+			SnapshotPtr snapshot;
+
+			/**
+			 * Construct an element with the adaptor, passing the snapshot if
+			 * the adaptor accepts one.
+			 */
+			T adapt()
+			{
+				if constexpr (std::is_constructible_v<Adaptor,
+				                                      const ucl_object_t *,
+				                                      const SnapshotPtr &>)
+				{
+					return Adaptor(obj, snapshot);
+				}
+				else
+				{
+					return Adaptor(obj);
+				}
+			}
+
 			public:
 			/**
 			 * Default constructor.  Compares equal to the end iterator from any
@@ -187,11 +657,13 @@ namespace CONFIG_DETAIL_NAMESPACE
 			Iter(Iter &&) = delete;
 
 			/**
-			 * Constructor, passed an object to iterate over and the kind of
-			 * iteration to perform.
+			 * Constructor, passed an object to iterate over, the kind of
+			 * iteration to perform, and the snapshot for the elements.
 			 */
-			Iter(const ucl_object_t *arr, const ucl_iterate_type type)
-			  : array(arr), iterate_type(type)
+			Iter(const ucl_object_t *   arr,
+			     const ucl_iterate_type type,
+			     SnapshotPtr            s)
+			  : array(arr), iterate_type(type), snapshot(std::move(s))
 			{
 				// If this is not an array and we are not iterating over
 				// properties then treat this as a collection of one object.
@@ -211,7 +683,7 @@ namespace CONFIG_DETAIL_NAMESPACE
 			 */
 			T operator->()
 			{
-				return Adaptor(obj);
+				return adapt();
 			}
 
 			/**
@@ -220,7 +692,7 @@ namespace CONFIG_DETAIL_NAMESPACE
 			 */
 			T operator*()
 			{
-				return Adaptor(obj);
+				return adapt();
 			}
 
 			/**
@@ -275,12 +747,23 @@ namespace CONFIG_DETAIL_NAMESPACE
 		{
 		}
 
+		/**
+		 * Constructor.  Constructs a range from an object and the snapshot
+		 * that the elements belong to.
+		 */
+		Range(const ucl_object_t *   arr,
+		      SnapshotPtr            s,
+		      const ucl_iterate_type type = UCL_ITERATE_BOTH)
+		  : array(arr), iterate_type(type), snapshot(std::move(s))
+		{
+		}
+
 		/**
 		 * Returns an iterator to the start of the range.
 		 */
 		Iter begin()
 		{
-			return {array, iterate_type};
+			return {array, iterate_type, snapshot};
 		}
 
 		/**
@@ -291,6 +774,31 @@ namespace CONFIG_DETAIL_NAMESPACE
 			return {};
 		}
 
+		/**
+		 * Ranges are equal if their elements are pairwise equal.  Ranges over
+		 * the same UCL object are equal without comparing their elements.
+		 */
+		bool operator==(const Range &other) const
+		{
+			if (static_cast<const ucl_object_t *>(array) == other.array)
+			{
+				return true;
+			}
+			Range a = *this;
+			Range b = other;
+			Iter  end;
+			auto  i = a.begin();
+			auto  j = b.begin();
+			for (; (i != end) && (j != end); ++i, ++j)
+			{
+				if (!(*i == *j))
+				{
+					return false;
+				}
+			}
+			return !(i != end) && !(j != end);
+		}
+
 		/**
 		 * Returns true if this is an empty range.
 		 */
@@ -298,50 +806,84 @@ namespace CONFIG_DETAIL_NAMESPACE
 		{
 			return (array == nullptr) || (ucl_object_type(array) == UCL_NULL);
 		}
+
+		/**
+		 * Returns the element at index `i`, or `std::nullopt` if the range is
+		 * not an array or the index is out of bounds.
+		 */
+		std::optional<T> at(size_t i) const
+		{
+			if ((ucl_object_type(array) != UCL_ARRAY) || (i > UINT_MAX))
+			{
+				return std::nullopt;
+			}
+			const ucl_object_t *item =
+			  ucl_array_find_index(array, static_cast<unsigned int>(i));
+			if (item == nullptr)
+			{
+				return std::nullopt;
+			}
+			if constexpr (std::is_constructible_v<Adaptor,
+			                                      const ucl_object_t *,
+			                                      const SnapshotPtr &>)
+			{
+				return Adaptor(item, snapshot);
+			}
+			else
+			{
+				return Adaptor(item);
+			}
+		}
 	};
 
 	/**
-	 * String view adaptor exposes a UCL object as a string view.
-	 *
-	 * Adaptors are intended to be short-lived, created only as temporaries,
-	 * and must not outlive the object that they are adapting.
+	 * Range over an array whose schema requires exactly `N` items, with
+	 * `minItems` and `maxItems`.  Validation guarantees the length, so the
+	 * size is a compile-time constant and elements can be accessed by index
+	 * without checking whether they exist.
 	 */
-	class StringViewAdaptor
+	template<typename T, typename Adaptor, size_t N>
+	class FixedRange : public Range<T, Adaptor, true>
 	{
+		public:
+		using Range<T, Adaptor, true>::Range;
+
 		/**
-		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 * Returns the number of elements.
 		 */
-		const ucl_object_t *obj;
+		static constexpr size_t size()
+		{
+			return N;
+		}
 
-		public:
 		/**
-		 * Constructor, captures a non-owning reference to a UCL object.
+		 * Returns the element at index `i`, which must be less than `N`.
 		 */
-		StringViewAdaptor(const ucl_object_t *o) : obj(o) {}
+		T operator[](size_t i) const
+		{
+			return *this->at(i);
+		}
 
 		/**
-		 * Implicit cast operator.  Returns a string view representing the
-		 * object.
+		 * Returns the element at index `I`.
 		 */
-		operator std::string_view()
+		template<size_t I>
+		T get() const
 		{
-			const char *cstr = ucl_object_tostring(obj);
-			if (cstr != nullptr)
-			{
-				return cstr;
-			}
-			return std::string_view("", 0);
+			static_assert(I < N, "Index out of bounds");
+			return *this->at(I);
 		}
 	};
 
 	/**
-	 * Duration adaptor, exposes a UCL object as a duration.
+	 * Adaptor that decodes an array of exactly `N` items into a `std::array`,
+	 * using `Adaptor` for each item.  Used for materialized fields.
 	 *
 	 * Adaptors are intended to be short-lived, created only as temporaries,
 	 * and must not outlive the object that they are adapting.
 	 */
-	template<typename T>
-	class DurationAdaptor
+	template<typename T, typename Adaptor, size_t N>
+	class FixedArrayAdaptor
 	{
 		/**
 		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
@@ -350,409 +892,4131 @@ namespace CONFIG_DETAIL_NAMESPACE
 
 		public:
 		/**
-		 * Constructor, captures a non-owning reference to the underling UCL
-		 * object.
+		 * Constructor, captures a non-owning reference to a UCL object.
 		 */
-		DurationAdaptor(const ucl_object_t *o) : obj(o) {}
+		FixedArrayAdaptor(const ucl_object_t *o) : obj(o) {}
 
 		/**
-		 * Implicit cast operator, returns the underlying object as a duration
-		 * in seconds.
+		 * Implicit cast operator, decodes each item of the array.
 		 */
-		operator std::chrono::duration<T>()
+		operator std::array<T, N>()
 		{
-			return std::chrono::duration<T>(
-			  static_cast<T>(ucl_object_todouble(obj)));
+			std::array<T, N> items{};
+			for (size_t i = 0; i < N; i++)
+			{
+				if (auto *item = ucl_array_find_index(
+				      obj, static_cast<unsigned int>(i)))
+				{
+					items[i] = Adaptor(item);
+				}
+			}
+			return items;
 		}
 	};
 
 	/**
-	 * Generic adaptor for number types.  Templated with the type of the number
-	 * and the UCL function required to convert to a type that can represent
-	 * the value.
-	 *
-	 * Adaptors are intended to be short-lived, created only as temporaries,
-	 * and must not outlive the object that they are adapting.
+	 * A sequence of at most `Capacity` elements, stored inline.  Used for
+	 * materialized fields for arrays with a small `maxItems`, so that the
+	 * items are in the config object rather than in a separate allocation.
 	 */
-	template<typename NumberType,
-	         auto (*Conversion)(const ucl_object_t *) = ucl_object_toint>
-	class NumberAdaptor
+	template<typename T, size_t Capacity>
+	class SmallVector
 	{
+		static_assert((Capacity > 0) && (Capacity <= UCHAR_MAX),
+		              "Capacity must fit in the one-byte length");
+
 		/**
-		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 * The storage for the elements.  Elements at or after `length` are
+		 * value initialised.
 		 */
-		const ucl_object_t *obj;
+		std::array<T, Capacity> items{};
 
-		public:
 		/**
-		 * Constructor, captures a non-owning reference to the underling UCL
-		 * object.
+		 * The number of elements.
 		 */
-		NumberAdaptor(const ucl_object_t *o) : obj(o) {}
+		uint8_t length = 0;
 
+		public:
 		/**
-		 * Implicit conversion operator, returns the object represented as a
-		 * `NumberType`.
+		 * Append `item`.  Returns false, without appending it, if the
+		 * vector is full.
 		 */
-		operator NumberType()
+		bool push_back(T item)
 		{
-			return static_cast<NumberType>(Conversion(obj));
+			if (length == Capacity)
+			{
+				return false;
+			}
+			items[length++] = std::move(item);
+			return true;
 		}
-	};
 
-	using UInt64Adaptor = NumberAdaptor<uint64_t>;
-	using UInt32Adaptor = NumberAdaptor<uint32_t>;
-	using UInt16Adaptor = NumberAdaptor<uint16_t>;
-	using UInt8Adaptor  = NumberAdaptor<uint8_t>;
-	using Int64Adaptor  = NumberAdaptor<int64_t>;
-	using Int32Adaptor  = NumberAdaptor<int32_t>;
-	using Int16Adaptor  = NumberAdaptor<int16_t>;
-	using Int8Adaptor   = NumberAdaptor<int8_t>;
-	using BoolAdaptor   = NumberAdaptor<bool, ucl_object_toboolean>;
-	using FloatAdaptor  = NumberAdaptor<float, ucl_object_todouble>;
-	using DoubleAdaptor = NumberAdaptor<double, ucl_object_todouble>;
+		/**
+		 * Returns the number of elements.
+		 */
+		size_t size() const
+		{
+			return length;
+		}
 
-	/**
-	 * String for use in C++20 templates as a literal value.
-	 */
-	template<size_t N>
-	struct StringLiteral
-	{
 		/**
-		 * Constructor, takes a string literal and provides an object that can
-		 * be used as a template parameter.
+		 * Returns true if there are no elements.
 		 */
-		constexpr StringLiteral(const char (&str)[N])
+		bool empty() const
 		{
-			std::copy_n(str, N, value);
+			return length == 0;
 		}
 
 		/**
-		 * Implicit conversion, exposes the object as a string view.
+		 * Returns the element at index `i`, which must be less than `size()`.
 		 */
-		operator std::string_view() const
+		const T &operator[](size_t i) const
 		{
-			// Strip out the null terminator
-			return {value, N - 1};
+			return items[i];
 		}
 
 		/**
-		 * Implicit conversion, exposes the object as a C string.
+		 * Returns a pointer to the first element.
 		 */
-		operator const char *() const
+		const T *begin() const
 		{
-			return value;
+			return items.data();
 		}
 
 		/**
-		 * Storage for the string.  Template arguments are compared by
-		 * structural equality and so two instances of this class will compare
-		 * equal for the purpose of template instantiation of this array
-		 * contains the same set of characters.
+		 * Returns a pointer after the last element.
 		 */
-		char value[N];
-	};
+		const T *end() const
+		{
+			return items.data() + length;
+		}
 
-	/**
-	 * A key-value pair of a string and an `enum` value defined in a way that
-	 * allows them to be used as template argument literals.  The template
-	 * arguments should never be specified directly, they should be inferred by
-	 * calling the constructor.
-	 */
-	template<size_t Size, typename EnumType>
-	struct Enum
-	{
 		/**
-		 * Constructor, takes a string literal defining a name and the `enum`
-		 * value that this maps to as arguments.
+		 * Vectors are equal if their elements are pairwise equal.
 		 */
-		constexpr Enum(const char (&str)[Size], EnumType e) : val(e)
+		bool operator==(const SmallVector &other) const
 		{
-			std::copy_n(str, Size - 1, key_buffer);
+			return std::equal(begin(), end(), other.begin(), other.end());
 		}
+	};
 
+	/**
+	 * Adaptor that decodes an array of at most `Capacity` items into a
+	 * `SmallVector`, using `Adaptor` for each item.  Used for materialized
+	 * fields.  Validation guarantees that there are no more items than this.
+	 *
+	 * Adaptors are intended to be short-lived, created only as temporaries,
+	 * and must not outlive the object that they are adapting.
+	 */
+	template<typename T, typename Adaptor, size_t Capacity>
+	class SmallVectorAdaptor
+	{
 		/**
-		 * Internal storage for the key.  Object literals in template arguments
-		 * are compared by structural equality so two instances of this refer
-		 * to the same type if they have the same character sequence here, the
-		 * same `enum` type and the same value in `val`.
+		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
 		 */
-		char key_buffer[Size - 1] = {0};
+		const ucl_object_t *obj;
 
+		public:
 		/**
-		 * The `enum` value that this key-value pair maps to.
+		 * Constructor, captures a non-owning reference to a UCL object.
 		 */
-		EnumType val;
+		SmallVectorAdaptor(const ucl_object_t *o) : obj(o) {}
 
 		/**
-		 * Expose the key as a string view.
+		 * Implicit cast operator, decodes each item of the array.
 		 */
-		constexpr std::string_view key() const
+		operator SmallVector<T, Capacity>()
 		{
-			// Strip out the null terminator
-			return {key_buffer, Size - 1};
+			SmallVector<T, Capacity> items;
+			for (T item : Range<T, Adaptor>(obj))
+			{
+				if (!items.push_back(std::move(item)))
+				{
+					break;
+				}
+			}
+			return items;
 		}
 	};
 
 	/**
-	 * Compile-time map from strings to `enum` values.  Created by providing a
-	 * list of `Enum` object literals as template parameters.
+	 * Storage for properties that are packed into bit fields, used by
+	 * classes generated with `config-gen --materialize` for booleans and
+	 * string enumerations.  A field is at most 64 bits wide and does not
+	 * cross a 64-bit word.
 	 */
-	template<Enum... kvp>
-	class EnumValueMap
+	template<size_t Words>
+	class PackedBits
 	{
 		/**
-		 * The type of a tuple of all of the key-value pairs in this map.
+		 * The words that hold the fields, initially zero.
 		 */
-		using KVPs = std::tuple<decltype(kvp)...>;
+		std::array<uint64_t, Words> words{};
 
 		/**
-		 * The key-value pairs.
+		 * Returns a mask of the low `Width` bits.
 		 */
-		static constexpr KVPs kvps{kvp...};
+		template<size_t Width>
+		static constexpr uint64_t mask()
+		{
+			static_assert((Width > 0) && (Width <= 64), "Invalid width");
+			return Width == 64 ? ~uint64_t(0) : (uint64_t(1) << Width) - 1;
+		}
 
+		public:
 		/**
-		 * The type of a value.  All of the key-value pairs must refer to the
-		 * same `enum` type.
+		 * Returns the field of `Width` bits at bit `Offset`.
 		 */
-		using Value = std::remove_reference_t<decltype(std::get<0>(kvps).val)>;
+		template<size_t Offset, size_t Width>
+		uint64_t get() const
+		{
+			static_assert((Offset % 64) + Width <= 64,
+			              "Fields must not cross a word");
+			return (words[Offset / 64] >> (Offset % 64)) & mask<Width>();
+		}
 
 		/**
-		 * Look up a key.  This is `constexpr` and can be compile-time
-		 * evaluated.  The template parameter is the index into the key-value
-		 * pair list to look.  If the lookup fails, then this will recursively
-		 * invoke the same method on the next key-value pair.
-		 *
-		 * This is currently a linear scan, so if this is
-		 * evaluated at run time then it will be O(n).  In the intended use,
-		 * `n` is small and the values of the keys are sufficiently small that
-		 * the comparison can be 1-2 instructions.  Compilers seem to generate
-		 * very good code for this after inlining.
+		 * Sets the field of `Width` bits at bit `Offset`, which must not have
+		 * been set before, to `value`.
 		 */
-		template<size_t Element>
-		static constexpr Value lookup(std::string_view key) noexcept
+		template<size_t Offset, size_t Width>
+		void set(uint64_t value)
 		{
-			static_assert(
-			  std::is_same_v<
-			    Value,
-			    std::remove_reference_t<decltype(std::get<Element>(kvps).val)>>,
-			  "All entries must use the same enum value");
-			// Re
-			if (key == std::get<Element>(kvps).key())
-			{
-				return std::get<Element>(kvps).val;
-			}
-			if constexpr (Element + 1 < std::tuple_size_v<KVPs>)
-			{
-				return lookup<Element + 1>(key);
-			}
-			else
-			{
-				return static_cast<Value>(-1);
-			}
+			static_assert((Offset % 64) + Width <= 64,
+			              "Fields must not cross a word");
+			words[Offset / 64] |= (value & mask<Width>()) << (Offset % 64);
 		}
 
-		public:
 		/**
-		 * Looks up an `enum` value by name.  This can be called at compile
-		 * time.
+		 * Packed fields are equal if all of their bits are equal.
 		 */
-		static constexpr Value get(std::string_view key) noexcept
-		{
-			return lookup<0>(key);
-		}
+		bool operator==(const PackedBits &) const = default;
 	};
 
 	/**
-	 * Adaptor for `enum`s.  This is instantiated with the type of the `enum`
-	 * and a `EnumValueMap` that maps from strings to `enum` values.
+	 * Append-only storage for interned strings, used for the string columns
+	 * of `ConfigPool`.  Each distinct string is stored once, and the views
+	 * returned by `intern` remain valid for the lifetime of the arena.
+	 * `intern` must not be called concurrently, but the strings that it has
+	 * returned may be read by any thread.
 	 */
-	template<typename EnumType, typename Map>
-	class EnumAdaptor
+	class StringArena
 	{
 		/**
-		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 * The size of each block of storage.  Strings longer than a quarter
+		 * of a block get a block of their own.
 		 */
-		const ucl_object_t *obj;
+		static constexpr size_t BlockSize = 4096;
 
-		public:
 		/**
-		 * Constructor, captures a non-owning pointer to the underlying object.
+		 * The blocks that hold the strings.
 		 */
-		EnumAdaptor(const ucl_object_t *o) : obj(o) {}
+		std::vector<std::unique_ptr<char[]>> blocks;
 
 		/**
-		 * Implicit conversion, extracts the string value and converts it to an
-		 * `enum` using the compile-time map provided as the second template
-		 * parameter.
+		 * The first unused byte of the current block.
 		 */
-		operator EnumType()
-		{
-			return Map::get(ucl_object_tostring(obj));
-		}
-	};
+		char *next = nullptr;
 
-	/**
-	 * Class representing a compile-time mapping from a string to a type.  This
-	 * is used to generate compile-time maps from keys to types.
-	 */
-	template<StringLiteral Key, typename Adaptor>
-	struct NamedType
-	{
 		/**
-		 * Given a UCL object, construct an `Adaptor` from that object.
+		 * The number of unused bytes in the current block.
 		 */
-		static Adaptor construct(const ucl_object_t *obj)
-		{
-			return Adaptor{obj};
-		}
+		size_t remaining = 0;
 
 		/**
-		 * Return the key as a string view.
+		 * The number of bytes in the blocks.
 		 */
-		static constexpr std::string_view key()
-		{
-			return Key;
-		}
-	};
+		size_t blockBytes = 0;
 
-	/**
-	 * Named type adaptor.  This is used to represent UCL objects that have a
-	 * field whose name describes their type.  The template parameters are the
-	 * name of the key that defines the type and a list of `NamedType`s that
-	 * represent the set of valid values and the types that they represent.
-	 *
-	 * This exposes a visitor interface, where callbacks for each of the
-	 * possible types can be provided, giving a match-like API.
-	 */
-	template<StringLiteral KeyName, typename... Types>
-	class NamedTypeAdaptor
-	{
 		/**
-		 * The underlying object that this represents.
+		 * The strings, as views of the blocks.
 		 */
-		UCLPtr obj;
+		std::unordered_set<std::string_view> strings;
 
 		/**
-		 * A type describing all of the string-to-type maps as a tuple.
+		 * Allocate a block of `size` bytes.
 		 */
-		using TypesAsTuple = std::tuple<Types...>;
+		char *allocate(size_t size)
+		{
+			blocks.emplace_back(new char[size]);
+			blockBytes += size;
+			return blocks.back().get();
+		}
 
+		public:
 		/**
-		 * Implementation of the visitor.  Recursive template that inspects
-		 * each of the possible values in the names map and invokes the visitor
-		 * with the matching type.
+		 * Returns a view of a copy of `str` in the arena, which is shared
+		 * with any earlier string that was equal.
 		 */
-		template<typename T, size_t I = 0>
-		constexpr void visit_impl(std::string_view key, T &&v)
+		std::string_view intern(std::string_view str)
 		{
-			if (key == std::tuple_element_t<I, TypesAsTuple>::key())
+			if (str.empty())
 			{
-				return v(std::tuple_element_t<I, TypesAsTuple>::construct(obj));
+				return {};
 			}
-			if constexpr (I + 1 < std::tuple_size_v<TypesAsTuple>)
+			auto existing = strings.find(str);
+			if (existing != strings.end())
 			{
-				return visit_impl<T, I + 1>(key, std::forward<T &&>(v));
+				return *existing;
+			}
+			char *copy;
+			if (str.size() > BlockSize / 4)
+			{
+				copy = allocate(str.size());
+			}
+			else
+			{
+				if (str.size() > remaining)
+				{
+					next      = allocate(BlockSize);
+					remaining = BlockSize;
+				}
+				copy = next;
+				next += str.size();
+				remaining -= str.size();
 			}
+			memcpy(copy, str.data(), str.size());
+			return *strings.insert({copy, str.size()}).first;
 		}
 
 		/**
-		 * Dispatch helper.  This is instantiated with an array of lambdas, one
-		 * for each matched type.  It will expose all of their call operators
-		 * as different overloads.
-		 *
-		 * Taken from an example on cppreference.com.
+		 * Returns the number of distinct strings.
 		 */
-		template<class... Fs>
-		struct Dispatcher : Fs...
+		size_t size() const
 		{
-			using Fs::operator()...;
-		};
-
-		public:
-		/**
-		 * Constructor, captures a non-owning reference to a UCL object.
-		 */
-		NamedTypeAdaptor(const ucl_object_t *o) : obj(o) {}
+			return strings.size();
+		}
 
 		/**
-		 * Visit.  Can be called in two configurations, either with a single
-		 * visitor class, or with an array of lambdas each taking one of the
-		 * possible types as its sole argument.
-		 *
-		 * Either the explicit visitor or the lambda must cover all cases.
-		 * This can be done with an `auto` parameter overload as the fallback.
-		 *
-		 * WARNING: This cannot be called with a visitor class *and* lambdas,
-		 * because it will attempt to copy the visitor and so any state will
-		 * not be updated.
+		 * Returns an estimate of the number of bytes used by the arena,
+		 * counting the blocks and the nodes and buckets of the index.
 		 */
-		template<typename... Visitors>
-		auto visit(Visitors &&...visitors)
+		size_t bytes() const
 		{
-			/**
-			 * If this is called with a single visitor, use it directly.
-			 */
-			if constexpr (sizeof...(Visitors) == 1)
+			return sizeof(*this) + blockBytes +
+			       blocks.capacity() * sizeof(blocks[0]) +
+			       strings.bucket_count() * sizeof(void *) +
+			       strings.size() * (sizeof(void *) * 2 +
+			                         sizeof(std::string_view));
+		}
+	};
+
+	/**
+	 * Returns `value` with any strings that it contains replaced by copies in
+	 * `strings`.  Used to store materialized fields in the columns of a
+	 * `ConfigPool`, where they must not refer to the document that they were
+	 * decoded from.
+	 */
+	template<typename T>
+	T intern_field(StringArena &strings, const T &value)
+	{
+		if constexpr (std::is_same_v<T, std::string_view>)
+		{
+			return strings.intern(value);
+		}
+		else if constexpr (requires { value.has_value(); })
+		{
+			if (!value)
+			{
+				return value;
+			}
+			return T{intern_field(strings, *value)};
+		}
+		else if constexpr (requires(T result) { result.push_back(value[0]); })
+		{
+			T result;
+			for (auto &item : value)
+			{
+				result.push_back(intern_field(strings, item));
+			}
+			return result;
+		}
+		else if constexpr (requires { std::tuple_size<T>::value; })
+		{
+			T result;
+			for (size_t i = 0; i < result.size(); i++)
+			{
+				result[i] = intern_field(strings, value[i]);
+			}
+			return result;
+		}
+		else
+		{
+			return value;
+		}
+	}
+
+	/**
+	 * Returns the index of the string `o` in `values`, whose first element is
+	 * a placeholder, or zero if `o` is not a string or is not one of the
+	 * other values.  Used to pack string enumerations into bit fields.
+	 */
+	template<size_t N>
+	uint64_t enum_code(const ucl_object_t    *o,
+	                   const std::string_view (&values)[N])
+	{
+		if (ucl_object_type(o) != UCL_STRING)
+		{
+			return 0;
+		}
+		size_t           length;
+		const char      *str = ucl_object_tolstring(o, &length);
+		std::string_view value(str, length);
+		for (size_t i = 1; i < N; i++)
+		{
+			if (values[i] == value)
+			{
+				return i;
+			}
+		}
+		return 0;
+	}
+
+	/**
+	 * String view adaptor exposes a UCL object as a string view.
+	 *
+	 * Adaptors are intended to be short-lived, created only as temporaries,
+	 * and must not outlive the object that they are adapting.
+	 */
+	class StringViewAdaptor
+	{
+		/**
+		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 */
+		const ucl_object_t *obj;
+
+		public:
+		/**
+		 * Constructor, captures a non-owning reference to a UCL object.
+		 */
+		StringViewAdaptor(const ucl_object_t *o) : obj(o) {}
+
+		/**
+		 * Implicit cast operator.  Returns a string view representing the
+		 * object.
+		 */
+		operator std::string_view()
+		{
+			const char *cstr = ucl_object_tostring(obj);
+			if (cstr != nullptr)
+			{
+				return cstr;
+			}
+			return std::string_view("", 0);
+		}
+	};
+
+	/**
+	 * Duration adaptor, exposes a UCL object as a duration.
+	 *
+	 * Adaptors are intended to be short-lived, created only as temporaries,
+	 * and must not outlive the object that they are adapting.
+	 */
+	template<typename T>
+	class DurationAdaptor
+	{
+		/**
+		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 */
+		const ucl_object_t *obj;
+
+		public:
+		/**
+		 * Constructor, captures a non-owning reference to the underling UCL
+		 * object.
+		 */
+		DurationAdaptor(const ucl_object_t *o) : obj(o) {}
+
+		/**
+		 * Implicit cast operator, returns the underlying object as a duration
+		 * in seconds.
+		 */
+		operator std::chrono::duration<T>()
+		{
+			return std::chrono::duration<T>(
+			  static_cast<T>(ucl_object_todouble(obj)));
+		}
+	};
+
+	/**
+	 * Generic adaptor for number types.  Templated with the type of the number
+	 * and the UCL function required to convert to a type that can represent
+	 * the value.
+	 *
+	 * Adaptors are intended to be short-lived, created only as temporaries,
+	 * and must not outlive the object that they are adapting.
+	 */
+	template<typename NumberType,
+	         auto (*Conversion)(const ucl_object_t *) = ucl_object_toint>
+	class NumberAdaptor
+	{
+		/**
+		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 */
+		const ucl_object_t *obj;
+
+		public:
+		/**
+		 * Constructor, captures a non-owning reference to the underling UCL
+		 * object.
+		 */
+		NumberAdaptor(const ucl_object_t *o) : obj(o) {}
+
+		/**
+		 * Implicit conversion operator, returns the object represented as a
+		 * `NumberType`.
+		 */
+		operator NumberType()
+		{
+			return static_cast<NumberType>(Conversion(obj));
+		}
+	};
+
+	using UInt64Adaptor = NumberAdaptor<uint64_t>;
+	using UInt32Adaptor = NumberAdaptor<uint32_t>;
+	using UInt16Adaptor = NumberAdaptor<uint16_t>;
+	using UInt8Adaptor  = NumberAdaptor<uint8_t>;
+	using Int64Adaptor  = NumberAdaptor<int64_t>;
+	using Int32Adaptor  = NumberAdaptor<int32_t>;
+	using Int16Adaptor  = NumberAdaptor<int16_t>;
+	using Int8Adaptor   = NumberAdaptor<int8_t>;
+	using BoolAdaptor   = NumberAdaptor<bool, ucl_object_toboolean>;
+	using FloatAdaptor  = NumberAdaptor<float, ucl_object_todouble>;
+	using DoubleAdaptor = NumberAdaptor<double, ucl_object_todouble>;
+
+	/**
+	 * String for use in C++20 templates as a literal value.
+	 */
+	template<size_t N>
+	struct StringLiteral
+	{
+		/**
+		 * Constructor, takes a string literal and provides an object that can
+		 * be used as a template parameter.
+		 */
+		constexpr StringLiteral(const char (&str)[N])
+		{
+			std::copy_n(str, N, value);
+		}
+
+		/**
+		 * Implicit conversion, exposes the object as a string view.
+		 */
+		constexpr operator std::string_view() const
+		{
+			// Strip out the null terminator
+			return {value, N - 1};
+		}
+
+		/**
+		 * Implicit conversion, exposes the object as a C string.
+		 */
+		constexpr operator const char *() const
+		{
+			return value;
+		}
+
+		/**
+		 * Storage for the string.  Template arguments are compared by
+		 * structural equality and so two instances of this class will compare
+		 * equal for the purpose of template instantiation of this array
+		 * contains the same set of characters.
+		 */
+		char value[N];
+	};
+
+	/**
+	 * Always false, used by the generated `get` methods to report a property
+	 * name that does not exist in the schema.
+	 */
+	template<StringLiteral Key>
+	constexpr bool NoSuchProperty = false;
+
+	/**
+	 * Returns the position of the end of the JSON Pointer segment in `p` that
+	 * starts at `start`.  This is either the next `/` or the end of the
+	 * string.
+	 */
+	template<size_t N>
+	constexpr size_t pointer_segment_end(const StringLiteral<N> &p,
+	                                     size_t                  start)
+	{
+		while ((start < N - 1) && (p.value[start] != '/'))
+		{
+			start++;
+		}
+		return start;
+	}
+
+	/**
+	 * Returns the JSON Pointer segment between `Start` and `End` in `Pointer`
+	 * as a `StringLiteral`, with the `~0` and `~1` escapes decoded.
+	 */
+	template<StringLiteral Pointer, size_t Start, size_t End>
+	constexpr auto pointer_segment()
+	{
+		// Compute the decoded length, or `SIZE_MAX` for an invalid escape.
+		constexpr size_t Length = []() {
+			size_t length = 0;
+			for (size_t i = Start; i < End; i++, length++)
+			{
+				if (Pointer.value[i] == '~')
+				{
+					i++;
+					char escape = (i == End) ? '\0' : Pointer.value[i];
+					if ((escape != '0') && (escape != '1'))
+					{
+						return SIZE_MAX;
+					}
+				}
+			}
+			return length;
+		}();
+		static_assert(Length != SIZE_MAX,
+		              "JSON Pointer contains a ~ not followed by 0 or 1");
+		char segment[Length + 1] = {};
+		for (size_t i = Start, o = 0; i < End; i++, o++)
+		{
+			segment[o] = Pointer.value[i];
+			if (Pointer.value[i] == '~')
+			{
+				i++;
+				segment[o] = (Pointer.value[i] == '0') ? '~' : '/';
+			}
+		}
+		return StringLiteral<Length + 1>(segment);
+	}
+
+	/**
+	 * Returns the array index that a JSON Pointer segment refers to, or
+	 * `std::nullopt` if the segment is not an index.  As with RFC 6901,
+	 * indexes are decimal numbers without leading zeroes.
+	 */
+	template<size_t N>
+	constexpr std::optional<size_t> pointer_index(const StringLiteral<N> &s)
+	{
+		if ((N == 1) || ((N > 2) && (s.value[0] == '0')))
+		{
+			return std::nullopt;
+		}
+		size_t index = 0;
+		for (size_t i = 0; i < N - 1; i++)
+		{
+			if ((s.value[i] < '0') || (s.value[i] > '9'))
+			{
+				return std::nullopt;
+			}
+			index = index * 10 + (s.value[i] - '0');
+		}
+		return index;
+	}
+
+	/**
+	 * Maps `T` to `std::optional<T>`, unless `T` is already an optional.
+	 */
+	template<typename T>
+	struct AsOptional
+	{
+		/**
+		 * The optional type.
+		 */
+		using type = std::optional<T>;
+	};
+
+	/**
+	 * Specialisation for types that are already optional.
+	 */
+	template<typename T>
+	struct AsOptional<std::optional<T>>
+	{
+		/**
+		 * The optional type.
+		 */
+		using type = std::optional<T>;
+	};
+
+	/**
+	 * True if `T` is a `std::optional`.
+	 */
+	template<typename T>
+	constexpr bool IsOptional = std::is_same_v<T, typename AsOptional<T>::type>;
+
+	/**
+	 * Resolves the part of the JSON Pointer `Pointer` that starts at
+	 * `Position` relative to `value`.  Properties are found with the `get`
+	 * method of generated classes and array indexes with the `at` method of
+	 * ranges.  If any step produces an optional value then the result is
+	 * optional.
+	 */
+	template<StringLiteral Pointer, size_t Position, typename T>
+	auto resolve_pointer(T &&value)
+	{
+		using V = std::remove_cvref_t<T>;
+		if constexpr (Position == sizeof(Pointer.value) - 1)
+		{
+			return V(std::forward<T>(value));
+		}
+		else if constexpr (IsOptional<V>)
+		{
+			using Result = typename AsOptional<decltype(
+			  resolve_pointer<Pointer, Position>(*value))>::type;
+			if (!value)
+			{
+				return Result{};
+			}
+			return Result{resolve_pointer<Pointer, Position>(*value)};
+		}
+		else
+		{
+			static_assert(Pointer.value[Position] == '/',
+			              "JSON Pointers must be empty or start with /");
+			constexpr size_t End = pointer_segment_end(Pointer, Position + 1);
+			constexpr auto   Segment =
+			  pointer_segment<Pointer, Position + 1, End>();
+			if constexpr (requires { value.template get<Segment>(); })
+			{
+				return resolve_pointer<Pointer, End>(
+				  value.template get<Segment>());
+			}
+			else
+			{
+				constexpr auto Index = pointer_index(Segment);
+				static_assert(Index.has_value(),
+				              "JSON Pointer segment is not an array index");
+				static_assert(requires {
+					requires IsOptional<decltype(value.at(*Index))>;
+				},
+				              "JSON Pointer refers to a child of a value "
+				              "that is not an object or an array");
+				return resolve_pointer<Pointer, End>(value.at(*Index));
+			}
+		}
+	}
+
+	/**
+	 * Returns the value that the JSON Pointer (RFC 6901) `Pointer` refers to
+	 * in `config`, which is an instance of a generated class.  For example,
+	 * `get<"/upstreams/0/timeout">(conf)` is equivalent to
+	 * `conf.upstreams().at(0)->timeout()`.  The pointer is parsed and checked
+	 * against the generated classes at compile time.  The result is an
+	 * optional if the pointer passes through an optional property or an
+	 * array element.
+	 */
+	template<StringLiteral Pointer, typename T>
+	auto get(T &&config)
+	{
+		return resolve_pointer<Pointer, 0>(std::forward<T>(config));
+	}
+
+	/**
+	 * A key-value pair of a string and an `enum` value defined in a way that
+	 * allows them to be used as template argument literals.  The template
+	 * arguments should never be specified directly, they should be inferred by
+	 * calling the constructor.
+	 */
+	template<size_t Size, typename EnumType>
+	struct Enum
+	{
+		/**
+		 * Constructor, takes a string literal defining a name and the `enum`
+		 * value that this maps to as arguments.
+		 */
+		constexpr Enum(const char (&str)[Size], EnumType e) : val(e)
+		{
+			std::copy_n(str, Size - 1, key_buffer);
+		}
+
+		/**
+		 * Internal storage for the key.  Object literals in template arguments
+		 * are compared by structural equality so two instances of this refer
+		 * to the same type if they have the same character sequence here, the
+		 * same `enum` type and the same value in `val`.
+		 */
+		char key_buffer[Size - 1] = {0};
+
+		/**
+		 * The `enum` value that this key-value pair maps to.
+		 */
+		EnumType val;
+
+		/**
+		 * Expose the key as a string view.
+		 */
+		constexpr std::string_view key() const
+		{
+			// Strip out the null terminator
+			return {key_buffer, Size - 1};
+		}
+	};
+
+	/**
+	 * Compile-time map from strings to `enum` values.  Created by providing a
+	 * list of `Enum` object literals as template parameters.
+	 */
+	template<Enum... kvp>
+	class EnumValueMap
+	{
+		/**
+		 * The type of a tuple of all of the key-value pairs in this map.
+		 */
+		using KVPs = std::tuple<decltype(kvp)...>;
+
+		/**
+		 * The key-value pairs.
+		 */
+		static constexpr KVPs kvps{kvp...};
+
+		/**
+		 * The type of a value.  All of the key-value pairs must refer to the
+		 * same `enum` type.
+		 */
+		using Value = std::remove_reference_t<decltype(std::get<0>(kvps).val)>;
+
+		/**
+		 * Look up a key.  This is `constexpr` and can be compile-time
+		 * evaluated.  The template parameter is the index into the key-value
+		 * pair list to look.  If the lookup fails, then this will recursively
+		 * invoke the same method on the next key-value pair.
+		 *
+		 * This is currently a linear scan, so if this is
+		 * evaluated at run time then it will be O(n).  In the intended use,
+		 * `n` is small and the values of the keys are sufficiently small that
+		 * the comparison can be 1-2 instructions.  Compilers seem to generate
+		 * very good code for this after inlining.
+		 */
+		template<size_t Element>
+		static constexpr Value lookup(std::string_view key) noexcept
+		{
+			static_assert(
+			  std::is_same_v<
+			    Value,
+			    std::remove_reference_t<decltype(std::get<Element>(kvps).val)>>,
+			  "All entries must use the same enum value");
+			// Re
+			if (key == std::get<Element>(kvps).key())
+			{
+				return std::get<Element>(kvps).val;
+			}
+			if constexpr (Element + 1 < std::tuple_size_v<KVPs>)
+			{
+				return lookup<Element + 1>(key);
+			}
+			else
+			{
+				return static_cast<Value>(-1);
+			}
+		}
+
+		public:
+		/**
+		 * Looks up an `enum` value by name.  This can be called at compile
+		 * time.
+		 */
+		static constexpr Value get(std::string_view key) noexcept
+		{
+			return lookup<0>(key);
+		}
+	};
+
+	/**
+	 * Adaptor for `enum`s.  This is instantiated with the type of the `enum`
+	 * and a `EnumValueMap` that maps from strings to `enum` values.
+	 */
+	template<typename EnumType, typename Map>
+	class EnumAdaptor
+	{
+		/**
+		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 */
+		const ucl_object_t *obj;
+
+		public:
+		/**
+		 * Constructor, captures a non-owning pointer to the underlying object.
+		 */
+		EnumAdaptor(const ucl_object_t *o) : obj(o) {}
+
+		/**
+		 * Implicit conversion, extracts the string value and converts it to an
+		 * `enum` using the compile-time map provided as the second template
+		 * parameter.
+		 */
+		operator EnumType()
+		{
+			return Map::get(ucl_object_tostring(obj));
+		}
+	};
+
+	/**
+	 * Class representing a compile-time mapping from a string to a type.  This
+	 * is used to generate compile-time maps from keys to types.
+	 */
+	template<StringLiteral Key, typename Adaptor>
+	struct NamedType
+	{
+		/**
+		 * Given a UCL object, construct an `Adaptor` from that object.
+		 */
+		static Adaptor construct(const ucl_object_t *obj)
+		{
+			return Adaptor{obj};
+		}
+
+		/**
+		 * Return the key as a string view.
+		 */
+		static constexpr std::string_view key()
+		{
+			return Key;
+		}
+	};
+
+	/**
+	 * Named type adaptor.  This is used to represent UCL objects that have a
+	 * field whose name describes their type.  The template parameters are the
+	 * name of the key that defines the type and a list of `NamedType`s that
+	 * represent the set of valid values and the types that they represent.
+	 *
+	 * This exposes a visitor interface, where callbacks for each of the
+	 * possible types can be provided, giving a match-like API.
+	 */
+	template<StringLiteral KeyName, typename... Types>
+	class NamedTypeAdaptor
+	{
+		/**
+		 * The underlying object that this represents.
+		 */
+		UCLPtr obj;
+
+		/**
+		 * A type describing all of the string-to-type maps as a tuple.
+		 */
+		using TypesAsTuple = std::tuple<Types...>;
+
+		/**
+		 * Implementation of the visitor.  Recursive template that inspects
+		 * each of the possible values in the names map and invokes the visitor
+		 * with the matching type.
+		 */
+		template<typename T, size_t I = 0>
+		constexpr void visit_impl(std::string_view key, T &&v)
+		{
+			if (key == std::tuple_element_t<I, TypesAsTuple>::key())
+			{
+				return v(std::tuple_element_t<I, TypesAsTuple>::construct(obj));
+			}
+			if constexpr (I + 1 < std::tuple_size_v<TypesAsTuple>)
+			{
+				return visit_impl<T, I + 1>(key, std::forward<T &&>(v));
+			}
+		}
+
+		/**
+		 * Dispatch helper.  This is instantiated with an array of lambdas, one
+		 * for each matched type.  It will expose all of their call operators
+		 * as different overloads.
+		 *
+		 * Taken from an example on cppreference.com.
+		 */
+		template<class... Fs>
+		struct Dispatcher : Fs...
+		{
+			using Fs::operator()...;
+		};
+
+		public:
+		/**
+		 * Constructor, captures a non-owning reference to a UCL object.
+		 */
+		NamedTypeAdaptor(const ucl_object_t *o) : obj(o) {}
+
+		/**
+		 * Visit.  Can be called in two configurations, either with a single
+		 * visitor class, or with an array of lambdas each taking one of the
+		 * possible types as its sole argument.
+		 *
+		 * Either the explicit visitor or the lambda must cover all cases.
+		 * This can be done with an `auto` parameter overload as the fallback.
+		 *
+		 * WARNING: This cannot be called with a visitor class *and* lambdas,
+		 * because it will attempt to copy the visitor and so any state will
+		 * not be updated.
+		 */
+		template<typename... Visitors>
+		auto visit(Visitors &&...visitors)
+		{
+			/**
+			 * If this is called with a single visitor, use it directly.
+			 */
+			if constexpr (sizeof...(Visitors) == 1)
+			{
+				return visit_impl(StringViewAdaptor(obj[KeyName]), visitors...);
+			}
+			else
+			{
+				return visit_impl(StringViewAdaptor(obj[KeyName]),
+				                  Dispatcher{visitors...});
+			}
+		}
+
+		/**
+		 * Visit.  This should be called with a list of lambdas as the
+		 * argument.  Each lambda should take one of the types.  Unlike the
+		 * `visit` method, this does not need to cover all cases.  Any cases
+		 * that are not handled will be silently ignored.
+		 */
+		template<typename... Visitors>
+		auto visit_some(Visitors &&...visitors)
+		{
+			return visit_impl(StringViewAdaptor(obj[KeyName]),
+			                  Dispatcher{visitors..., [](auto &&) {}});
+		}
+	};
+
+	/**
+	 * Property adaptor.  Wraps some other adaptor for the value and also
+	 * provides an accessor for the key.
+	 */
+	template<typename Adaptor>
+	class PropertyAdaptor : public Adaptor
+	{
+		public:
+		/**
+		 * Constructor, captures a non-owning reference to a UCL object.
+		 */
+		PropertyAdaptor(const ucl_object_t *o) : Adaptor(o) {}
+
+		/**
+		 * Provide the key as a string view.
+		 */
+		std::string_view key()
+		{
+			return ucl_object_key(Adaptor::obj);
+		}
+	};
+
+	/**
+	 * Helper to construct a value with an adaptor if it exists.  If `o` is not
+	 * null, uses `Adaptor` to construct an instance of `T`.  Returns an
+	 * `optional<T>`, where the value is present if `o` is not null.  Any
+	 * additional arguments are passed to the adaptor's constructor.
+	 */
+	template<typename Adaptor, typename T = Adaptor, typename... Args>
+	std::optional<T> make_optional(const ucl_object_t *o, Args &&...args)
+	{
+		if (o == nullptr)
+		{
+			return {};
+		}
+		return Adaptor(o, std::forward<Args>(args)...);
+	}
+
+	/**
+	 * The representation of a property in the field table that classes
+	 * generated with `config-gen --table-driven` use.  Scalar properties are
+	 * decoded by `decode_field`, all others are looked up by `lookup_field`
+	 * and decoded by their adaptor.
+	 */
+	enum class FieldKind : uint8_t
+	{
+		Object,
+		Bool,
+		Int8,
+		UInt8,
+		Int16,
+		UInt16,
+		Int32,
+		UInt32,
+		Int64,
+		UInt64,
+		Double,
+		String,
+	};
+
+	/**
+	 * The field kind that is decoded as `T`.
+	 */
+	template<typename T>
+	constexpr FieldKind field_kind = FieldKind::Object;
+	template<>
+	constexpr FieldKind field_kind<bool> = FieldKind::Bool;
+	template<>
+	constexpr FieldKind field_kind<int8_t> = FieldKind::Int8;
+	template<>
+	constexpr FieldKind field_kind<uint8_t> = FieldKind::UInt8;
+	template<>
+	constexpr FieldKind field_kind<int16_t> = FieldKind::Int16;
+	template<>
+	constexpr FieldKind field_kind<uint16_t> = FieldKind::UInt16;
+	template<>
+	constexpr FieldKind field_kind<int32_t> = FieldKind::Int32;
+	template<>
+	constexpr FieldKind field_kind<uint32_t> = FieldKind::UInt32;
+	template<>
+	constexpr FieldKind field_kind<int64_t> = FieldKind::Int64;
+	template<>
+	constexpr FieldKind field_kind<uint64_t> = FieldKind::UInt64;
+	template<>
+	constexpr FieldKind field_kind<double> = FieldKind::Double;
+	template<>
+	constexpr FieldKind field_kind<std::string_view> = FieldKind::String;
+
+	/**
+	 * An entry in a generated field table.
+	 */
+	struct FieldDescriptor
+	{
+		/**
+		 * The name of the property.
+		 */
+		const char *name;
+
+		/**
+		 * The length of `name`, so that lookups do not need to compute it.
+		 */
+		uint32_t length;
+
+		/**
+		 * How the property is decoded.
+		 */
+		FieldKind kind;
+	};
+
+	/**
+	 * Look up the property described by `field` in `obj`.  Returns null if
+	 * the property is not present.
+	 *
+	 * This is deliberately not inlined, so that each generated accessor is a
+	 * call with a constant argument rather than a copy of the lookup.
+	 */
+	[[gnu::noinline]] inline const ucl_object_t *
+	lookup_field(const ucl_object_t *obj, const FieldDescriptor &field)
+	{
+		return ucl_object_lookup_len(obj, field.name, field.length);
+	}
+
+	/**
+	 * Decode the scalar property described by `field` from `obj` into `out`,
+	 * which must point to the type whose `field_kind` is `field.kind`.
+	 * Values are converted in the same way as by the adaptors.  Returns
+	 * false and leaves `out` unmodified if the property is not present.
+	 *
+	 * This is the only code that decodes scalar properties in table-driven
+	 * classes, so it is not inlined.
+	 */
+	[[gnu::noinline]] inline bool decode_field(const ucl_object_t    *obj,
+	                                           const FieldDescriptor &field,
+	                                           void                  *out)
+	{
+		const ucl_object_t *o =
+		  ucl_object_lookup_len(obj, field.name, field.length);
+		if (o == nullptr)
+		{
+			return false;
+		}
+		auto store = [&](auto value) {
+			memcpy(out, &value, sizeof(value));
+			return true;
+		};
+		switch (field.kind)
+		{
+			case FieldKind::Object:
+				break;
+			case FieldKind::Bool:
+				return store(static_cast<bool>(ucl_object_toboolean(o)));
+			case FieldKind::Int8:
+				return store(static_cast<int8_t>(ucl_object_toint(o)));
+			case FieldKind::UInt8:
+				return store(static_cast<uint8_t>(ucl_object_toint(o)));
+			case FieldKind::Int16:
+				return store(static_cast<int16_t>(ucl_object_toint(o)));
+			case FieldKind::UInt16:
+				return store(static_cast<uint16_t>(ucl_object_toint(o)));
+			case FieldKind::Int32:
+				return store(static_cast<int32_t>(ucl_object_toint(o)));
+			case FieldKind::UInt32:
+				return store(static_cast<uint32_t>(ucl_object_toint(o)));
+			case FieldKind::Int64:
+				return store(static_cast<int64_t>(ucl_object_toint(o)));
+			case FieldKind::UInt64:
+				return store(static_cast<uint64_t>(ucl_object_toint(o)));
+			case FieldKind::Double:
+				return store(ucl_object_todouble(o));
+			case FieldKind::String:
+				return store(std::string_view(StringViewAdaptor(o)));
+		}
+		return false;
+	}
+
+	/**
+	 * Returns the required scalar property described by `field`.
+	 */
+	template<typename T>
+	T table_field(const ucl_object_t *obj, const FieldDescriptor &field)
+	{
+		T value{};
+		decode_field(obj, field, &value);
+		return value;
+	}
+
+	/**
+	 * Returns the optional scalar property described by `field`.
+	 */
+	template<typename T>
+	std::optional<T> table_optional_field(const ucl_object_t    *obj,
+	                                      const FieldDescriptor &field)
+	{
+		T value;
+		if (!decode_field(obj, field, &value))
+		{
+			return std::nullopt;
+		}
+		return value;
+	}
+
+	/**
+	 * Report a validation failure from a generated validator.  Fills in `err`
+	 * (if it is not null) with a constraint error for `obj` and a message
+	 * formatted from `fmt` and `args`.  Always returns false, so validators
+	 * can `return schema_error(...)`.
+	 */
+	template<typename... Args>
+	bool schema_error(ucl_schema_error *  err,
+	                  const ucl_object_t *obj,
+	                  const char *        fmt,
+	                  Args... args)
+	{
+		if (err != nullptr)
+		{
+			err->code = UCL_SCHEMA_CONSTRAINT;
+			err->obj  = obj;
+			snprintf(err->msg, sizeof(err->msg), fmt, args...);
+		}
+		return false;
+	}
+
+	/**
+	 * Validator for arrays.  Applies `Validator` to every element of the
+	 * array `o`.  Generated validators run after libucl's validator, so the
+	 * shape of the array has already been checked.
+	 */
+	template<auto Validator>
+	bool validate_items(const ucl_object_t *o,
+	                    ucl_schema_error *  err,
+	                    Snapshot *          snapshot)
+	{
+		for (auto item : Range<UCLPtr>(o))
+		{
+			if (!Validator(item, err, snapshot))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Validator that applies each of `Validators` in turn, for schemas that
+	 * have more than one constraint that is checked by generated code.
+	 */
+	template<auto... Validators>
+	bool validate_all(const ucl_object_t *o,
+	                  ucl_schema_error *  err,
+	                  Snapshot *          snapshot)
+	{
+		return (Validators(o, err, snapshot) && ...);
+	}
+
+	/**
+	 * Deterministic finite automaton, generated by `config-gen` from the
+	 * `pattern` of a string schema.  Input bytes are first mapped to one of
+	 * `Classes` equivalence classes and then used to index the transition
+	 * table.  State 0 is the dead state, from which no accepting state can be
+	 * reached, and state 1 is the start state.
+	 *
+	 * Matching is a single pass over the input with one table lookup per byte
+	 * and never allocates.
+	 */
+	template<size_t States, size_t Classes, typename StateType = uint16_t>
+	struct DFA
+	{
+		/**
+		 * Map from input bytes to their equivalence class.
+		 */
+		uint8_t byteClasses[256];
+
+		/**
+		 * Transition table, indexed by the current state and the class of the
+		 * next input byte.
+		 */
+		StateType transitions[States][Classes];
+
+		/**
+		 * Is each state an accepting state?
+		 */
+		bool accepting[States];
+
+		/**
+		 * Returns true if `str` matches the pattern that this automaton was
+		 * generated from.
+		 */
+		constexpr bool match(std::string_view str) const
+		{
+			StateType state = 1;
+			for (unsigned char c : str)
+			{
+				state = transitions[state][byteClasses[c]];
+				if (state == 0)
+				{
+					return false;
+				}
+			}
+			return accepting[state];
+		}
+	};
+
+	/**
+	 * Validator for strings that must match a pattern.  `Pattern` is a `DFA`
+	 * generated from the pattern in the schema.
+	 */
+	template<const auto &Pattern>
+	bool validate_pattern(const ucl_object_t *o,
+	                      ucl_schema_error *  err,
+	                      Snapshot *)
+	{
+		size_t      len;
+		const char *str = ucl_object_tolstring(o, &len);
+		if ((str == nullptr) || !Pattern.match({str, len}))
+		{
+			return schema_error(err, o, "string does not match pattern");
+		}
+		return true;
+	}
+
+	/**
+	 * Returns true if the 16 bytes at `p` are all ASCII.  This is the
+	 * vectorised part of `utf8_length`, with a portable fallback that checks
+	 * two 64-bit words at a time.
+	 */
+	inline bool is_ascii_block(const unsigned char *p)
+	{
+#if defined(__SSE2__)
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		return _mm_movemask_epi8(block) == 0;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+		return vmaxvq_u8(vld1q_u8(p)) < 0x80;
+#else
+		uint64_t words[2];
+		memcpy(words, p, sizeof(words));
+		return ((words[0] | words[1]) & 0x8080808080808080ULL) == 0;
+#endif
+	}
+
+	/**
+	 * Returns the length in bytes of the UTF-8 sequence at the start of the
+	 * `n` bytes at `p`, or zero if it is not valid.  Overlong encodings,
+	 * surrogates, and code points above U+10FFFF are not valid.
+	 */
+	inline size_t utf8_sequence_length(const unsigned char *p, size_t n)
+	{
+		auto in = [](unsigned char c, unsigned char low, unsigned char high) {
+			return (c >= low) && (c <= high);
+		};
+		unsigned char c = p[0];
+		if (c < 0x80)
+		{
+			return 1;
+		}
+		if (c < 0xc2)
+		{
+			// A continuation byte, or an overlong two-byte sequence.
+			return 0;
+		}
+		if (c < 0xe0)
+		{
+			return ((n >= 2) && in(p[1], 0x80, 0xbf)) ? 2 : 0;
+		}
+		if (c < 0xf0)
+		{
+			unsigned char low  = (c == 0xe0) ? 0xa0 : 0x80;
+			unsigned char high = (c == 0xed) ? 0x9f : 0xbf;
+			return ((n >= 3) && in(p[1], low, high) && in(p[2], 0x80, 0xbf))
+			         ? 3
+			         : 0;
+		}
+		if (c < 0xf5)
+		{
+			unsigned char low  = (c == 0xf0) ? 0x90 : 0x80;
+			unsigned char high = (c == 0xf4) ? 0x8f : 0xbf;
+			return ((n >= 4) && in(p[1], low, high) &&
+			        in(p[2], 0x80, 0xbf) && in(p[3], 0x80, 0xbf))
+			         ? 4
+			         : 0;
+		}
+		return 0;
+	}
+
+	/**
+	 * Returns the number of code points in `str`, or `std::nullopt` if it is
+	 * not valid UTF-8, one sequence at a time.  Runs of ASCII are skipped 16
+	 * bytes at a time.  This is the fallback for short strings and for targets
+	 * without a vectorised validator.
+	 */
+	inline std::optional<size_t> utf8_length_scalar(std::string_view str)
+	{
+		auto  *p      = reinterpret_cast<const unsigned char *>(str.data());
+		size_t n      = str.size();
+		size_t length = 0;
+		size_t i      = 0;
+		while (i < n)
+		{
+			if ((n - i >= 16) && is_ascii_block(p + i))
+			{
+				i += 16;
+				length += 16;
+				continue;
+			}
+			size_t sequence = utf8_sequence_length(p + i, n - i);
+			if (sequence == 0)
+			{
+				return std::nullopt;
+			}
+			i += sequence;
+			length++;
+		}
+		return length;
+	}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+	// The SSSE3 kernel is built for every x86-64 target and selected at run
+	// time, because the x86-64 baseline only guarantees SSE2.
+#	define CONFIG_UTF8_VECTOR UTF8VectorSSSE3
+#	define CONFIG_UTF8_TARGET __attribute__((target("ssse3")))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	define CONFIG_UTF8_VECTOR UTF8VectorNEON
+#	define CONFIG_UTF8_TARGET
+#endif
+
+#ifdef CONFIG_UTF8_VECTOR
+	/**
+	 * Lookup tables for the vectorised UTF-8 validator.  This is the algorithm
+	 * from Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction
+	 * Per Byte": each byte is classified by the high and low nibbles of the
+	 * byte before it and by its own high nibble, and every error sets the same
+	 * bit in all three lookups.
+	 */
+	struct UTF8Tables
+	{
+		/// A lead byte followed by a non-continuation byte.
+		static constexpr uint8_t TooShort = 1 << 0;
+		/// An ASCII byte followed by a continuation byte.
+		static constexpr uint8_t TooLong = 1 << 1;
+		/// An overlong three-byte sequence (`E0 80`-`E0 9F`).
+		static constexpr uint8_t Overlong3 = 1 << 2;
+		/// A code point above U+10FFFF (`F4 90`-`F4 BF`, or `F5`-`FF`).
+		static constexpr uint8_t TooLarge = 1 << 3;
+		/// A surrogate (`ED A0`-`ED BF`).
+		static constexpr uint8_t Surrogate = 1 << 4;
+		/// An overlong two-byte sequence (`C0` or `C1`).
+		static constexpr uint8_t Overlong2 = 1 << 5;
+		/// A lead byte `F5`-`FF` followed by `80`-`8F`.
+		static constexpr uint8_t TooLarge1000 = 1 << 6;
+		/// An overlong four-byte sequence (`F0 80`-`F0 8F`).
+		static constexpr uint8_t Overlong4 = 1 << 6;
+		/// Two continuation bytes, which is only valid in a longer sequence.
+		static constexpr uint8_t TwoContinuations = 1 << 7;
+		/// The errors that only depend on the high nibble of the first byte.
+		static constexpr uint8_t Carry = TooShort | TooLong | TwoContinuations;
+
+		/// Indexed by the high nibble of the previous byte.
+		alignas(16) static constexpr uint8_t PreviousHigh[16] = {
+		  TooLong,
+		  TooLong,
+		  TooLong,
+		  TooLong,
+		  TooLong,
+		  TooLong,
+		  TooLong,
+		  TooLong,
+		  TwoContinuations,
+		  TwoContinuations,
+		  TwoContinuations,
+		  TwoContinuations,
+		  TooShort | Overlong2,
+		  TooShort,
+		  TooShort | Overlong3 | Surrogate,
+		  TooShort | TooLarge | TooLarge1000 | Overlong4};
+
+		/// Indexed by the low nibble of the previous byte.
+		alignas(16) static constexpr uint8_t PreviousLow[16] = {
+		  Carry | Overlong3 | Overlong2 | Overlong4,
+		  Carry | Overlong2,
+		  Carry,
+		  Carry,
+		  Carry | TooLarge,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000 | Surrogate,
+		  Carry | TooLarge | TooLarge1000,
+		  Carry | TooLarge | TooLarge1000};
+
+		/// Indexed by the high nibble of the current byte.
+		alignas(16) static constexpr uint8_t CurrentHigh[16] = {
+		  TooShort,
+		  TooShort,
+		  TooShort,
+		  TooShort,
+		  TooShort,
+		  TooShort,
+		  TooShort,
+		  TooShort,
+		  TooLong | Overlong2 | TwoContinuations | Overlong3 | TooLarge1000 |
+		    Overlong4,
+		  TooLong | Overlong2 | TwoContinuations | Overlong3 | TooLarge,
+		  TooLong | Overlong2 | TwoContinuations | Surrogate | TooLarge,
+		  TooLong | Overlong2 | TwoContinuations | Surrogate | TooLarge,
+		  TooShort,
+		  TooShort,
+		  TooShort,
+		  TooShort};
+
+		/**
+		 * The largest byte in each position of the last block that does not
+		 * start a sequence that runs past the end of the block.
+		 */
+		alignas(16) static constexpr uint8_t MaxComplete[16] = {
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xff,
+		  0xf0 - 1,
+		  0xe0 - 1,
+		  0xc0 - 1};
+	};
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+	/**
+	 * SSSE3 operations for `UTF8Counter`.
+	 */
+	struct UTF8VectorSSSE3
+	{
+		using Vector = __m128i;
+
+		CONFIG_UTF8_TARGET static Vector load(const uint8_t *p)
+		{
+			return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		}
+
+		CONFIG_UTF8_TARGET static Vector zero()
+		{
+			return _mm_setzero_si128();
+		}
+
+		CONFIG_UTF8_TARGET static Vector splat(uint8_t value)
+		{
+			return _mm_set1_epi8(static_cast<char>(value));
+		}
+
+		CONFIG_UTF8_TARGET static Vector lookup(const uint8_t *table,
+		                                         Vector         index)
+		{
+			return _mm_shuffle_epi8(load(table), index);
+		}
+
+		CONFIG_UTF8_TARGET static Vector high_nibbles(Vector v)
+		{
+			return _mm_and_si128(_mm_srli_epi16(v, 4), splat(0x0f));
+		}
+
+		CONFIG_UTF8_TARGET static Vector low_nibbles(Vector v)
+		{
+			return _mm_and_si128(v, splat(0x0f));
+		}
+
+		/// The bytes `N` positions before each byte of `v`.
+		template<int N>
+		CONFIG_UTF8_TARGET static Vector previous(Vector v, Vector before)
+		{
+			return _mm_alignr_epi8(v, before, 16 - N);
+		}
+
+		CONFIG_UTF8_TARGET static Vector subtract_saturated(Vector a,
+		                                                     Vector b)
+		{
+			return _mm_subs_epu8(a, b);
+		}
+
+		CONFIG_UTF8_TARGET static Vector bit_and(Vector a, Vector b)
+		{
+			return _mm_and_si128(a, b);
+		}
+
+		CONFIG_UTF8_TARGET static Vector bit_or(Vector a, Vector b)
+		{
+			return _mm_or_si128(a, b);
+		}
+
+		CONFIG_UTF8_TARGET static Vector bit_xor(Vector a, Vector b)
+		{
+			return _mm_xor_si128(a, b);
+		}
+
+		CONFIG_UTF8_TARGET static bool any(Vector v)
+		{
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero())) != 0xffff;
+		}
+
+		CONFIG_UTF8_TARGET static bool is_ascii(Vector v)
+		{
+			return _mm_movemask_epi8(v) == 0;
+		}
+
+		/// The number of bytes in `v` that are not continuation bytes.
+		CONFIG_UTF8_TARGET static size_t count_leading(Vector v)
+		{
+			// Continuation bytes are -128 to -65 as signed bytes.
+			Vector leading = _mm_cmpgt_epi8(v, _mm_set1_epi8(-65));
+			return std::popcount(
+			  static_cast<unsigned>(_mm_movemask_epi8(leading)));
+		}
+	};
+
+	/**
+	 * Returns true if the SSSE3 kernel can run on this CPU.
+	 */
+	inline bool has_utf8_vector()
+	{
+#	ifdef __SSSE3__
+		return true;
+#	else
+		static const bool supported = __builtin_cpu_supports("ssse3");
+		return supported;
+#	endif
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	/**
+	 * NEON operations for `UTF8Counter`.
+	 */
+	struct UTF8VectorNEON
+	{
+		using Vector = uint8x16_t;
+
+		static Vector load(const uint8_t *p)
+		{
+			return vld1q_u8(p);
+		}
+
+		static Vector zero()
+		{
+			return vdupq_n_u8(0);
+		}
+
+		static Vector splat(uint8_t value)
+		{
+			return vdupq_n_u8(value);
+		}
+
+		static Vector lookup(const uint8_t *table, Vector index)
+		{
+			return vqtbl1q_u8(load(table), index);
+		}
+
+		static Vector high_nibbles(Vector v)
+		{
+			return vshrq_n_u8(v, 4);
+		}
+
+		static Vector low_nibbles(Vector v)
+		{
+			return vandq_u8(v, splat(0x0f));
+		}
+
+		/// The bytes `N` positions before each byte of `v`.
+		template<int N>
+		static Vector previous(Vector v, Vector before)
+		{
+			return vextq_u8(before, v, 16 - N);
+		}
+
+		static Vector subtract_saturated(Vector a, Vector b)
+		{
+			return vqsubq_u8(a, b);
+		}
+
+		static Vector bit_and(Vector a, Vector b)
+		{
+			return vandq_u8(a, b);
+		}
+
+		static Vector bit_or(Vector a, Vector b)
+		{
+			return vorrq_u8(a, b);
+		}
+
+		static Vector bit_xor(Vector a, Vector b)
+		{
+			return veorq_u8(a, b);
+		}
+
+		static bool any(Vector v)
+		{
+			return vmaxvq_u8(v) != 0;
+		}
+
+		static bool is_ascii(Vector v)
+		{
+			return vmaxvq_u8(v) < 0x80;
+		}
+
+		/// The number of bytes in `v` that are not continuation bytes.
+		static size_t count_leading(Vector v)
+		{
+			// Continuation bytes are -128 to -65 as signed bytes.
+			uint8x16_t leading =
+			  vcgtq_s8(vreinterpretq_s8_u8(v), vdupq_n_s8(-65));
+			return vaddvq_u8(vshrq_n_u8(leading, 7));
+		}
+	};
+
+	/**
+	 * Returns true if the NEON kernel can run on this CPU, which is always
+	 * the case on AArch64.
+	 */
+	inline bool has_utf8_vector()
+	{
+		return true;
+	}
+#endif
+
+#ifdef CONFIG_UTF8_VECTOR
+	/**
+	 * Validates UTF-8 and counts code points 16 bytes at a time.  Blocks are
+	 * added in order, and errors accumulate in a vector that is only tested
+	 * once, at the end.  The code point count is the number of bytes that are
+	 * not continuation bytes, which is only meaningful if the input is valid.
+	 */
+	template<typename V>
+	class UTF8Counter
+	{
+		using Vector = typename V::Vector;
+		using Tables = UTF8Tables;
+
+		/**
+		 * The previous block, for the bytes before the start of this one.
+		 */
+		Vector before;
+
+		/**
+		 * Non-zero if any block has had an error.
+		 */
+		Vector error;
+
+		/**
+		 * Non-zero if the previous block ended in the middle of a sequence.
+		 */
+		Vector incomplete;
+
+		/**
+		 * The number of bytes that are not continuation bytes.
+		 */
+		size_t leading = 0;
+
+		public:
+		CONFIG_UTF8_TARGET UTF8Counter()
+		  : before(V::zero()), error(V::zero()), incomplete(V::zero())
+		{
+		}
+
+		/**
+		 * Adds the next 16 bytes.
+		 */
+		CONFIG_UTF8_TARGET void add(Vector block)
+		{
+			leading += V::count_leading(block);
+			if (V::is_ascii(block))
+			{
+				// An ASCII block is only an error if it ends a sequence early.
+				error      = V::bit_or(error, incomplete);
+				incomplete = V::zero();
+				before     = block;
+				return;
+			}
+			Vector previous1 = V::template previous<1>(block, before);
+			Vector previous2 = V::template previous<2>(block, before);
+			Vector previous3 = V::template previous<3>(block, before);
+			Vector special   = V::bit_and(
+			  V::bit_and(
+			    V::lookup(Tables::PreviousHigh, V::high_nibbles(previous1)),
+			    V::lookup(Tables::PreviousLow, V::low_nibbles(previous1))),
+			  V::lookup(Tables::CurrentHigh, V::high_nibbles(block)));
+			// The third and fourth bytes of a sequence are continuation bytes
+			// that must follow another continuation byte.  Only bytes after a
+			// three- or four-byte lead have the high bit set here.
+			Vector third =
+			  V::subtract_saturated(previous2, V::splat(0xe0 - 0x80));
+			Vector fourth =
+			  V::subtract_saturated(previous3, V::splat(0xf0 - 0x80));
+			Vector expected =
+			  V::bit_and(V::bit_or(third, fourth), V::splat(0x80));
+			error      = V::bit_or(error, V::bit_xor(expected, special));
+			incomplete =
+			  V::subtract_saturated(block, V::load(Tables::MaxComplete));
+			before     = block;
+		}
+
+		/**
+		 * Returns the number of code points, or `std::nullopt` if the input
+		 * was not valid UTF-8 or ended in the middle of a sequence.
+		 */
+		CONFIG_UTF8_TARGET std::optional<size_t> finish()
+		{
+			if (V::any(V::bit_or(error, incomplete)))
+			{
+				return std::nullopt;
+			}
+			return leading;
+		}
+	};
+
+	/**
+	 * Returns the number of code points in `str`, or `std::nullopt` if it is
+	 * not valid UTF-8, using the vectorised validator.  The last partial
+	 * block is padded with zeros, which are counted and then subtracted.
+	 */
+	template<typename V>
+	CONFIG_UTF8_TARGET std::optional<size_t>
+	utf8_length_vector(std::string_view str)
+	{
+		auto          *p = reinterpret_cast<const uint8_t *>(str.data());
+		size_t         n = str.size();
+		size_t         i = 0;
+		UTF8Counter<V> counter;
+		for (; n - i >= 16; i += 16)
+		{
+			counter.add(V::load(p + i));
+		}
+		size_t padding = 0;
+		if (i < n)
+		{
+			alignas(16) uint8_t tail[16] = {0};
+			memcpy(tail, p + i, n - i);
+			padding = 16 - (n - i);
+			counter.add(V::load(tail));
+		}
+		auto length = counter.finish();
+		if (!length)
+		{
+			return std::nullopt;
+		}
+		return *length - padding;
+	}
+#endif
+
+	/**
+	 * Returns the number of code points in `str`, or `std::nullopt` if it is
+	 * not valid UTF-8.  Validation and counting are a single pass.  Strings of
+	 * at least one block use the vectorised validator where the CPU supports
+	 * one, and `utf8_length_scalar` otherwise.
+	 */
+	inline std::optional<size_t> utf8_length(std::string_view str)
+	{
+#ifdef CONFIG_UTF8_VECTOR
+		if ((str.size() >= 16) && has_utf8_vector())
+		{
+			return utf8_length_vector<CONFIG_UTF8_VECTOR>(str);
+		}
+#endif
+		return utf8_length_scalar(str);
+	}
+
+	/**
+	 * Validator for strings with a `minLength` or a `maxLength`.  The length
+	 * is the number of code points, as JSON Schema requires, and strings that
+	 * are not valid UTF-8 are rejected.
+	 */
+	template<size_t MinLength, size_t MaxLength>
+	bool validate_length(const ucl_object_t *o,
+	                     ucl_schema_error   *err,
+	                     Snapshot *)
+	{
+		size_t      len;
+		const char *str    = ucl_object_tolstring(o, &len);
+		auto        length = str ? utf8_length({str, len}) : std::nullopt;
+		if (!length)
+		{
+			return schema_error(err, o, "string is not valid UTF-8");
+		}
+		if (*length < MinLength)
+		{
+			return schema_error(
+			  err, o, "string is shorter than %zu characters", MinLength);
+		}
+		if (*length > MaxLength)
+		{
+			return schema_error(
+			  err, o, "string is longer than %zu characters", MaxLength);
+		}
+		return true;
+	}
+
+	/**
+	 * An IPv4 address, in network byte order.
+	 */
+	struct IPv4Address
+	{
+		/**
+		 * The bytes of the address.
+		 */
+		std::array<uint8_t, 4> bytes{};
+
+		/**
+		 * Addresses are equal if all of their bytes are equal.
+		 */
+		bool operator==(const IPv4Address &) const = default;
+	};
+
+	/**
+	 * An IPv6 address, in network byte order.
+	 */
+	struct IPv6Address
+	{
+		/**
+		 * The bytes of the address.
+		 */
+		std::array<uint8_t, 16> bytes{};
+
+		/**
+		 * Addresses are equal if all of their bytes are equal.
+		 */
+		bool operator==(const IPv6Address &) const = default;
+	};
+
+	/**
+	 * An address that may be either IPv4 or IPv6.  IPv4 addresses use the
+	 * first four bytes.
+	 */
+	struct IPAddress
+	{
+		/**
+		 * The address family, either `AF_INET` or `AF_INET6`.
+		 */
+		uint8_t family = AF_INET;
+
+		/**
+		 * The bytes of the address, in network byte order.
+		 */
+		std::array<uint8_t, 16> bytes{};
+
+		/**
+		 * Addresses are equal if they are the same family and all of their
+		 * bytes are equal.
+		 */
+		bool operator==(const IPAddress &) const = default;
+
+		/**
+		 * The length of the address in bits.
+		 */
+		uint8_t bits() const
+		{
+			return family == AF_INET ? 32 : 128;
+		}
+	};
+
+	/**
+	 * An address prefix, as written in CIDR notation.
+	 */
+	struct IPPrefix
+	{
+		/**
+		 * The network address.  Bits after the prefix length are zero.
+		 */
+		IPAddress address;
+
+		/**
+		 * The number of leading bits of `address` that are significant.
+		 */
+		uint8_t length = 0;
+
+		/**
+		 * Prefixes are equal if their addresses and lengths are equal.
+		 */
+		bool operator==(const IPPrefix &) const = default;
+
+		/**
+		 * Returns true if `a` is in this prefix.
+		 */
+		bool contains(const IPAddress &a) const
+		{
+			if (a.family != address.family)
+			{
+				return false;
+			}
+			size_t fullBytes = length / 8;
+			if (!std::equal(address.bytes.begin(),
+			                address.bytes.begin() + fullBytes,
+			                a.bytes.begin()))
+			{
+				return false;
+			}
+			unsigned remainder = length % 8;
+			if (remainder == 0)
+			{
+				return true;
+			}
+			uint8_t mask = 0xff << (8 - remainder);
+			return (a.bytes[fullBytes] & mask) == address.bytes[fullBytes];
+		}
+	};
+
+	/**
+	 * A URI, split into its components as described in RFC 3986.  Each
+	 * component is a view into the original string.  Components that are not
+	 * present are empty.
+	 */
+	struct URI
+	{
+		/**
+		 * The scheme, without the trailing colon.
+		 */
+		std::string_view scheme;
+
+		/**
+		 * The user information from the authority, without the `@`.
+		 */
+		std::string_view userinfo;
+
+		/**
+		 * The host from the authority.  IPv6 literals keep their brackets.
+		 */
+		std::string_view host;
+
+		/**
+		 * The port, or 0 if there is no port in the authority.
+		 */
+		uint16_t port = 0;
+
+		/**
+		 * The path.
+		 */
+		std::string_view path;
+
+		/**
+		 * The query, without the leading `?`.
+		 */
+		std::string_view query;
+
+		/**
+		 * The fragment, without the leading `#`.
+		 */
+		std::string_view fragment;
+
+		/**
+		 * URIs are equal if all of their components are equal.
+		 */
+		bool operator==(const URI &) const = default;
+	};
+
+	/**
+	 * Formats for strings.  Each format describes the `format` keyword value
+	 * that it handles, the type that strings in this format are decoded to,
+	 * and a `parse` function that returns the decoded value if the string is
+	 * valid.
+	 */
+	namespace formats
+	{
+		/**
+		 * Parse an address of either family with `inet_pton`.
+		 */
+		inline std::optional<IPAddress> parse_address(std::string_view str)
+		{
+			// inet_pton needs a null-terminated string.
+			char buffer[INET6_ADDRSTRLEN];
+			if (str.size() >= sizeof(buffer))
+			{
+				return std::nullopt;
+			}
+			std::copy(str.begin(), str.end(), buffer);
+			buffer[str.size()] = 0;
+			IPAddress address;
+			for (int family : {AF_INET, AF_INET6})
+			{
+				if (inet_pton(family, buffer, address.bytes.data()) == 1)
+				{
+					address.family = family;
+					return address;
+				}
+			}
+			return std::nullopt;
+		}
+
+		/**
+		 * The `ipv4` format: dotted-quad IPv4 addresses.
+		 */
+		struct IPv4
+		{
+			using Type                   = IPv4Address;
+			static constexpr char Name[] = "ipv4";
+			static std::optional<Type> parse(std::string_view str)
+			{
+				auto address = parse_address(str);
+				if (!address || (address->family != AF_INET))
+				{
+					return std::nullopt;
+				}
+				Type result;
+				std::copy_n(address->bytes.begin(), 4, result.bytes.begin());
+				return result;
+			}
+		};
+
+		/**
+		 * The `ipv6` format: IPv6 addresses in any of the RFC 4291 forms.
+		 */
+		struct IPv6
+		{
+			using Type                   = IPv6Address;
+			static constexpr char Name[] = "ipv6";
+			static std::optional<Type> parse(std::string_view str)
+			{
+				auto address = parse_address(str);
+				if (!address || (address->family != AF_INET6))
+				{
+					return std::nullopt;
+				}
+				return Type{address->bytes};
+			}
+		};
+
+		/**
+		 * The `cidr` format: an IPv4 or IPv6 address followed by a prefix
+		 * length.  Bits of the address after the prefix must be zero.
+		 */
+		struct CIDR
+		{
+			using Type                   = IPPrefix;
+			static constexpr char Name[] = "cidr";
+			static std::optional<Type> parse(std::string_view str)
+			{
+				size_t slash = str.find('/');
+				if ((slash == std::string_view::npos) ||
+				    (slash + 1 == str.size()) || (str.size() - slash > 4))
+				{
+					return std::nullopt;
+				}
+				auto address = parse_address(str.substr(0, slash));
+				if (!address)
+				{
+					return std::nullopt;
+				}
+				unsigned length = 0;
+				for (char c : str.substr(slash + 1))
+				{
+					if ((c < '0') || (c > '9'))
+					{
+						return std::nullopt;
+					}
+					length = length * 10 + (c - '0');
+				}
+				if (length > address->bits())
+				{
+					return std::nullopt;
+				}
+				Type prefix{*address, static_cast<uint8_t>(length)};
+				// Reject host bits, they almost certainly indicate a typo.
+				IPPrefix masked = prefix;
+				for (unsigned i = length; i < address->bits(); i++)
+				{
+					masked.address.bytes[i / 8] &= ~(0x80 >> (i % 8));
+				}
+				if (!(masked == prefix))
+				{
+					return std::nullopt;
+				}
+				return prefix;
+			}
+		};
+
+		/**
+		 * The `hostname` format: an RFC 1123 host name.  This is validated but
+		 * not decoded.
+		 */
+		struct Hostname
+		{
+			using Type                   = std::string_view;
+			static constexpr char Name[] = "hostname";
+			static std::optional<Type> parse(std::string_view str)
+			{
+				if (str.empty() || (str.size() > 253))
+				{
+					return std::nullopt;
+				}
+				size_t labelStart = 0;
+				for (size_t i = 0; i <= str.size(); i++)
+				{
+					if ((i == str.size()) || (str[i] == '.'))
+					{
+						size_t length = i - labelStart;
+						if ((length == 0) || (length > 63) ||
+						    (str[labelStart] == '-') || (str[i - 1] == '-'))
+						{
+							return std::nullopt;
+						}
+						labelStart = i + 1;
+						continue;
+					}
+					char c = str[i];
+					if (!(((c >= 'a') && (c <= 'z')) ||
+					      ((c >= 'A') && (c <= 'Z')) ||
+					      ((c >= '0') && (c <= '9')) || (c == '-')))
+					{
+						return std::nullopt;
+					}
+				}
+				return str;
+			}
+		};
+
+		/**
+		 * The `uri` format: an absolute URI, as defined by RFC 3986.
+		 */
+		struct Uri
+		{
+			using Type                   = URI;
+			static constexpr char Name[] = "uri";
+			static std::optional<Type> parse(std::string_view str)
+			{
+				URI uri;
+				for (unsigned char c : str)
+				{
+					if ((c <= ' ') || (c >= 0x7f) || (c == '"') ||
+					    (c == '<') || (c == '>') || (c == '\\') ||
+					    (c == '^') || (c == '`') || (c == '{') ||
+					    (c == '|') || (c == '}'))
+					{
+						return std::nullopt;
+					}
+				}
+				size_t colon = str.find(':');
+				if ((colon == 0) || (colon == std::string_view::npos) ||
+				    !isalpha(static_cast<unsigned char>(str[0])))
+				{
+					return std::nullopt;
+				}
+				uri.scheme = str.substr(0, colon);
+				for (char c : uri.scheme)
+				{
+					if (!isalnum(static_cast<unsigned char>(c)) &&
+					    (c != '+') && (c != '-') && (c != '.'))
+					{
+						return std::nullopt;
+					}
+				}
+				str = str.substr(colon + 1);
+				if (size_t hash = str.find('#'); hash != std::string_view::npos)
+				{
+					uri.fragment = str.substr(hash + 1);
+					str          = str.substr(0, hash);
+				}
+				if (size_t query = str.find('?');
+				    query != std::string_view::npos)
+				{
+					uri.query = str.substr(query + 1);
+					str       = str.substr(0, query);
+				}
+				if (str.starts_with("//"))
+				{
+					str                        = str.substr(2);
+					size_t           slash     = str.find('/');
+					std::string_view authority = str.substr(0, slash);
+					str = slash == std::string_view::npos ? std::string_view{}
+					                                      : str.substr(slash);
+					if (size_t at = authority.rfind('@');
+					    at != std::string_view::npos)
+					{
+						uri.userinfo = authority.substr(0, at);
+						authority    = authority.substr(at + 1);
+					}
+					size_t portStart = authority.rfind(':');
+					// A colon inside an IPv6 literal is not a port separator.
+					if ((portStart != std::string_view::npos) &&
+					    (authority.find(']', portStart) !=
+					     std::string_view::npos))
+					{
+						portStart = std::string_view::npos;
+					}
+					uri.host = authority.substr(0, portStart);
+					if (portStart != std::string_view::npos)
+					{
+						unsigned port = 0;
+						auto     digits = authority.substr(portStart + 1);
+						if (digits.size() > 5)
+						{
+							return std::nullopt;
+						}
+						for (char c : digits)
+						{
+							if ((c < '0') || (c > '9'))
+							{
+								return std::nullopt;
+							}
+							port = port * 10 + (c - '0');
+						}
+						if (port > 65535)
+						{
+							return std::nullopt;
+						}
+						uri.port = port;
+					}
+					if (uri.host.starts_with('[') &&
+					    (!uri.host.ends_with(']') ||
+					     !IPv6::parse(uri.host.substr(1, uri.host.size() - 2))))
+					{
+						return std::nullopt;
+					}
+				}
+				uri.path = str;
+				return uri;
+			}
+		};
+	} // namespace formats
+
+	/**
+	 * Adaptor for strings with a `format`.  Returns the value that was decoded
+	 * when the snapshot was created, or decodes the string if there is no
+	 * snapshot (for example, if the generated class was constructed directly
+	 * rather than with `make_config`).
+	 */
+	template<typename Format>
+	class FormatAdaptor
+	{
+		/**
+		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 */
+		const ucl_object_t *obj;
+
+		/**
+		 * Non-owning pointer to the snapshot that caches decoded values.
+		 */
+		const Snapshot *snapshot;
+
+		public:
+		/**
+		 * Constructor, captures non-owning references to a UCL object and the
+		 * snapshot that it belongs to.
+		 */
+		FormatAdaptor(const ucl_object_t *o, const SnapshotPtr &s)
+		  : obj(o), snapshot(s.get())
+		{
+		}
+
+		/**
+		 * Implicit conversion, returns the decoded value.  Invalid strings
+		 * decode as a default-constructed value, but these are rejected by
+		 * the generated validator.
+		 */
+		operator typename Format::Type()
+		{
+			if (snapshot != nullptr)
+			{
+				if (auto *value = snapshot->find<typename Format::Type>(obj))
+				{
+					return *value;
+				}
+			}
+			return Format::parse(StringViewAdaptor(obj)).value_or(
+			  typename Format::Type{});
+		}
+	};
+
+	/**
+	 * Validator for strings with a `format`.  Rejects strings that `Format`
+	 * cannot decode and records the decoded value in the snapshot, if there is
+	 * one.
+	 */
+	template<typename Format>
+	bool validate_format(const ucl_object_t *o,
+	                     ucl_schema_error *  err,
+	                     Snapshot *          snapshot)
+	{
+		auto value = Format::parse(StringViewAdaptor(o));
+		if (!value)
+		{
+			return schema_error(
+			  err, o, "string is not a valid %s", Format::Name);
+		}
+		// Views of the original string are not worth caching.
+		if constexpr (!std::is_same_v<typename Format::Type, std::string_view>)
+		{
+			if (snapshot != nullptr)
+			{
+				snapshot->insert(o, std::move(*value));
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Longest-prefix-match table for a set of `IPPrefix`es.  This is a Tree
+	 * Bitmap trie (Eatherton, Varghese and Dittia, 2004) with a four-bit
+	 * stride.  Each node is 12 bytes and describes four bits of the address
+	 * with a bitmap of the prefixes that end inside the node and a bitmap of
+	 * the children.  Children and results are stored contiguously, so they
+	 * are found by counting the set bits below the one being followed.  A
+	 * lookup touches at most one node per four bits of address.
+	 *
+	 * Tries are immutable once built and copies share the same storage.
+	 */
+	class PrefixTrie
+	{
+		/**
+		 * The number of address bits that each node describes.
+		 */
+		static constexpr unsigned Stride = 4;
+
+		/**
+		 * A node in the trie.
+		 */
+		struct Node
+		{
+			/**
+			 * Bitmap of the prefixes ending in this node.  A prefix of `l`
+			 * (< `Stride`) bits with value `b` is at bit `(1 << l) - 1 + b`.
+			 */
+			uint16_t internal = 0;
+
+			/**
+			 * Bitmap of the children, indexed by the next `Stride` bits.
+			 */
+			uint16_t external = 0;
+
+			/**
+			 * The index of the first child in the node array.
+			 */
+			uint32_t children = 0;
+
+			/**
+			 * The index of the first result in the result array.
+			 */
+			uint32_t results = 0;
+		};
+
+		/**
+		 * The storage for a trie.
+		 */
+		struct Table
+		{
+			/**
+			 * The prefixes, in the order in which they were provided.
+			 */
+			std::vector<IPPrefix> prefixes;
+
+			/**
+			 * The nodes.  The roots for IPv4 and IPv6 are nodes 0 and 1.
+			 */
+			std::vector<Node> nodes;
+
+			/**
+			 * Indexes into `prefixes` for the internal prefixes of each node.
+			 */
+			std::vector<uint32_t> results;
+		};
+
+		/**
+		 * The shared storage for the trie.
+		 */
+		std::shared_ptr<const Table> table;
+
+		/**
+		 * Returns the `Stride` bits of `a` starting at bit `offset`.
+		 */
+		static unsigned chunk(const IPAddress &a, unsigned offset)
+		{
+			uint8_t byte = a.bytes[offset / 8];
+			return (offset % 8) == 0 ? byte >> 4 : byte & 0xf;
+		}
+
+		/**
+		 * Returns the number of bits set in `bitmap` below `bit`.
+		 */
+		static unsigned rank(uint16_t bitmap, unsigned bit)
+		{
+			return std::popcount(
+			  static_cast<unsigned>(bitmap & ((1U << bit) - 1)));
+		}
+
+		public:
+		/**
+		 * Default constructor, creates an empty trie.
+		 */
+		PrefixTrie() = default;
+
+		/**
+		 * Build a trie from a set of prefixes.  If a prefix occurs more than
+		 * once, lookups return the index of the first occurrence.
+		 */
+		explicit PrefixTrie(std::vector<IPPrefix> prefixes)
+		{
+			auto t      = std::make_shared<Table>();
+			t->prefixes = std::move(prefixes);
+			auto &all   = t->prefixes;
+			// Sort the prefixes by family, address and then length, so that
+			// the prefixes below any node are grouped together in the order
+			// of the chunks that select the children.
+			std::vector<uint32_t> order(all.size());
+			for (uint32_t i = 0; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+			std::stable_sort(
+			  order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				  auto &pa = all[a];
+				  auto &pb = all[b];
+				  if (pa.address.family != pb.address.family)
+				  {
+					  return pa.address.family < pb.address.family;
+				  }
+				  if (pa.address.bytes != pb.address.bytes)
+				  {
+					  return pa.address.bytes < pb.address.bytes;
+				  }
+				  return pa.length < pb.length;
+			  });
+			// Build the nodes breadth first, allocating all of the children
+			// of a node together.
+			struct Pending
+			{
+				uint32_t              node;
+				unsigned              depth;
+				std::vector<uint32_t> prefixes;
+			};
+			std::vector<Pending> queue(2);
+			queue[0].node = 0;
+			queue[1].node = 1;
+			for (uint32_t i : order)
+			{
+				queue[all[i].address.family == AF_INET ? 0 : 1]
+				  .prefixes.push_back(i);
+			}
+			t->nodes.resize(2);
+			for (size_t next = 0; next < queue.size(); next++)
+			{
+				Pending  pending = std::move(queue[next]);
+				unsigned offset  = pending.depth * Stride;
+				std::array<int64_t, (1 << Stride) - 1> results;
+				results.fill(-1);
+				std::array<std::vector<uint32_t>, 1 << Stride> children;
+				Node                                            node;
+				for (uint32_t i : pending.prefixes)
+				{
+					auto    &prefix = all[i];
+					unsigned length = prefix.length - offset;
+					if (length < Stride)
+					{
+						unsigned bit =
+						  (1U << length) - 1 +
+						  (length == 0 ? 0
+						               : chunk(prefix.address, offset) >>
+						                   (Stride - length));
+						if (results[bit] == -1)
+						{
+							results[bit] = i;
+							node.internal |= 1U << bit;
+						}
+						continue;
+					}
+					unsigned c = chunk(prefix.address, offset);
+					node.external |= 1U << c;
+					children[c].push_back(i);
+				}
+				node.results = t->results.size();
+				for (int64_t r : results)
+				{
+					if (r != -1)
+					{
+						t->results.push_back(r);
+					}
+				}
+				node.children = t->nodes.size();
+				t->nodes.resize(
+				  t->nodes.size() +
+				  std::popcount(static_cast<unsigned>(node.external)));
+				uint32_t child = node.children;
+				for (auto &c : children)
+				{
+					if (!c.empty())
+					{
+						queue.push_back(
+						  {child++, pending.depth + 1, std::move(c)});
+					}
+				}
+				t->nodes[pending.node] = node;
+				// Drop the storage for processed entries as we go.
+				queue[next].prefixes = {};
+			}
+			table = std::move(t);
+		}
+
+		/**
+		 * Find the longest prefix that contains `a`.  Returns the index of
+		 * the prefix in the list that the trie was built from, or nothing if
+		 * no prefix contains the address.
+		 */
+		std::optional<size_t> lookup(const IPAddress &a) const
+		{
+			if (!table)
+			{
+				return std::nullopt;
+			}
+			auto                   &nodes = table->nodes;
+			const Node             *node = &nodes[a.family == AF_INET ? 0 : 1];
+			std::optional<uint32_t> best;
+			unsigned                bits = a.bits();
+			for (unsigned offset = 0;; offset += Stride)
+			{
+				unsigned c = offset < bits ? chunk(a, offset) : 0;
+				for (int length = Stride - 1; length >= 0; length--)
+				{
+					unsigned bit =
+					  (1U << length) - 1 + (c >> (Stride - length));
+					if (node->internal & (1U << bit))
+					{
+						best = table->results[node->results +
+						                      rank(node->internal, bit)];
+						break;
+					}
+				}
+				if ((offset >= bits) || !(node->external & (1U << c)))
+				{
+					break;
+				}
+				node = &nodes[node->children + rank(node->external, c)];
+			}
+			return best;
+		}
+
+		/**
+		 * Returns the number of prefixes in the trie.
+		 */
+		size_t size() const
+		{
+			return table ? table->prefixes.size() : 0;
+		}
+
+		/**
+		 * Returns the number of bytes of heap memory used by the trie.
+		 */
+		size_t heap_bytes() const
+		{
+			if (!table)
+			{
+				return 0;
+			}
+			return sizeof(Table) +
+			       table->prefixes.capacity() * sizeof(IPPrefix) +
+			       table->nodes.capacity() * sizeof(Node) +
+			       table->results.capacity() * sizeof(uint32_t);
+		}
+
+		/**
+		 * Returns the prefix at index `i` in the list that the trie was built
+		 * from.
+		 */
+		const IPPrefix &operator[](size_t i) const
+		{
+			return table->prefixes[i];
+		}
+
+		/**
+		 * Tries are equal if they were built from the same list of prefixes.
+		 */
+		bool operator==(const PrefixTrie &other) const
+		{
+			if (table == other.table)
+			{
+				return true;
+			}
+			if (size() != other.size())
+			{
+				return false;
+			}
+			for (size_t i = 0; i < size(); i++)
+			{
+				if (!((*this)[i] == other[i]))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	/**
+	 * Build a `PrefixTrie` from a UCL array of CIDR strings.  Strings that are
+	 * not valid prefixes are skipped.
+	 */
+	inline PrefixTrie make_prefix_trie(const ucl_object_t *o)
+	{
+		std::vector<IPPrefix> prefixes;
+		using Strings = Range<std::string_view, StringViewAdaptor>;
+		for (std::string_view str : Strings(o))
+		{
+			if (auto prefix = formats::CIDR::parse(str))
+			{
+				prefixes.push_back(*prefix);
+			}
+		}
+		return PrefixTrie(std::move(prefixes));
+	}
+
+	/**
+	 * Adaptor for arrays of CIDR strings that are exposed as a `PrefixTrie`.
+	 * Returns the trie that was built when the snapshot was created, or
+	 * builds one if there is no snapshot.
+	 */
+	class PrefixTrieAdaptor
+	{
+		/**
+		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 */
+		const ucl_object_t *obj;
+
+		/**
+		 * Non-owning pointer to the snapshot that holds the trie.
+		 */
+		const Snapshot *snapshot;
+
+		public:
+		/**
+		 * Constructor, captures non-owning references to a UCL object and the
+		 * snapshot that it belongs to.
+		 */
+		PrefixTrieAdaptor(const ucl_object_t *o, const SnapshotPtr &s)
+		  : obj(o), snapshot(s.get())
+		{
+		}
+
+		/**
+		 * Implicit conversion, returns the trie.
+		 */
+		operator PrefixTrie()
+		{
+			if (snapshot != nullptr)
+			{
+				if (auto *trie = snapshot->find<PrefixTrie>(obj))
+				{
+					return *trie;
+				}
+			}
+			return make_prefix_trie(obj);
+		}
+	};
+
+	/**
+	 * Validator for arrays of CIDR strings that are exposed as a
+	 * `PrefixTrie`.  Checks each element with `ItemValidator` and then builds
+	 * the trie and records it in the snapshot, if there is one.  Elements do
+	 * not record their own decoded values, only the trie is kept.
+	 */
+	template<auto ItemValidator>
+	bool validate_prefix_trie(const ucl_object_t *o,
+	                          ucl_schema_error *  err,
+	                          Snapshot *          snapshot)
+	{
+		if (!validate_items<ItemValidator>(o, err, nullptr))
+		{
+			return false;
+		}
+		if (snapshot != nullptr)
+		{
+			snapshot->insert(o, make_prefix_trie(o));
+		}
+		return true;
+	}
+
+	/**
+	 * A number of bytes, decoded from a `size` field.  This is a distinct
+	 * type so that byte counts are not accidentally mixed with other
+	 * integers.  `T` is the narrowest unsigned type that can hold every value
+	 * that the schema allows.
+	 */
+	template<typename T>
+	class ByteSize
+	{
+		/**
+		 * The number of bytes.
+		 */
+		T bytes = 0;
+
+		public:
+		/**
+		 * Default constructor, zero bytes.
+		 */
+		constexpr ByteSize() = default;
+
+		/**
+		 * Construct from a number of bytes.
+		 */
+		constexpr explicit ByteSize(T b) : bytes(b) {}
+
+		/**
+		 * Returns the number of bytes.
+		 */
+		constexpr T count() const
+		{
+			return bytes;
+		}
+
+		/**
+		 * Sizes are ordered by the number of bytes.
+		 */
+		constexpr auto operator<=>(const ByteSize &) const = default;
+	};
+
+	/**
+	 * Parse a size from a string.  Sizes are a decimal number, optionally
+	 * with a fractional part, followed by an optional suffix.  As with libucl,
+	 * the suffixes `k`, `m`, and `g` are powers of 1000 and `kb`, `mb`, and
+	 * `gb` are powers of 1024.  Suffixes are case insensitive.  Arithmetic is
+	 * exact: strings that overflow 64 bits or do not describe a whole number
+	 * of bytes are rejected.
+	 */
+	inline std::optional<uint64_t> parse_size(std::string_view str)
+	{
+		uint64_t whole     = 0;
+		uint64_t fraction  = 0;
+		uint64_t scale     = 1;
+		bool     hasDigits = false;
+		size_t   i         = 0;
+
+		auto isDigit = [&]() {
+			return (i < str.size()) && (str[i] >= '0') && (str[i] <= '9');
+		};
+		for (; isDigit(); i++)
+		{
+			hasDigits = true;
+			if (__builtin_mul_overflow(whole, 10, &whole) ||
+			    __builtin_add_overflow(whole, str[i] - '0', &whole))
+			{
+				return std::nullopt;
+			}
+		}
+		if ((i < str.size()) && (str[i] == '.'))
+		{
+			for (i++; isDigit(); i++)
+			{
+				hasDigits = true;
+				if (__builtin_mul_overflow(scale, 10, &scale))
+				{
+					return std::nullopt;
+				}
+				fraction = fraction * 10 + (str[i] - '0');
+			}
+		}
+		if (!hasDigits)
+		{
+			return std::nullopt;
+		}
+		uint64_t multiplier = 1;
+		if (i < str.size())
+		{
+			uint64_t base = 1000;
+			if (((str.size() - i) == 2) && ((str[i + 1] | 0x20) == 'b'))
+			{
+				base = 1024;
+			}
+			else if ((str.size() - i) != 1)
+			{
+				return std::nullopt;
+			}
+			switch (str[i] | 0x20)
+			{
+				case 'g':
+					multiplier *= base;
+					[[fallthrough]];
+				case 'm':
+					multiplier *= base;
+					[[fallthrough]];
+				case 'k':
+					multiplier *= base;
+					break;
+				default:
+					return std::nullopt;
+			}
+		}
+		// The fraction is less than `scale`, which is at most 10^19, and the
+		// multiplier is at most 2^30, so the product needs 128 bits.
+		unsigned __int128 fractionBytes =
+		  static_cast<unsigned __int128>(fraction) * multiplier;
+		if ((fractionBytes % scale) != 0)
+		{
+			return std::nullopt;
+		}
+		uint64_t bytes;
+		if (__builtin_mul_overflow(whole, multiplier, &bytes) ||
+		    __builtin_add_overflow(
+		      bytes, static_cast<uint64_t>(fractionBytes / scale), &bytes))
+		{
+			return std::nullopt;
+		}
+		return bytes;
+	}
+
+	/**
+	 * Decode a size from a UCL object.  libucl decodes unquoted sizes to
+	 * integers, or to floats if they have a fractional part, but leaves
+	 * quoted sizes as strings.  Returns `std::nullopt` for negative values,
+	 * values that are not a whole number of bytes, and unparseable strings.
+	 */
+	inline std::optional<uint64_t> decode_size(const ucl_object_t *obj)
+	{
+		switch (ucl_object_type(obj))
+		{
+			case UCL_INT:
+			{
+				int64_t value = ucl_object_toint(obj);
+				if (value < 0)
+				{
+					return std::nullopt;
+				}
+				return static_cast<uint64_t>(value);
+			}
+			case UCL_FLOAT:
+			{
+				// Integral doubles convert exactly.
+				double value = ucl_object_todouble(obj);
+				if (!(value >= 0) || (value >= 18446744073709551616.0) ||
+				    (value != std::trunc(value)))
+				{
+					return std::nullopt;
+				}
+				return static_cast<uint64_t>(value);
+			}
+			case UCL_STRING:
+				return parse_size(StringViewAdaptor(obj));
+			default:
+				return std::nullopt;
+		}
+	}
+
+	/**
+	 * Adaptor for `size` fields.  Integers are read directly, other
+	 * representations return the byte count that was decoded when the
+	 * snapshot was created, or are decoded on access if there is no snapshot.
+	 *
+	 * Adaptors are intended to be short-lived, created only as temporaries,
+	 * and must not outlive the object that they are adapting.
+	 */
+	template<typename T>
+	class SizeAdaptor
+	{
+		/**
+		 * Non-owning pointer to the UCL object that this adaptor is wrapping.
+		 */
+		const ucl_object_t *obj;
+
+		/**
+		 * Non-owning pointer to the snapshot that caches decoded values.
+		 */
+		const Snapshot *snapshot;
+
+		public:
+		/**
+		 * Constructor, captures non-owning references to a UCL object and the
+		 * snapshot that it belongs to.
+		 */
+		SizeAdaptor(const ucl_object_t *o, const SnapshotPtr &s)
+		  : obj(o), snapshot(s.get())
+		{
+		}
+
+		/**
+		 * Implicit conversion, returns the size in bytes.  The generated
+		 * validator has checked that the value fits in `T`.
+		 */
+		operator ByteSize<T>()
+		{
+			if (ucl_object_type(obj) == UCL_INT)
+			{
+				return ByteSize<T>(static_cast<T>(ucl_object_toint(obj)));
+			}
+			if (snapshot != nullptr)
+			{
+				if (auto *bytes = snapshot->find<uint64_t>(obj))
+				{
+					return ByteSize<T>(static_cast<T>(*bytes));
+				}
+			}
+			return ByteSize<T>(static_cast<T>(decode_size(obj).value_or(0)));
+		}
+	};
+
+	/**
+	 * Validator for `size` fields.  Decodes the size and checks it against
+	 * the schema's constraints, which the generator has converted to exact
+	 * integer bounds.  Sizes that were not stored as integers are recorded in
+	 * the snapshot, if there is one, so that they are decoded only once.
+	 */
+	template<uint64_t Min, uint64_t Max, uint64_t MultipleOf>
+	bool validate_size(const ucl_object_t *o,
+	                   ucl_schema_error *  err,
+	                   Snapshot *          snapshot)
+	{
+		auto bytes = decode_size(o);
+		if (!bytes)
+		{
+			return schema_error(err, o, "value is not a valid size");
+		}
+		if ((*bytes < Min) || (*bytes > Max))
+		{
+			return schema_error(err,
+			                    o,
+			                    "size %llu is not in the range %llu-%llu",
+			                    static_cast<unsigned long long>(*bytes),
+			                    static_cast<unsigned long long>(Min),
+			                    static_cast<unsigned long long>(Max));
+		}
+		if ((*bytes % MultipleOf) != 0)
+		{
+			return schema_error(err,
+			                    o,
+			                    "size %llu is not a multiple of %llu",
+			                    static_cast<unsigned long long>(*bytes),
+			                    static_cast<unsigned long long>(MultipleOf));
+		}
+		if ((snapshot != nullptr) && (ucl_object_type(o) != UCL_INT))
+		{
+			snapshot->insert(o, *bytes);
+		}
+		return true;
+	}
+
+	/**
+	 * Hash index over an array of objects, mapping the value of a key
+	 * property to the element that has that value.  Keys are views of the
+	 * strings in the UCL tree.
+	 */
+	using KeyIndex = std::unordered_map<std::string_view, const ucl_object_t *>;
+
+	/**
+	 * Range over an array of objects that can find elements by the value of
+	 * the `Key` property.  The generator emits a subclass that exposes `find`
+	 * as `find_by_<Key>`.  Lookups use the index that the validator stored in
+	 * the snapshot and fall back to a linear scan if there is no snapshot.
+	 */
+	template<typename T, typename Adaptor, StringLiteral Key>
+	class IndexedRange : public Range<T, Adaptor, true>
+	{
+		/**
+		 * The array that this range iterates over.
+		 */
+		const ucl_object_t *array;
+
+		/**
+		 * The snapshot that holds the index.
+		 */
+		SnapshotPtr snapshot;
+
+		/**
+		 * Construct a `T` from an element of the array.
+		 */
+		T adapt(const ucl_object_t *item) const
+		{
+			if constexpr (std::is_constructible_v<Adaptor,
+			                                      const ucl_object_t *,
+			                                      const SnapshotPtr &>)
+			{
+				return Adaptor(item, snapshot);
+			}
+			else
+			{
+				return Adaptor(item);
+			}
+		}
+
+		public:
+		/**
+		 * Constructor, captures the array and the snapshot that it belongs
+		 * to.
+		 */
+		IndexedRange(const ucl_object_t *arr, SnapshotPtr s)
+		  : Range<T, Adaptor, true>(arr, s), array(arr), snapshot(std::move(s))
+		{
+		}
+
+		/**
+		 * Returns the element whose `Key` property is `key`, if there is one.
+		 */
+		std::optional<T> find(std::string_view key) const
+		{
+			if (snapshot != nullptr)
+			{
+				if (auto *index = snapshot->find<KeyIndex>(array))
+				{
+					auto i = index->find(key);
+					if (i == index->end())
+					{
+						return std::nullopt;
+					}
+					return adapt(i->second);
+				}
+			}
+			for (auto item : Range<UCLPtr>(array))
+			{
+				auto value = ucl_object_lookup(item, Key);
+				if ((ucl_object_type(value) == UCL_STRING) &&
+				    (std::string_view(StringViewAdaptor(value)) == key))
+				{
+					return adapt(item);
+				}
+			}
+			return std::nullopt;
+		}
+	};
+
+	/**
+	 * Validator for arrays of objects with an `x-index`.  Checks each element
+	 * with `ItemValidator` (if there is one), rejects arrays in which two
+	 * elements have the same value for `Key`, and records the index in the
+	 * snapshot, if there is one.
+	 */
+	template<StringLiteral Key, auto... ItemValidator>
+	bool validate_index(const ucl_object_t *o,
+	                    ucl_schema_error *  err,
+	                    Snapshot *          snapshot)
+	{
+		KeyIndex index;
+		for (auto item : Range<UCLPtr>(o))
+		{
+			if (!(ItemValidator(item, err, snapshot) && ...))
+			{
+				return false;
+			}
+			auto value = ucl_object_lookup(item, Key);
+			if (ucl_object_type(value) != UCL_STRING)
+			{
+				continue;
+			}
+			std::string_view key = StringViewAdaptor(value);
+			if (!index.try_emplace(key, item).second)
+			{
+				return schema_error(err,
+				                    item,
+				                    "duplicate %s \"%.*s\"",
+				                    static_cast<const char *>(Key),
+				                    static_cast<int>(key.size()),
+				                    key.data());
+			}
+		}
+		if (snapshot != nullptr)
+		{
+			snapshot->insert(o, std::move(index));
+		}
+		return true;
+	}
+
+	/**
+	 * Set of integers in a flat, open-addressed table with linear probing.
+	 * The table is sized for a number of elements when it is created and
+	 * never grows, so inserting more than that is not allowed.
+	 */
+	class IntegerSet
+	{
+		/**
+		 * The values in each slot.
+		 */
+		std::vector<int64_t> values;
+
+		/**
+		 * Is each slot in use?
+		 */
+		std::vector<bool> used;
+
+		/**
+		 * The number of slots minus one.  The number of slots is a power of
+		 * two, at least twice the number of elements.
+		 */
+		size_t mask;
+
+		public:
+		/**
+		 * Construct a set that can hold `capacity` elements.
+		 */
+		explicit IntegerSet(size_t capacity)
+		  : mask(std::bit_ceil(std::max<size_t>(capacity, 1) * 2) - 1)
+		{
+			values.resize(mask + 1);
+			used.resize(mask + 1);
+		}
+
+		/**
+		 * Add `value` to the set.  Returns false if it was already present.
+		 */
+		bool insert(int64_t value)
+		{
+			// Fibonacci hashing, which spreads sequential IDs across the
+			// table.
+			uint64_t hash = static_cast<uint64_t>(value) * 0x9e3779b97f4a7c15ULL;
+			for (size_t i = (hash ^ (hash >> 32)) & mask;; i = (i + 1) & mask)
+			{
+				if (!used[i])
+				{
+					used[i]   = true;
+					values[i] = value;
+					return true;
+				}
+				if (values[i] == value)
+				{
+					return false;
+				}
+			}
+		}
+	};
+
+	/**
+	 * Validator for arrays with `uniqueItems`, whose items are strings (if
+	 * `T` is `std::string_view`) or integers (if `T` is `int64_t`).  Each
+	 * item is inserted into a hash set, so this takes linear time, where
+	 * libucl compares every pair of items.  The error reports the index of
+	 * the first duplicate.
+	 */
+	template<typename T>
+	bool validate_unique(const ucl_object_t *o,
+	                     ucl_schema_error *  err,
+	                     Snapshot *)
+	{
+		static_assert(std::is_same_v<T, std::string_view> ||
+		                std::is_same_v<T, int64_t>,
+		              "Unique items must be strings or integers");
+		size_t count = 0;
+		for (auto item : Range<UCLPtr>(o))
+		{
+			(void)item;
+			count++;
+		}
+		std::conditional_t<std::is_same_v<T, int64_t>,
+		                   IntegerSet,
+		                   std::unordered_set<std::string_view>>
+		       seen(count);
+		size_t index = 0;
+		for (auto item : Range<UCLPtr>(o))
+		{
+			bool inserted;
+			if constexpr (std::is_same_v<T, int64_t>)
+			{
+				inserted = seen.insert(ucl_object_toint(item));
+			}
+			else
+			{
+				inserted =
+				  seen.insert(std::string_view(StringViewAdaptor(item))).second;
+			}
+			if (!inserted)
+			{
+				return schema_error(
+				  err, item, "item %zu is a duplicate of an earlier item", index);
+			}
+			index++;
+		}
+		return true;
+	}
+
+	/**
+	 * Removes every property of the UCL object `o` whose key is not in
+	 * `keep`.  Used by the generated `compact` methods to drop parts of a
+	 * config that no accessor can reach.
+	 */
+	inline void compact_object(ucl_object_t *                          o,
+	                           std::initializer_list<std::string_view> keep)
+	{
+		if (ucl_object_type(o) != UCL_OBJECT)
+		{
+			return;
+		}
+		// Collect the keys first, deleting invalidates the iterator.
+		std::vector<std::string> unused;
+		ucl_object_iter_t        iter = nullptr;
+		while (auto *property = ucl_object_iterate(o, &iter, false))
+		{
+			size_t           length;
+			const char *     keyBytes = ucl_object_keyl(property, &length);
+			std::string_view key{keyBytes, length};
+			if (std::find(keep.begin(), keep.end(), key) == keep.end())
+			{
+				unused.emplace_back(key);
+			}
+		}
+		for (auto &key : unused)
+		{
+			ucl_object_delete_key(o, key.c_str());
+		}
+	}
+
+	/**
+	 * Applies `Compactor` to every element of the array `o`.
+	 */
+	template<auto Compactor>
+	void compact_items(ucl_object_t *o)
+	{
+		if (ucl_object_type(o) != UCL_ARRAY)
+		{
+			return;
+		}
+		ucl_object_iter_t iter = nullptr;
+		while (auto *item = ucl_object_iterate(o, &iter, false))
+		{
+			Compactor(const_cast<ucl_object_t *>(item));
+		}
+	}
+
+	/**
+	 * Fast, non-cryptographic, 64-bit hash of `length` bytes at `data`.  This
+	 * consumes 16 bytes per step with a folded 64x64->128-bit multiply, in
+	 * the style of wyhash.  It is not collision resistant and must not be
+	 * used where an attacker chooses the input and benefits from a collision.
+	 */
+	inline uint64_t
+	hash_bytes(const void *data, size_t length, uint64_t seed = 0)
+	{
+		auto mix = [](uint64_t a, uint64_t b) {
+			unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+			return static_cast<uint64_t>(product) ^
+			       static_cast<uint64_t>(product >> 64);
+		};
+		auto load = [](const unsigned char *p, size_t bytes) {
+			uint64_t value = 0;
+			memcpy(&value, p, bytes);
+			return value;
+		};
+		const auto *p    = static_cast<const unsigned char *>(data);
+		uint64_t    hash = mix(seed ^ 0xa0761d6478bd642fULL,
+		                       length ^ 0xe7037ed1a0b428dbULL);
+		for (; length > 16; p += 16, length -= 16)
+		{
+			hash = mix(load(p, 8) ^ 0x8ebc6af09c88c6e3ULL,
+			           load(p + 8, 8) ^ hash);
+		}
+		uint64_t low  = load(p, std::min<size_t>(length, 8));
+		uint64_t high = (length > 8) ? load(p + 8, length - 8) : 0;
+		return mix(mix(low ^ 0x589965cc75374cc3ULL, high ^ hash),
+		           0x1d8e4e27c47d124fULL ^ length);
+	}
+
+	/**
+	 * Combine `value` into the running hash `seed`.
+	 */
+	inline uint64_t hash_combine(uint64_t seed, uint64_t value)
+	{
+		uint64_t words[2] = {seed, value};
+		return hash_bytes(words, sizeof(words));
+	}
+
+	/**
+	 * Hash of a value returned by a generated accessor.  Values that compare
+	 * equal have the same hash: floating-point zeroes are normalised, strings
+	 * and ranges are hashed by their contents, and generated classes provide
+	 * their own `hash` method.
+	 */
+	template<typename T>
+	uint64_t value_hash(const T &value)
+	{
+		if constexpr (requires { value.has_value(); })
+		{
+			return value ? hash_combine(1, value_hash(*value)) : 0;
+		}
+		else if constexpr (requires { value.hash(); })
+		{
+			return value.hash();
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			T normalised = (value == 0) ? 0 : value;
+			return hash_bytes(&normalised, sizeof(normalised));
+		}
+		else if constexpr (std::is_same_v<T, std::string_view>)
+		{
+			return hash_bytes(value.data(), value.size());
+		}
+		else if constexpr (requires { value.count(); })
+		{
+			// Durations and sizes.
+			return value_hash(value.count());
+		}
+		else if constexpr (std::is_same_v<T, URI>)
+		{
+			uint64_t hash = value_hash(value.port);
+			for (auto component : {value.scheme,
+			                       value.userinfo,
+			                       value.host,
+			                       value.path,
+			                       value.query,
+			                       value.fragment})
+			{
+				hash = hash_combine(hash, value_hash(component));
+			}
+			return hash;
+		}
+		else if constexpr (std::is_same_v<T, PrefixTrie>)
+		{
+			uint64_t hash = value.size();
+			for (size_t i = 0; i < value.size(); i++)
+			{
+				hash = hash_combine(hash, value_hash(value[i]));
+			}
+			return hash;
+		}
+		else if constexpr (requires(T range) { range.begin(); })
+		{
+			T        range = value;
+			uint64_t hash  = 0;
+			for (auto &&item : range)
+			{
+				hash = hash_combine(hash, value_hash(item));
+			}
+			return hash;
+		}
+		else
+		{
+			static_assert(std::has_unique_object_representations_v<T>,
+			              "No hash for this type");
+			return hash_bytes(&value, sizeof(value));
+		}
+	}
+
+	/**
+	 * The lazily computed hash of a generated class.  Copies keep the value,
+	 * so a config that is copied or stored does not need to hash its tree
+	 * again.  Computing the hash is idempotent, so threads that race to
+	 * compute it store the same value.
+	 */
+	class CachedHash
+	{
+		/**
+		 * The hash, or zero if it has not been computed.
+		 */
+		mutable std::atomic<uint64_t> value{0};
+
+		public:
+		/**
+		 * Default constructor, no hash has been computed.
+		 */
+		CachedHash() = default;
+
+		/**
+		 * Copy constructor, keeps the hash if it has been computed.
+		 */
+		CachedHash(const CachedHash &other)
+		  : value(other.value.load(std::memory_order_relaxed))
+		{
+		}
+
+		/**
+		 * Copy assignment, keeps the hash if it has been computed.
+		 */
+		CachedHash &operator=(const CachedHash &other)
+		{
+			value.store(other.value.load(std::memory_order_relaxed),
+			            std::memory_order_relaxed);
+			return *this;
+		}
+
+		/**
+		 * Returns the hash if it has been computed, or zero.
+		 */
+		uint64_t peek() const
+		{
+			return value.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * Returns the hash, calling `compute` to compute it the first time.
+		 */
+		template<typename Compute>
+		uint64_t get(Compute &&compute) const
+		{
+			uint64_t hash = peek();
+			if (hash == 0)
 			{
-				return visit_impl(StringViewAdaptor(obj[KeyName]), visitors...);
+				// Zero means not computed, so is never a hash.
+				hash = std::max<uint64_t>(compute(), 1);
+				value.store(hash, std::memory_order_relaxed);
 			}
-			else
+			return hash;
+		}
+	};
+
+	/**
+	 * Owning pointer to the cold fields of a materialized config, which are
+	 * stored outside the class so that the hot fields share a cache line.
+	 * Copying a config copies its cold fields, so each config makes a single
+	 * allocation for them, with no reference count.  The allocation is made
+	 * with `malloc`, so that `bytes` can measure it.
+	 */
+	template<typename T>
+	class ColdPtr
+	{
+		static_assert(alignof(T) <= alignof(std::max_align_t),
+		              "malloc does not support over-aligned types");
+
+		/**
+		 * Deleter that destroys the cold fields and frees their block.
+		 */
+		struct Free
+		{
+			void operator()(const T *p) const
 			{
-				return visit_impl(StringViewAdaptor(obj[KeyName]),
-				                  Dispatcher{visitors...});
+				p->~T();
+				free(const_cast<T *>(p));
+			}
+		};
+
+		/**
+		 * The cold fields, null only if this has been moved from.
+		 */
+		std::unique_ptr<const T, Free> fields;
+
+		/**
+		 * Allocate a block and construct the cold fields in it from `arg`.
+		 */
+		template<typename Arg>
+		static std::unique_ptr<const T, Free> make(const Arg &arg)
+		{
+			std::unique_ptr<void, decltype(&free)> block(malloc(sizeof(T)),
+			                                             free);
+			if (!block)
+			{
+				throw std::bad_alloc();
 			}
+			std::unique_ptr<const T, Free> result(new (block.get()) T(arg));
+			block.release();
+			return result;
 		}
 
+		public:
 		/**
-		 * Visit.  This should be called with a list of lambdas as the
-		 * argument.  Each lambda should take one of the types.  Unlike the
-		 * `visit` method, this does not need to cover all cases.  Any cases
-		 * that are not handled will be silently ignored.
+		 * Constructor, decodes the cold fields from `o`.
 		 */
-		template<typename... Visitors>
-		auto visit_some(Visitors &&...visitors)
+		ColdPtr(const ucl_object_t *o) : fields(make(o)) {}
+
+		/**
+		 * Copy constructor, copies the cold fields.
+		 */
+		ColdPtr(const ColdPtr &other)
+		  : fields(other.fields ? make(*other.fields) : nullptr)
 		{
-			return visit_impl(StringViewAdaptor(obj[KeyName]),
-			                  Dispatcher{visitors..., [](auto &&) {}});
+		}
+
+		/**
+		 * Copy assignment, copies the cold fields.
+		 */
+		ColdPtr &operator=(const ColdPtr &other)
+		{
+			if (this != &other)
+			{
+				fields = other.fields ? make(*other.fields) : nullptr;
+			}
+			return *this;
+		}
+
+		ColdPtr(ColdPtr &&)            = default;
+		ColdPtr &operator=(ColdPtr &&) = default;
+
+		/**
+		 * Returns the cold fields.
+		 */
+		const T *operator->() const
+		{
+			return fields.get();
+		}
+
+		/**
+		 * Returns true unless this has been moved from.
+		 */
+		explicit operator bool() const
+		{
+			return fields != nullptr;
+		}
+
+		/**
+		 * Returns the number of bytes of heap memory used by the cold fields:
+		 * the block that holds them, as reported by `malloc_bytes`, and any
+		 * memory that they own.
+		 */
+		size_t heap_bytes() const
+		{
+			if (!fields)
+			{
+				return 0;
+			}
+			return malloc_bytes(const_cast<T *>(fields.get()), sizeof(T)) +
+			       CONFIG_DETAIL_NAMESPACE::heap_bytes(*fields);
 		}
 	};
 
 	/**
-	 * Property adaptor.  Wraps some other adaptor for the value and also
-	 * provides an accessor for the key.
+	 * Returns false if the hashes `x` and `y` are both known (not zero) and
+	 * differ, in which case the objects that they are from cannot be equal.
 	 */
-	template<typename Adaptor>
-	class PropertyAdaptor : public Adaptor
+	inline bool may_be_equal(uint64_t x, uint64_t y)
+	{
+		return (x == 0) || (y == 0) || (x == y);
+	}
+
+	/**
+	 * Cache used by the generated `make_config_cached` functions.  Records
+	 * the hashes of documents that have passed validation against a schema
+	 * (identified by the fingerprint that the generator computes) so that
+	 * pushing the same bytes again skips the libucl validator.  Optionally,
+	 * it also keeps the most recent config, which is returned without parsing
+	 * if the same document is seen again.
+	 *
+	 * If constructed with a path, the validated hashes are loaded from and
+	 * appended to that file, so the cache survives restarts.  The file is
+	 * trusted: anyone who can write to it can cause documents to skip schema
+	 * validation, and the hash is not collision resistant.
+	 *
+	 * All methods are safe to call from multiple threads.
+	 */
+	template<typename Config>
+	class ConfigCache
 	{
+		/**
+		 * Protects the other fields.
+		 */
+		std::mutex lock;
+
+		/**
+		 * Hashes of the documents that have been validated, combined with
+		 * the fingerprint of the schema.
+		 */
+		std::unordered_set<uint64_t> validated;
+
+		/**
+		 * The most recent config, and the hash of the document that it was
+		 * created from, if configs are reused.
+		 */
+		std::optional<std::pair<uint64_t, Config>> last;
+
+		/**
+		 * Whether to keep the most recent config.
+		 */
+		bool reuseConfigs;
+
+		/**
+		 * The file that validated hashes are appended to, or null if the
+		 * cache is not persistent.
+		 */
+		std::unique_ptr<FILE, decltype(&fclose)> file{nullptr, fclose};
+
 		public:
 		/**
-		 * Constructor, captures a non-owning reference to a UCL object.
+		 * Counters for the number of documents handled in each way.
 		 */
-		PropertyAdaptor(const ucl_object_t *o) : Adaptor(o) {}
+		struct Statistics
+		{
+			/**
+			 * Documents for which the previous config was returned.
+			 */
+			size_t reused = 0;
+
+			/**
+			 * Documents that skipped the libucl validator.
+			 */
+			size_t skipped = 0;
+
+			/**
+			 * Documents that were fully validated.
+			 */
+			size_t validated = 0;
+		};
 
+		private:
 		/**
-		 * Provide the key as a string view.
+		 * The counters.
 		 */
-		std::string_view key()
+		Statistics stats;
+
+		public:
+		/**
+		 * Constructor.  If `reuse` is true then the most recent config is
+		 * kept.  If `path` is not null then validated hashes are persisted
+		 * in that file.
+		 */
+		ConfigCache(bool reuse = false, const char *path = nullptr)
+		  : reuseConfigs(reuse)
 		{
-			return ucl_object_key(Adaptor::obj);
+			if (path == nullptr)
+			{
+				return;
+			}
+			if (FILE *in = fopen(path, "rb"))
+			{
+				uint64_t hash;
+				while (fread(&hash, sizeof(hash), 1, in) == 1)
+				{
+					validated.insert(hash);
+				}
+				fclose(in);
+			}
+			file.reset(fopen(path, "ab"));
+		}
+
+		/**
+		 * Returns the config for the document with hash `hash`, if it is the
+		 * most recent one and configs are being reused.
+		 */
+		std::optional<Config> find(uint64_t hash)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (last && (last->first == hash))
+			{
+				stats.reused++;
+				return last->second;
+			}
+			return std::nullopt;
+		}
+
+		/**
+		 * Returns true if the document with hash `hash` has been validated.
+		 */
+		bool is_validated(uint64_t hash)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			bool                        found = validated.contains(hash);
+			if (found)
+			{
+				stats.skipped++;
+			}
+			else
+			{
+				stats.validated++;
+			}
+			return found;
+		}
+
+		/**
+		 * Record that the document with hash `hash` is valid and produced
+		 * `config`.
+		 */
+		void insert(uint64_t hash, const Config &config)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (validated.insert(hash).second && file)
+			{
+				fwrite(&hash, sizeof(hash), 1, file.get());
+				fflush(file.get());
+			}
+			if (reuseConfigs)
+			{
+				last.emplace(hash, config);
+			}
+		}
+
+		/**
+		 * Returns a copy of the counters.
+		 */
+		Statistics statistics()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			return stats;
 		}
 	};
 
 	/**
-	 * Helper to construct a value with an adaptor if it exists.  If `o` is not
-	 * null, uses `Adaptor` to construct an instance of `T`.  Returns an
-	 * `optional<T>`, where the value is present if `o` is not null.
+	 * Implementation of the generated `make_config_cached` functions.  Parses
+	 * `text` and creates a config with `MakeConfig`, unless the hash of
+	 * `text` and the schema's `fingerprint` is in `cache`.  Documents that
+	 * were validated before are passed to `MakeConfigUnchecked`, which skips
+	 * the libucl validator but still builds the snapshot.
 	 */
-	template<typename Adaptor, typename T = Adaptor>
-	std::optional<T> make_optional(const ucl_object_t *o)
+	template<typename Config, auto MakeConfig, auto MakeConfigUnchecked>
+	std::variant<Config, ucl_schema_error>
+	cached_make_config(std::string_view     text,
+	                   uint64_t             fingerprint,
+	                   ConfigCache<Config> &cache,
+	                   bool                 compact)
 	{
-		if (o == nullptr)
+		// Compacting modifies the tree, so compacted configs are distinct.
+		uint64_t hash = hash_bytes(text.data(), text.size(), fingerprint) ^
+		                static_cast<uint64_t>(compact);
+		if (auto config = cache.find(hash))
 		{
-			return {};
+			return *config;
+		}
+		struct ucl_parser *p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+		ucl_parser_add_chunk(
+		  p, reinterpret_cast<const unsigned char *>(text.data()), text.size());
+		if (const char *error = ucl_parser_get_error(p))
+		{
+			ucl_schema_error err{};
+			err.code = UCL_SCHEMA_UNKNOWN;
+			snprintf(err.msg, sizeof(err.msg), "%s", error);
+			ucl_parser_free(p);
+			return err;
+		}
+		UCLPtr obj{ucl_parser_get_object(p)};
+		ucl_parser_free(p);
+		// The `UCLPtr` holds its own reference.
+		ucl_object_unref(obj);
+		auto result = cache.is_validated(hash)
+		                ? MakeConfigUnchecked(obj, compact)
+		                : MakeConfig(obj, compact);
+		if (auto *config = std::get_if<Config>(&result))
+		{
+			cache.insert(hash, *config);
+		}
+		return result;
+	}
+
+	/**
+	 * Limits on the resources used to create a config from a document that
+	 * is not trusted, used by the generated `make_config_limited`.  A limit
+	 * of zero is no limit.
+	 */
+	struct ConfigLimits
+	{
+		/**
+		 * The maximum length of the document's text.
+		 */
+		size_t maxBytes = 0;
+
+		/**
+		 * The maximum nesting depth.  The document's root is at depth one
+		 * and the values that it contains are at depth two.
+		 */
+		size_t maxDepth = 0;
+
+		/**
+		 * The maximum number of values in the document, including objects
+		 * and arrays.
+		 */
+		size_t maxNodes = 0;
+
+		/**
+		 * The maximum number of items in any array.
+		 */
+		size_t maxArrayLength = 0;
+
+		/**
+		 * The maximum time to spend before the document is validated.
+		 */
+		std::chrono::nanoseconds timeout{0};
+
+		/**
+		 * Returns the tighter of each of the limits in this and `other`.
+		 */
+		constexpr ConfigLimits tightened(const ConfigLimits &other) const
+		{
+			auto tighter = [](auto a, auto b) {
+				if (a == decltype(a){0})
+				{
+					return b;
+				}
+				if (b == decltype(b){0})
+				{
+					return a;
+				}
+				return std::min(a, b);
+			};
+			return {tighter(maxBytes, other.maxBytes),
+			        tighter(maxDepth, other.maxDepth),
+			        tighter(maxNodes, other.maxNodes),
+			        tighter(maxArrayLength, other.maxArrayLength),
+			        tighter(timeout, other.timeout)};
 		}
-		return Adaptor(o);
+	};
+
+	/**
+	 * Returns the greatest depth of brackets and braces in the UCL text
+	 * `text`, or stops and returns a depth one greater than `limit` (if it is
+	 * not zero) as soon as that depth is reached.  Strings, comments, and
+	 * heredocs are skipped.  This is a lexical scan that runs before parsing,
+	 * so that libucl never builds, or recursively frees, a tree that is too
+	 * deep.
+	 */
+	inline size_t ucl_nesting_depth(std::string_view text, size_t limit)
+	{
+		size_t depth    = 0;
+		size_t greatest = 0;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			char c = text[i];
+			switch (c)
+			{
+				case '"':
+				case '\'':
+					// Skip a string, and any escaped characters in it.
+					for (i++; (i < text.size()) && (text[i] != c); i++)
+					{
+						if (text[i] == '\\')
+						{
+							i++;
+						}
+					}
+					break;
+				case '#':
+					i = text.find('\n', i);
+					break;
+				case '/':
+					// libucl allows multi-line comments to nest.
+					if (text.substr(i, 2) == "/*")
+					{
+						size_t comments = 0;
+						for (; i + 1 < text.size(); i++)
+						{
+							if (text.substr(i, 2) == "/*")
+							{
+								comments++;
+								i++;
+							}
+							else if (text.substr(i, 2) == "*/")
+							{
+								i++;
+								if (--comments == 0)
+								{
+									break;
+								}
+							}
+						}
+					}
+					break;
+				case '<':
+					// A heredoc runs from `<<TERMINATOR` to a line that
+					// contains only the terminator.
+					if (text.substr(i, 2) == "<<")
+					{
+						size_t start = i + 2;
+						size_t end   = start;
+						while ((end < text.size()) && (text[end] >= 'A') &&
+						       (text[end] <= 'Z'))
+						{
+							end++;
+						}
+						if ((end > start) && (end < text.size()) &&
+						    (text[end] == '\n'))
+						{
+							std::string terminator = "\n";
+							terminator += text.substr(start, end - start);
+							i = text.find(terminator, end);
+							if (i != std::string_view::npos)
+							{
+								i += terminator.size();
+							}
+						}
+					}
+					break;
+				case '{':
+				case '[':
+					greatest = std::max(greatest, ++depth);
+					if ((limit != 0) && (depth > limit))
+					{
+						return depth;
+					}
+					break;
+				case '}':
+				case ']':
+					if (depth > 0)
+					{
+						depth--;
+					}
+					break;
+			}
+			if (i == std::string_view::npos)
+			{
+				break;
+			}
+		}
+		return greatest;
+	}
+
+	/**
+	 * Check the tree `root` against the depth, node, and array length
+	 * `limits`, and against `deadline`.  The tree is walked without
+	 * recursion and the walk stops at the first limit that is exceeded.
+	 * Returns false and fills in `err` if a limit is exceeded.
+	 */
+	inline bool check_limits(const ucl_object_t                   *root,
+	                         const ConfigLimits                   &limits,
+	                         std::chrono::steady_clock::time_point deadline,
+	                         ucl_schema_error                     *err)
+	{
+		std::vector<std::pair<const ucl_object_t *, size_t>> pending;
+		pending.emplace_back(root, 1);
+		size_t nodes = 0;
+		while (!pending.empty())
+		{
+			auto [o, depth] = pending.back();
+			pending.pop_back();
+			nodes++;
+			if ((limits.maxNodes != 0) && (nodes > limits.maxNodes))
+			{
+				return schema_error(
+				  err, o, "document has more than %zu values", limits.maxNodes);
+			}
+			if ((limits.maxDepth != 0) && (depth > limits.maxDepth))
+			{
+				return schema_error(err,
+				                    o,
+				                    "document is nested more than %zu deep",
+				                    limits.maxDepth);
+			}
+			if ((limits.timeout.count() != 0) && ((nodes % 1024) == 0) &&
+			    (std::chrono::steady_clock::now() > deadline))
+			{
+				return schema_error(err, o, "deadline exceeded");
+			}
+			auto type = ucl_object_type(o);
+			if ((type != UCL_OBJECT) && (type != UCL_ARRAY))
+			{
+				continue;
+			}
+			size_t            items = 0;
+			ucl_object_iter_t iter  = nullptr;
+			while (auto *child = ucl_object_iterate(o, &iter, false))
+			{
+				items++;
+				if ((type == UCL_ARRAY) && (limits.maxArrayLength != 0) &&
+				    (items > limits.maxArrayLength))
+				{
+					return schema_error(err,
+					                    o,
+					                    "array has more than %zu items",
+					                    limits.maxArrayLength);
+				}
+				pending.emplace_back(child, depth + 1);
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Implementation of the generated `make_config_limited` functions.
+	 * Checks the length and nesting of `text`, parses it with macros such as
+	 * `.include` disabled, checks the size and shape of the tree and the
+	 * deadline, and then creates a config with `MakeConfig`.  Each step is
+	 * bounded by the limits that the previous steps checked, so the time and
+	 * memory used before validation are proportional to the limits.
+	 */
+	template<typename Config, auto MakeConfig>
+	std::variant<Config, ucl_schema_error>
+	limited_make_config(std::string_view    text,
+	                    const ConfigLimits &limits,
+	                    bool                compact)
+	{
+		auto             start    = std::chrono::steady_clock::now();
+		auto             deadline = start + limits.timeout;
+		ucl_schema_error err{};
+		err.code = UCL_SCHEMA_CONSTRAINT;
+		auto expired = [&]() {
+			if ((limits.timeout.count() != 0) &&
+			    (std::chrono::steady_clock::now() > deadline))
+			{
+				snprintf(err.msg, sizeof(err.msg), "deadline exceeded");
+				return true;
+			}
+			return false;
+		};
+		if ((limits.maxBytes != 0) && (text.size() > limits.maxBytes))
+		{
+			snprintf(err.msg,
+			         sizeof(err.msg),
+			         "document is %zu bytes, more than %zu",
+			         text.size(),
+			         limits.maxBytes);
+			return err;
+		}
+		if ((limits.maxDepth != 0) &&
+		    (ucl_nesting_depth(text, limits.maxDepth) > limits.maxDepth))
+		{
+			snprintf(err.msg,
+			         sizeof(err.msg),
+			         "document is nested more than %zu deep",
+			         limits.maxDepth);
+			return err;
+		}
+		if (expired())
+		{
+			return err;
+		}
+		struct ucl_parser *p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS |
+		                                      UCL_PARSER_DISABLE_MACRO);
+		ucl_parser_add_chunk(
+		  p, reinterpret_cast<const unsigned char *>(text.data()), text.size());
+		if (const char *error = ucl_parser_get_error(p))
+		{
+			err.code = UCL_SCHEMA_UNKNOWN;
+			snprintf(err.msg, sizeof(err.msg), "%s", error);
+			ucl_parser_free(p);
+			return err;
+		}
+		UCLPtr obj{ucl_parser_get_object(p)};
+		ucl_parser_free(p);
+		// The `UCLPtr` holds its own reference.
+		ucl_object_unref(obj);
+		if (expired() || !check_limits(obj, limits, deadline, &err))
+		{
+			return err;
+		}
+		return MakeConfig(obj, compact);
 	}
 
+	/**
+	 * The generated checks for the constraints that the embedded schema does
+	 * not check, split into steps so that an asynchronous load can run a few
+	 * at a time, and the function that creates a config once they have
+	 * passed.
+	 */
+	template<typename Config>
+	struct ValidationSteps
+	{
+		/**
+		 * The number of steps.
+		 */
+		size_t count;
+
+		/**
+		 * Run step `i` on `obj`, recording derived values in `snapshot`.
+		 */
+		bool (*run)(size_t              i,
+		            const ucl_object_t *obj,
+		            ucl_schema_error   *err,
+		            Snapshot           *snapshot);
+
+		/**
+		 * Create the config once every step has passed, removing properties
+		 * that are not in the schema from `obj` if `compact` is true.
+		 */
+		Config (*create)(ucl_object_t             *obj,
+		                 std::shared_ptr<Snapshot> snapshot,
+		                 bool                      compact);
+	};
+
+	/**
+	 * Returns an awaitable that reads the config file at `path` and creates a
+	 * config from it, validating it against `schema` and then with the steps
+	 * in `steps`.  This is used by the generated `make_config_async` and is
+	 * defined in `config-async.h`.
+	 */
+	template<typename Config, typename Executor, typename... Options>
+	auto async_make_config(const ucl_object_t     *schema,
+	                       ValidationSteps<Config> steps,
+	                       std::string             path,
+	                       Executor               &executor,
+	                       Options &&...options);
+
 } // namespace CONFIG_DETAIL_NAMESPACE
@@ -0,0 +1,456 @@
+// Copyright David Chisnall
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "config-generic.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace CONFIG_DETAIL_NAMESPACE
+{
+	/**
+	 * The CPUs in each NUMA node.
+	 */
+	class NumaTopology
+	{
+		/**
+		 * The CPUs in each node, indexed by node.
+		 */
+		std::vector<std::vector<int>> nodes;
+
+		public:
+		/**
+		 * Parse a Linux CPU list, such as `0-3,8`.  Returns the CPUs that
+		 * were parsed before any malformed entry.
+		 */
+		static std::vector<int> parse_cpu_list(std::string_view list)
+		{
+			std::vector<int> cpus;
+			while (!list.empty())
+			{
+				size_t           comma = list.find(',');
+				std::string_view range = list.substr(0, comma);
+				list = (comma == std::string_view::npos)
+				         ? std::string_view{}
+				         : list.substr(comma + 1);
+				while (!range.empty() && isspace(range.back()))
+				{
+					range.remove_suffix(1);
+				}
+				if (range.empty())
+				{
+					continue;
+				}
+				char       *end;
+				std::string text{range};
+				long        first = strtol(text.c_str(), &end, 10);
+				long        last  = first;
+				if (*end == '-')
+				{
+					last = strtol(end + 1, &end, 10);
+				}
+				if ((*end != '\0') || (first < 0) || (last < first))
+				{
+					break;
+				}
+				for (long cpu = first; cpu <= last; cpu++)
+				{
+					cpus.push_back(static_cast<int>(cpu));
+				}
+			}
+			return cpus;
+		}
+
+		/**
+		 * Construct a topology with the given CPUs in each node.
+		 */
+		NumaTopology(std::vector<std::vector<int>> cpus)
+		  : nodes(std::move(cpus))
+		{
+		}
+
+		/**
+		 * Construct a topology from a description in which the nodes'
+		 * CPU lists are separated by semicolons, for example `0-3;4-7`.
+		 */
+		NumaTopology(std::string_view description)
+		{
+			while (true)
+			{
+				size_t semicolon = description.find(';');
+				nodes.push_back(
+				  parse_cpu_list(description.substr(0, semicolon)));
+				if (semicolon == std::string_view::npos)
+				{
+					break;
+				}
+				description.remove_prefix(semicolon + 1);
+			}
+		}
+
+		/**
+		 * Returns the topology of this machine.  If the `CONFIG_NUMA_NODES`
+		 * environment variable is set then it is used as a description of
+		 * the topology instead, which allows a multi-node topology to be
+		 * emulated on a single node, for example by running a separate
+		 * process for each emulated node with `numactl --physcpubind`.
+		 */
+		static NumaTopology system()
+		{
+			if (const char *description = getenv("CONFIG_NUMA_NODES"))
+			{
+				return NumaTopology(std::string_view{description});
+			}
+			std::vector<std::vector<int>> cpus;
+			for (int node = 0;; node++)
+			{
+				std::ifstream file("/sys/devices/system/node/node" +
+				                   std::to_string(node) + "/cpulist");
+				std::string list;
+				if (!std::getline(file, list))
+				{
+					break;
+				}
+				cpus.push_back(parse_cpu_list(list));
+			}
+			if (cpus.empty())
+			{
+				cpus.emplace_back();
+			}
+			return NumaTopology(std::move(cpus));
+		}
+
+		/**
+		 * Returns the number of nodes.
+		 */
+		size_t size() const
+		{
+			return nodes.size();
+		}
+
+		/**
+		 * Returns the CPUs in `node`.
+		 */
+		const std::vector<int> &cpus(size_t node) const
+		{
+			return nodes.at(node);
+		}
+
+		/**
+		 * Returns the node that contains `cpu`, or node 0 if no node
+		 * contains it.
+		 */
+		size_t node_of(int cpu) const
+		{
+			for (size_t node = 0; node < nodes.size(); node++)
+			{
+				for (int c : nodes[node])
+				{
+					if (c == cpu)
+					{
+						return node;
+					}
+				}
+			}
+			return 0;
+		}
+
+		/**
+		 * Returns the node of the CPU that the calling thread is running on.
+		 */
+		size_t current_node() const
+		{
+			int cpu = sched_getcpu();
+			return cpu < 0 ? 0 : node_of(cpu);
+		}
+	};
+
+	/**
+	 * A config with a replica on each NUMA node.  Each replica is a deep copy
+	 * of the UCL document, with its own snapshot, that was created by a
+	 * thread bound to the CPUs of the node that it is for.  Memory is
+	 * allocated on the node that first touches it under the default Linux
+	 * policy, so each replica is local to the threads that read it.
+	 *
+	 * `publish` replaces all of the replicas at once.  `local` returns the
+	 * replica for the calling thread's node and caches it in a thread-local
+	 * entry for the instance, so the common case is an atomic load and a
+	 * search of a short per-thread list.  The node is looked up when a
+	 * thread first sees a new set of replicas, so threads that migrate
+	 * between nodes pick up their new local replica at the next reload.
+	 */
+	template<typename Config>
+	class NumaReplicas
+	{
+		/**
+		 * Function that creates a config from a validated UCL object,
+		 * usually the generated `make_config_unchecked`.  Each replica owns
+		 * its copy of the document, so it always asks for it to be
+		 * compacted.
+		 */
+		using MakeConfig =
+		  std::variant<Config, ucl_schema_error> (*)(ucl_object_t *, bool);
+
+		/**
+		 * One set of replicas.
+		 */
+		struct Replicas
+		{
+			/**
+			 * Identifies this set.  Unique across all instances.
+			 */
+			uint64_t generation;
+
+			/**
+			 * The replica for each node.
+			 */
+			std::vector<std::shared_ptr<const Config>> nodes;
+		};
+
+		/**
+		 * An entry in the thread-local cache used by `local`.  Each thread
+		 * has an entry for each instance that it has called `local` on.
+		 */
+		struct LocalReplica
+		{
+			/**
+			 * The identifier of the instance that this entry is for.
+			 */
+			uint64_t owner;
+
+			/**
+			 * Expires when the instance is destroyed, so that the entry can
+			 * be removed.
+			 */
+			std::weak_ptr<const void> alive;
+
+			/**
+			 * The set that `config` belongs to, which keeps it alive.
+			 */
+			std::shared_ptr<const Replicas> replicas{};
+
+			/**
+			 * The generation of `replicas`, or zero if there is none.
+			 */
+			uint64_t generation = 0;
+
+			/**
+			 * The replica for this thread's node.
+			 */
+			const Config *config = nullptr;
+		};
+
+		/**
+		 * Returns the source of generation numbers and instance identifiers.
+		 */
+		static std::atomic<uint64_t> &generations()
+		{
+			static std::atomic<uint64_t> next{1};
+			return next;
+		}
+
+		/**
+		 * The nodes to replicate on.
+		 */
+		NumaTopology topology;
+
+		/**
+		 * The function used to create each replica.
+		 */
+		MakeConfig makeConfig;
+
+		/**
+		 * Identifies this instance in thread-local caches.  Never reused.
+		 */
+		uint64_t id = generations()++;
+
+		/**
+		 * Shared with the thread-local cache entries for this instance, which
+		 * hold weak references to it, so that they can tell when it has been
+		 * destroyed.
+		 */
+		std::shared_ptr<const void> alive = std::make_shared<const char>();
+
+		/**
+		 * Serialises the updates to `current` and `currentGeneration`.
+		 */
+		std::mutex publishLock;
+
+		/**
+		 * The number of calls to `publish` that have started.
+		 */
+		std::atomic<uint64_t> publishCount{0};
+
+		/**
+		 * The value of `publishCount` when the call to `publish` that made
+		 * `current` started.  Protected by `publishLock`.
+		 */
+		uint64_t currentPublish = 0;
+
+		/**
+		 * The current set of replicas.
+		 */
+		std::atomic<std::shared_ptr<const Replicas>> current;
+
+		/**
+		 * The generation of `current`, or zero if nothing has been
+		 * published.  Stored after `current`, so a thread that sees a new
+		 * generation will load the new set.
+		 */
+		std::atomic<uint64_t> currentGeneration{0};
+
+		/**
+		 * Create the replica for `node` from `obj`, on the calling thread.
+		 */
+		std::shared_ptr<const Config> replicate(const ucl_object_t *obj,
+		                                        size_t              node)
+		{
+			auto &cpus = topology.cpus(node);
+			if (!cpus.empty())
+			{
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				for (int cpu : cpus)
+				{
+					if (cpu < CPU_SETSIZE)
+					{
+						CPU_SET(cpu, &set);
+					}
+				}
+				// If the process may not run on this node then the replica
+				// is still created, just not on the node.
+				pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			}
+			UCLPtr copy{ucl_object_copy(obj)};
+			// The `UCLPtr` holds its own reference.
+			ucl_object_unref(copy);
+			auto result = makeConfig(copy, true);
+			if (auto *config = std::get_if<Config>(&result))
+			{
+				return std::make_shared<const Config>(std::move(*config));
+			}
+			return nullptr;
+		}
+
+		public:
+		/**
+		 * Constructor.  Replicas are created with `factory`, which is called
+		 * with copies of documents that have already been validated and
+		 * asked to compact them.
+		 */
+		NumaReplicas(MakeConfig   factory,
+		             NumaTopology nodes = NumaTopology::system())
+		  : topology(std::move(nodes)), makeConfig(factory)
+		{
+		}
+
+		/**
+		 * Replace the replicas with copies of `obj`, which must be valid.
+		 * Returns false, and leaves the current replicas in place, if any
+		 * replica could not be created.  Concurrent calls may overlap: the
+		 * replicas from the call that started last are kept, and the others
+		 * are discarded once they are complete.
+		 */
+		bool publish(const ucl_object_t *obj)
+		{
+			uint64_t started  = ++publishCount;
+			auto     replicas = std::make_shared<Replicas>();
+			replicas->nodes.resize(topology.size());
+			std::vector<std::thread> threads;
+			for (size_t node = 0; node < topology.size(); node++)
+			{
+				threads.emplace_back([&, node]() {
+					replicas->nodes[node] = replicate(obj, node);
+				});
+			}
+			for (auto &thread : threads)
+			{
+				thread.join();
+			}
+			for (auto &replica : replicas->nodes)
+			{
+				if (replica == nullptr)
+				{
+					return false;
+				}
+			}
+			std::lock_guard guard(publishLock);
+			if (started < currentPublish)
+			{
+				// A call that started later has already published.
+				return true;
+			}
+			currentPublish       = started;
+			replicas->generation = generations()++;
+			current.store(replicas);
+			currentGeneration.store(replicas->generation);
+			return true;
+		}
+
+		/**
+		 * Returns the number of replicas.
+		 */
+		size_t size() const
+		{
+			return topology.size();
+		}
+
+		/**
+		 * Returns the replica for `node`, or null if nothing has been
+		 * published.
+		 */
+		std::shared_ptr<const Config> replica(size_t node) const
+		{
+			auto replicas = current.load();
+			return replicas ? replicas->nodes.at(node) : nullptr;
+		}
+
+		/**
+		 * Returns the replica for the calling thread's node, or null if
+		 * nothing has been published.  The pointer remains valid until this
+		 * thread calls `local` on this instance after the replicas have been
+		 * replaced, until this instance is destroyed, or until the thread
+		 * exits.
+		 */
+		const Config *local() const
+		{
+			thread_local std::vector<LocalReplica> cache;
+			uint64_t generation = currentGeneration.load();
+			if (generation == 0)
+			{
+				return nullptr;
+			}
+			auto entry = std::ranges::find(cache, id, &LocalReplica::owner);
+			if (entry == cache.end())
+			{
+				// Drop the entries for instances that have been destroyed
+				// before adding one for this instance.
+				std::erase_if(
+				  cache, [](auto &stale) { return stale.alive.expired(); });
+				entry = cache.insert(cache.end(), LocalReplica{id, alive});
+			}
+			if (entry->generation != generation)
+			{
+				entry->replicas   = current.load();
+				entry->generation = entry->replicas->generation;
+				entry->config =
+				  entry->replicas->nodes[topology.current_node()].get();
+			}
+			return entry->config;
+		}
+	};
+
+} // namespace CONFIG_DETAIL_NAMESPACE
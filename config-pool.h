@@ -0,0 +1,502 @@
+// Copyright David Chisnall
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "config-generic.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace CONFIG_DETAIL_NAMESPACE
+{
+	/**
+	 * A pool of configs for many tenants that share a schema, stored by
+	 * column.  `Config` must be generated with `config-gen --materialize`,
+	 * which gives it a `Columns` template with an array for each
+	 * materialized field and a `View` with the same accessors as `Config`.
+	 * Tenants are identified by small integers, allocated by the caller, and
+	 * `get` is three array lookups that return a `View`.
+	 *
+	 * The values of a field for consecutive tenants are adjacent in memory,
+	 * and strings are interned, so tenants that share a string store it
+	 * once.  Interned strings are kept until the number of strings is twice
+	 * the number that are in use, or the number of tenants, when they are
+	 * copied into a new arena.
+	 *
+	 * The document and snapshot of each tenant are only kept if an accessor
+	 * needs them.  Tenants whose configs are equal, as found by the
+	 * generated `hash` and `operator==`, share one document and snapshot.
+	 * Sharing is by whole config: accessors reach nested objects through
+	 * their tenant's document, so tenants whose configs differ keep separate
+	 * copies of any nested objects that are the same.
+	 *
+	 * The tenant table is a list of directories, each of which holds a fixed
+	 * number of small chunks of columns.  Directories and chunks are copied
+	 * on write, so an update copies the list of directories and, for each
+	 * tenant that it changes, at most one directory and one chunk.  Updates
+	 * are serialised.  Each update
+	 * validates its documents and builds a new, immutable version of the
+	 * table before publishing it atomically, so readers never wait for an
+	 * update and never see part of one.  Publishing and loading the table
+	 * uses `std::atomic<std::shared_ptr>`, which takes a short internal
+	 * lock in some standard libraries, including libstdc++.
+	 */
+	template<typename Config>
+	class ConfigPool
+	{
+		static_assert(
+		  requires { typename Config::template Columns<1>; },
+		  "ConfigPool requires a class generated with --materialize");
+
+		public:
+		/**
+		 * Identifies a tenant.
+		 */
+		using TenantId = uint32_t;
+
+		/**
+		 * Function that creates a config from a UCL object, usually the
+		 * generated `make_config`.
+		 */
+		using MakeConfig =
+		  std::variant<Config, ucl_schema_error> (*)(ucl_object_t *, bool);
+
+		/**
+		 * A change to the config of one tenant.  If `document` is null then
+		 * the tenant is removed.
+		 */
+		struct Update
+		{
+			/**
+			 * The tenant to change.
+			 */
+			TenantId tenant;
+
+			/**
+			 * The new document for the tenant, or null to remove it.
+			 */
+			ucl_object_t *document;
+		};
+
+		/**
+		 * A change that was rejected because its document is not valid.
+		 */
+		struct Rejected
+		{
+			/**
+			 * The tenant whose document is not valid.
+			 */
+			TenantId tenant;
+
+			/**
+			 * The reason that the document is not valid.
+			 */
+			ucl_schema_error error;
+		};
+
+		/**
+		 * The number of tenants in each chunk of the tenant table.  Small, to
+		 * bound the copy made when a tenant in a chunk changes.
+		 */
+		static constexpr size_t ChunkSize = 64;
+
+		/**
+		 * The number of chunks in each directory of the tenant table.
+		 */
+		static constexpr size_t DirectorySize = 64;
+
+		/**
+		 * A chunk of the tenant table, with an array for each field.
+		 */
+		using Chunk = typename Config::template Columns<ChunkSize>;
+
+		/**
+		 * The config of one tenant, which has the same accessors as
+		 * `Config`.  A view keeps its chunk alive, so it remains valid even
+		 * if the tenant is updated.
+		 */
+		using View = typename Config::template View<ChunkSize>;
+
+		private:
+		/**
+		 * Set if the columns keep the document and snapshot of each tenant.
+		 */
+		static constexpr bool KeepsDocuments =
+		  requires(Chunk &chunk) { chunk.obj; };
+
+		/**
+		 * A group of chunks, which may be shared with other versions of the
+		 * table.  A null chunk has no tenants.
+		 */
+		using Directory =
+		  std::array<std::shared_ptr<const Chunk>, DirectorySize>;
+
+		/**
+		 * One version of the tenant table.
+		 */
+		struct Table
+		{
+			/**
+			 * The directories, which may be shared with other versions.  A
+			 * null directory has no tenants.
+			 */
+			std::vector<std::shared_ptr<const Directory>> directories;
+
+			/**
+			 * The number of tenants that have a config.
+			 */
+			size_t tenants = 0;
+		};
+
+		/**
+		 * A config whose document and snapshot are shared by the rows that
+		 * hold equal configs.
+		 */
+		struct SharedConfig
+		{
+			/**
+			 * The config, which holds the document and snapshot.
+			 */
+			Config config;
+
+			/**
+			 * The hash of `config`.
+			 */
+			uint64_t hash;
+
+			/**
+			 * The number of rows, in the current table, that refer to it.
+			 */
+			size_t rows;
+		};
+
+		/**
+		 * The function used to create configs.
+		 */
+		MakeConfig makeConfig;
+
+		/**
+		 * The current version of the table.
+		 */
+		std::atomic<std::shared_ptr<const Table>> current{
+		  std::make_shared<const Table>()};
+
+		/**
+		 * Serialises updates and protects `strings` and `rebuildAt`.
+		 */
+		std::mutex updateLock;
+
+		/**
+		 * The arena that new strings are interned in.  Chunks share it, and
+		 * it is only modified while holding `updateLock`.
+		 */
+		std::shared_ptr<StringArena> strings = std::make_shared<StringArena>();
+
+		/**
+		 * The number of strings in `strings` at which the strings that are
+		 * in use are copied into a new arena.
+		 */
+		size_t rebuildAt = 64;
+
+		/**
+		 * The configs whose documents are referred to by the current table.
+		 * Only modified while holding `updateLock`.
+		 */
+		std::list<SharedConfig> shared;
+
+		/**
+		 * Index of `shared` by hash.
+		 */
+		std::unordered_multimap<uint64_t,
+		                        typename std::list<SharedConfig>::iterator>
+		  sharedByHash;
+
+		/**
+		 * Index of `shared` by document, used to find the entry for a row
+		 * that is cleared.
+		 */
+		std::unordered_map<const ucl_object_t *,
+		                   typename std::list<SharedConfig>::iterator>
+		  sharedByDocument;
+
+		/**
+		 * Returns the shared config, equal to `config`, whose document a new
+		 * row should refer to, and counts the row.  Must be called with
+		 * `updateLock` held.
+		 */
+		typename std::list<SharedConfig>::iterator share(Config &&config)
+		{
+			uint64_t hash     = config.hash();
+			auto [begin, end] = sharedByHash.equal_range(hash);
+			for (auto i = begin; i != end; ++i)
+			{
+				if (i->second->config == config)
+				{
+					i->second->rows++;
+					return i->second;
+				}
+			}
+			shared.push_front({std::move(config), hash, 1});
+			sharedByHash.emplace(hash, shared.begin());
+			return shared.begin();
+		}
+
+		/**
+		 * Release the document `obj` of a row that is cleared, dropping the
+		 * shared config once no row refers to it.  Must be called with
+		 * `updateLock` held.
+		 */
+		void release(const ucl_object_t *obj)
+		{
+			auto entry = sharedByDocument.find(obj);
+			if ((entry == sharedByDocument.end()) ||
+			    (--entry->second->rows > 0))
+			{
+				return;
+			}
+			auto position     = entry->second;
+			auto [begin, end] = sharedByHash.equal_range(position->hash);
+			for (auto i = begin; i != end; ++i)
+			{
+				if (i->second == position)
+				{
+					sharedByHash.erase(i);
+					break;
+				}
+			}
+			sharedByDocument.erase(entry);
+			shared.erase(position);
+		}
+
+		/**
+		 * Copy every chunk of `table`, and the strings that it uses, into a
+		 * new arena, so that strings that are no longer used are freed when
+		 * the readers of older versions have finished with them.  Must be
+		 * called with `updateLock` held.
+		 */
+		void rebuild_strings(Table &table)
+		{
+			strings = std::make_shared<StringArena>();
+			for (auto &directory : table.directories)
+			{
+				if (directory == nullptr)
+				{
+					continue;
+				}
+				auto copy = std::make_shared<Directory>(*directory);
+				for (auto &chunk : *copy)
+				{
+					if (chunk != nullptr)
+					{
+						auto columns = std::make_shared<Chunk>(*chunk);
+						columns->intern_strings(strings);
+						chunk = std::move(columns);
+					}
+				}
+				directory = std::move(copy);
+			}
+			size_t live = std::max(strings->size(), table.tenants);
+			rebuildAt   = std::max<size_t>(64, 2 * live);
+		}
+
+		public:
+		/**
+		 * Constructor.  Configs are created with `factory`, which is called
+		 * with each document that is added to the pool.
+		 */
+		ConfigPool(MakeConfig factory) : makeConfig(factory) {}
+
+		/**
+		 * Returns the config for `tenant`, or nothing if it does not have
+		 * one.
+		 */
+		std::optional<View> get(TenantId tenant) const
+		{
+			auto   table     = current.load();
+			size_t directory = tenant / (ChunkSize * DirectorySize);
+			size_t row       = tenant % ChunkSize;
+			if ((directory >= table->directories.size()) ||
+			    (table->directories[directory] == nullptr))
+			{
+				return std::nullopt;
+			}
+			auto &chunk =
+			  (*table->directories[directory])[tenant / ChunkSize %
+			                                   DirectorySize];
+			if ((chunk == nullptr) || !chunk->present[row])
+			{
+				return std::nullopt;
+			}
+			return View(chunk, row);
+		}
+
+		/**
+		 * Apply `updates` as a single change.  Documents are validated by
+		 * the factory and the ones that are not valid are skipped and
+		 * returned, the rest are published together.  If a tenant appears
+		 * more than once then the last valid update for it wins.
+		 */
+		std::vector<Rejected> update(std::span<const Update> updates)
+		{
+			std::vector<Rejected> rejected;
+			std::lock_guard       guard(updateLock);
+			auto table = std::make_shared<Table>(*current.load());
+			// Directories and chunks that have been copied by this update,
+			// which can be modified in place.
+			std::unordered_map<size_t, std::shared_ptr<Directory>> directories;
+			std::unordered_map<size_t, std::shared_ptr<Chunk>>     chunks;
+			auto writable = [&](TenantId tenant) -> Chunk & {
+				size_t index = tenant / ChunkSize;
+				if (auto chunk = chunks.find(index); chunk != chunks.end())
+				{
+					return *chunk->second;
+				}
+				size_t outer = index / DirectorySize;
+				if (outer >= table->directories.size())
+				{
+					table->directories.resize(outer + 1);
+				}
+				auto &directory = directories[outer];
+				if (directory == nullptr)
+				{
+					auto &old = table->directories[outer];
+					directory = old ? std::make_shared<Directory>(*old)
+					                : std::make_shared<Directory>();
+					old       = directory;
+				}
+				auto &slot = (*directory)[index % DirectorySize];
+				auto  copy = slot ? std::make_shared<Chunk>(*slot)
+				                  : std::make_shared<Chunk>();
+				copy->strings = strings;
+				slot          = copy;
+				return *chunks.emplace(index, std::move(copy)).first->second;
+			};
+			auto has_chunk = [&](TenantId tenant) {
+				size_t index = tenant / ChunkSize;
+				size_t outer = index / DirectorySize;
+				return (outer < table->directories.size()) &&
+				       (table->directories[outer] != nullptr) &&
+				       ((*table->directories[outer])[index % DirectorySize] !=
+				        nullptr);
+			};
+			for (auto &update : updates)
+			{
+				std::optional<Config> config;
+				if (update.document != nullptr)
+				{
+					auto result = makeConfig(update.document, false);
+					if (auto *error = std::get_if<ucl_schema_error>(&result))
+					{
+						rejected.push_back({update.tenant, *error});
+						continue;
+					}
+					config.emplace(std::get<Config>(std::move(result)));
+				}
+				else if (!has_chunk(update.tenant))
+				{
+					// Removing a tenant from a chunk that has no tenants.
+					continue;
+				}
+				auto  &chunk = writable(update.tenant);
+				size_t row   = update.tenant % ChunkSize;
+				if constexpr (KeepsDocuments)
+				{
+					// Share before releasing, so that storing an equal config
+					// does not drop the shared one.
+					std::optional<typename std::list<SharedConfig>::iterator>
+					  position;
+					if (config)
+					{
+						position = share(std::move(*config));
+					}
+					if (chunk.present[row])
+					{
+						table->tenants--;
+						release(chunk.obj[row]);
+						chunk.clear(row);
+					}
+					if (position)
+					{
+						table->tenants++;
+						chunk.store(row, (*position)->config, *strings);
+						sharedByDocument.try_emplace(chunk.obj[row], *position);
+					}
+				}
+				else
+				{
+					if (chunk.present[row])
+					{
+						table->tenants--;
+						chunk.clear(row);
+					}
+					if (config)
+					{
+						table->tenants++;
+						chunk.store(row, *config, *strings);
+					}
+				}
+			}
+			if (strings->size() >= rebuildAt)
+			{
+				rebuild_strings(*table);
+			}
+			current.store(std::move(table));
+			return rejected;
+		}
+
+		/**
+		 * Replace the config for `tenant` with one created from `document`.
+		 * Returns the error, and leaves the current config in place, if the
+		 * document is not valid.
+		 */
+		std::optional<ucl_schema_error> set(TenantId      tenant,
+		                                    ucl_object_t *document)
+		{
+			Update change{tenant, document};
+			auto   rejected = update({&change, 1});
+			if (!rejected.empty())
+			{
+				return rejected.front().error;
+			}
+			return std::nullopt;
+		}
+
+		/**
+		 * Remove the config for `tenant`.
+		 */
+		void erase(TenantId tenant)
+		{
+			Update change{tenant, nullptr};
+			update({&change, 1});
+		}
+
+		/**
+		 * Returns the number of tenants that have a config.
+		 */
+		size_t size() const
+		{
+			return current.load()->tenants;
+		}
+
+		/**
+		 * Returns the number of distinct strings in the current arena,
+		 * including any that are no longer used.
+		 */
+		size_t interned_strings()
+		{
+			std::lock_guard guard(updateLock);
+			return strings->size();
+		}
+	};
+
+} // namespace CONFIG_DETAIL_NAMESPACE
@@ -0,0 +1,611 @@
+// Copyright David Chisnall
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "config-generic.h"
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace CONFIG_DETAIL_NAMESPACE
+{
+	/**
+	 * Returns true if `tenant` can be used as a file name without naming a
+	 * file outside of the directory that it is looked up in.
+	 */
+	inline bool is_safe_tenant_name(std::string_view tenant)
+	{
+		return !tenant.empty() && (tenant[0] != '.') &&
+		       (tenant.find_first_of(std::string_view("/\0", 2)) ==
+		        std::string_view::npos);
+	}
+
+	/**
+	 * Reads the whole of the file at `path`.  Returns nothing if it cannot
+	 * be opened.
+	 */
+	inline std::optional<std::string> read_file(const std::string &path)
+	{
+		FILE *f = fopen(path.c_str(), "r");
+		if (f == nullptr)
+		{
+			return std::nullopt;
+		}
+		std::string text;
+		char        buffer[4096];
+		size_t      length;
+		while ((length = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		{
+			text.append(buffer, length);
+		}
+		fclose(f);
+		return text;
+	}
+
+	/**
+	 * Source of tenant documents that reads each tenant's document from a
+	 * file called `<tenant><suffix>` in a directory.
+	 */
+	class DirectorySource
+	{
+		/**
+		 * The directory that holds the documents.
+		 */
+		std::string directory;
+
+		/**
+		 * The suffix of the file names.
+		 */
+		std::string suffix;
+
+		public:
+		/**
+		 * Constructor.
+		 */
+		DirectorySource(std::string dir, std::string fileSuffix = ".conf")
+		  : directory(std::move(dir)), suffix(std::move(fileSuffix))
+		{
+		}
+
+		/**
+		 * Returns the document for `tenant`, or nothing if there is none.
+		 */
+		std::optional<std::string> operator()(const std::string &tenant) const
+		{
+			if (!is_safe_tenant_name(tenant))
+			{
+				return std::nullopt;
+			}
+			return read_file(directory + '/' + tenant + suffix);
+		}
+	};
+
+	/**
+	 * Source of tenant documents that reads them from a single file with one
+	 * line per tenant: the tenant's name, a tab, and its document, which
+	 * must not contain a newline.  The file is scanned once, when this is
+	 * constructed, and only the position of each document is kept in memory.
+	 * Documents are read with `pread` when they are requested, so the file
+	 * must not be modified while this is in use.
+	 */
+	class KeyValueFileSource
+	{
+		/**
+		 * The position of a document in the file.
+		 */
+		struct Extent
+		{
+			/**
+			 * The offset of the first byte of the document.
+			 */
+			off_t offset;
+
+			/**
+			 * The length of the document.
+			 */
+			size_t length;
+		};
+
+		/**
+		 * An open file, closed when it is destroyed.
+		 */
+		struct Descriptor
+		{
+			/**
+			 * The file descriptor, or -1 if the file could not be opened.
+			 */
+			int fd;
+
+			/**
+			 * Destructor, closes the file.
+			 */
+			~Descriptor()
+			{
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+			}
+		};
+
+		/**
+		 * The file, shared by copies.
+		 */
+		std::shared_ptr<const Descriptor> file;
+
+		/**
+		 * The position of each tenant's document, shared by copies.
+		 */
+		std::shared_ptr<const std::unordered_map<std::string, Extent>> extents;
+
+		public:
+		/**
+		 * Open and index the file at `path`.  If the file cannot be opened
+		 * then there are no tenants.  Lines without a tab are ignored and if
+		 * a tenant has more than one line then the last is used.
+		 */
+		KeyValueFileSource(const std::string &path)
+		  : file(std::make_shared<const Descriptor>(
+		      open(path.c_str(), O_RDONLY | O_CLOEXEC)))
+		{
+			auto index =
+			  std::make_shared<std::unordered_map<std::string, Extent>>();
+			extents = index;
+			std::string name;
+			bool        inName   = true;
+			off_t       docStart = 0;
+			off_t       offset   = 0;
+			char        buffer[65536];
+			ssize_t     length;
+			while ((file->fd >= 0) &&
+			       ((length = pread(file->fd, buffer, sizeof(buffer), offset)) >
+			        0))
+			{
+				for (ssize_t i = 0; i < length; i++)
+				{
+					off_t position = offset + i;
+					if (buffer[i] == '\n')
+					{
+						if (!inName)
+						{
+							size_t docLength = position - docStart;
+							(*index)[name]   = {docStart, docLength};
+						}
+						name.clear();
+						inName = true;
+					}
+					else if (inName && (buffer[i] == '\t'))
+					{
+						inName   = false;
+						docStart = position + 1;
+					}
+					else if (inName)
+					{
+						name += buffer[i];
+					}
+				}
+				offset += length;
+			}
+			if (!inName)
+			{
+				size_t docLength = offset - docStart;
+				(*index)[name]   = {docStart, docLength};
+			}
+		}
+
+		/**
+		 * Returns the document for `tenant`, or nothing if there is none.
+		 */
+		std::optional<std::string> operator()(const std::string &tenant) const
+		{
+			auto extent = extents->find(tenant);
+			if (extent == extents->end())
+			{
+				return std::nullopt;
+			}
+			std::string text(extent->second.length, '\0');
+			size_t      done = 0;
+			while (done < text.size())
+			{
+				ssize_t length = pread(file->fd,
+				                       text.data() + done,
+				                       text.size() - done,
+				                       extent->second.offset + done);
+				if (length <= 0)
+				{
+					return std::nullopt;
+				}
+				done += length;
+			}
+			return text;
+		}
+	};
+
+	/**
+	 * Cache of the configs of many tenants that share a schema, for when
+	 * they do not all fit in memory.  A tenant's document is read from a
+	 * source, such as a `DirectorySource`, parsed, validated, and
+	 * materialized when it is first requested.
+	 *
+	 * The cache is split into shards, each with its own lock and a share of
+	 * the memory budget, so lookups for different tenants rarely contend.
+	 * Each shard keeps its configs in least-recently-used order and evicts
+	 * the coldest when the bytes reported by the generated `bytes` methods,
+	 * plus the memory allocated for the shard's own list, index, and tenant
+	 * names, exceed its budget.  Both are measured from the allocator, except
+	 * for the parts that `ucl_object_bytes` and `Snapshot::bytes` describe as
+	 * reported by their owners.  Evicted configs remain valid for as long as
+	 * a caller holds them.
+	 *
+	 * Loading happens without holding the shard's lock.  If two threads miss
+	 * on the same tenant at once then both load it and the first to finish
+	 * is cached.  Each shard has a generation that `invalidate` increments,
+	 * and a config is only cached if the generation has not changed since
+	 * its load started, so a load that raced with an invalidation cannot
+	 * cache the old document.
+	 */
+	template<typename Config>
+	class TenantCache
+	{
+		public:
+		/**
+		 * Function that creates a config from a parsed UCL object, usually
+		 * the generated `make_config`.  The cache owns the objects that it
+		 * parses, so it always asks for them to be compacted.
+		 */
+		using Loader = std::function<std::variant<Config, ucl_schema_error>(
+		  ucl_object_t *obj,
+		  bool          compact)>;
+
+		/**
+		 * Function that returns the document for a tenant, or nothing if the
+		 * tenant does not exist.
+		 */
+		using Source =
+		  std::function<std::optional<std::string>(const std::string &)>;
+
+		/**
+		 * Counters describing the behaviour of the cache.
+		 */
+		struct Statistics
+		{
+			/**
+			 * The number of lookups that found a cached config.
+			 */
+			uint64_t hits;
+
+			/**
+			 * The number of lookups that had to load a config.
+			 */
+			uint64_t misses;
+
+			/**
+			 * The number of configs that were evicted to stay within the
+			 * budget.
+			 */
+			uint64_t evictions;
+
+			/**
+			 * The number of loads that failed because the tenant does not
+			 * exist or its document is not valid.
+			 */
+			uint64_t failures;
+
+			/**
+			 * The number of configs that are cached.
+			 */
+			size_t entries;
+
+			/**
+			 * The number of bytes used by the cached configs and by the
+			 * cache's containers.
+			 */
+			size_t bytes;
+		};
+
+		private:
+		/**
+		 * A tenant name, allocated by the shard's allocator.
+		 */
+		using Name = std::basic_string<char,
+		                               std::char_traits<char>,
+		                               CountingAllocator<char>>;
+
+		/**
+		 * A cached config.
+		 */
+		struct Entry
+		{
+			/**
+			 * The tenant that this config is for.
+			 */
+			Name tenant;
+
+			/**
+			 * The config.
+			 */
+			std::shared_ptr<const Config> config;
+
+			/**
+			 * The bytes reported by the config, charged to the shard.
+			 */
+			size_t bytes;
+		};
+
+		/**
+		 * A shard of the cache.
+		 */
+		struct Shard
+		{
+			/**
+			 * Protects the other fields.
+			 */
+			std::mutex lock;
+
+			/**
+			 * The number of bytes allocated for `entries`, `index`, and the
+			 * names in the entries.  Declared before them, so that it
+			 * outlives them.
+			 */
+			std::atomic<size_t> allocated{0};
+
+			/**
+			 * List of entries, allocated by the shard's allocator.
+			 */
+			using List = std::list<Entry, CountingAllocator<Entry>>;
+
+			/**
+			 * The cached configs, most recently used first.
+			 */
+			List entries{&allocated};
+
+			/**
+			 * Index of `entries` by tenant.  The keys are views of the names
+			 * in the entries.
+			 */
+			std::unordered_map<
+			  std::string_view,
+			  typename List::iterator,
+			  std::hash<std::string_view>,
+			  std::equal_to<std::string_view>,
+			  CountingAllocator<
+			    std::pair<const std::string_view, typename List::iterator>>>
+			  index{&allocated};
+
+			/**
+			 * The total of the bytes of the entries.
+			 */
+			size_t bytes = 0;
+
+			/**
+			 * Returns the bytes charged to this shard: those of the entries
+			 * and those allocated for the shard's containers.
+			 */
+			size_t total() const
+			{
+				return bytes + allocated.load(std::memory_order_relaxed);
+			}
+
+			/**
+			 * Incremented by `invalidate`.  Loads that started in an earlier
+			 * generation are not cached.
+			 */
+			uint64_t generation = 0;
+		};
+
+		/**
+		 * The source of documents.
+		 */
+		Source source;
+
+		/**
+		 * The function used to create configs.
+		 */
+		Loader load;
+
+		/**
+		 * The shards.
+		 */
+		std::vector<Shard> shards;
+
+		/**
+		 * The budget for each shard.
+		 */
+		size_t shardBudget;
+
+		/**
+		 * Counters for `statistics`.
+		 */
+		std::atomic<uint64_t> hits{0}, misses{0}, evictions{0}, failures{0};
+
+		/**
+		 * Returns the shard that holds `tenant`.
+		 */
+		Shard &shard_for(const std::string &tenant)
+		{
+			return shards[std::hash<std::string>()(tenant) % shards.size()];
+		}
+
+		/**
+		 * Read, parse, and validate the document for `tenant`.  On failure,
+		 * returns null and sets `error`.
+		 */
+		std::shared_ptr<const Config> load_tenant(const std::string &tenant,
+		                                          std::string       &error)
+		{
+			auto text = source(tenant);
+			if (!text)
+			{
+				error = "no config for tenant " + tenant;
+				return nullptr;
+			}
+			auto *p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+			ucl_parser_add_chunk(p,
+			                     reinterpret_cast<const unsigned char *>(
+			                       text->data()),
+			                     text->size());
+			std::shared_ptr<const Config> config;
+			if (const char *parseError = ucl_parser_get_error(p))
+			{
+				error = parseError;
+			}
+			else
+			{
+				UCLPtr obj{ucl_parser_get_object(p)};
+				// The `UCLPtr` holds its own reference.
+				ucl_object_unref(obj);
+				auto result = load(obj, true);
+				if (auto *err = std::get_if<ucl_schema_error>(&result))
+				{
+					error = err->msg;
+				}
+				else
+				{
+					config = std::make_shared<const Config>(
+					  std::move(std::get<Config>(result)));
+				}
+			}
+			ucl_parser_free(p);
+			return config;
+		}
+
+		public:
+		/**
+		 * Constructor.  Documents are read from `documents` and validated
+		 * with `loader`.  The cached configs use at most `budget` bytes,
+		 * divided evenly between `shardCount` shards.
+		 */
+		TenantCache(Source documents,
+		            Loader loader,
+		            size_t budget,
+		            size_t shardCount = 16)
+		  : source(std::move(documents)),
+		    load(std::move(loader)),
+		    shards(std::max<size_t>(shardCount, 1)),
+		    shardBudget(budget / shards.size())
+		{
+		}
+
+		/**
+		 * Returns the config for `tenant`, loading it if it is not cached.
+		 * Returns null, and sets `error` if it is not null, if the tenant
+		 * does not exist or its document is not valid.  Failures are not
+		 * cached.  A config that was loaded while its shard was invalidated
+		 * is returned but not cached.
+		 */
+		std::shared_ptr<const Config> get(const std::string &tenant,
+		                                  std::string       *error = nullptr)
+		{
+			Shard   &shard = shard_for(tenant);
+			uint64_t generation;
+			{
+				std::lock_guard guard(shard.lock);
+				auto            entry = shard.index.find(tenant);
+				if (entry != shard.index.end())
+				{
+					shard.entries.splice(
+					  shard.entries.begin(), shard.entries, entry->second);
+					hits++;
+					return entry->second->config;
+				}
+				generation = shard.generation;
+			}
+			misses++;
+			std::string message;
+			auto        config = load_tenant(tenant, message);
+			if (config == nullptr)
+			{
+				failures++;
+				if (error != nullptr)
+				{
+					*error = std::move(message);
+				}
+				return nullptr;
+			}
+			// The list and index nodes and the name are measured by the
+			// shard's allocator when the entry is inserted.
+			size_t bytes = config->bytes();
+			if (bytes > shardBudget)
+			{
+				return config;
+			}
+			std::lock_guard guard(shard.lock);
+			if (shard.generation != generation)
+			{
+				// The document may have changed since it was read.
+				return config;
+			}
+			auto entry = shard.index.find(tenant);
+			if (entry != shard.index.end())
+			{
+				return entry->second->config;
+			}
+			shard.entries.push_front(
+			  {Name(tenant.data(),
+			        tenant.size(),
+			        CountingAllocator<char>(&shard.allocated)),
+			   config,
+			   bytes});
+			shard.index.emplace(shard.entries.front().tenant,
+			                    shard.entries.begin());
+			shard.bytes += bytes;
+			// The index's buckets are counted even when it is empty.
+			while (!shard.entries.empty() && (shard.total() > shardBudget))
+			{
+				auto &coldest = shard.entries.back();
+				shard.bytes -= coldest.bytes;
+				shard.index.erase(coldest.tenant);
+				shard.entries.pop_back();
+				evictions++;
+			}
+			return config;
+		}
+
+		/**
+		 * Drop the cached config for `tenant`, if there is one, so that the
+		 * next lookup loads it again.  Loads from the same shard that are in
+		 * progress will not be cached.
+		 */
+		void invalidate(const std::string &tenant)
+		{
+			Shard          &shard = shard_for(tenant);
+			std::lock_guard guard(shard.lock);
+			shard.generation++;
+			auto entry = shard.index.find(tenant);
+			if (entry != shard.index.end())
+			{
+				auto position = entry->second;
+				shard.bytes -= position->bytes;
+				shard.index.erase(entry);
+				shard.entries.erase(position);
+			}
+		}
+
+		/**
+		 * Returns the counters and the current size of the cache.
+		 */
+		Statistics statistics()
+		{
+			Statistics result{hits, misses, evictions, failures, 0, 0};
+			for (auto &shard : shards)
+			{
+				std::lock_guard guard(shard.lock);
+				result.entries += shard.entries.size();
+				result.bytes += shard.total();
+			}
+			return result;
+		}
+	};
+
+} // namespace CONFIG_DETAIL_NAMESPACE
@@ -0,0 +1,700 @@
+// Copyright David Chisnall
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "config-generic.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace CONFIG_DETAIL_NAMESPACE
+{
+	/**
+	 * Returns the canonical absolute path of `path`, as libucl computes it for
+	 * `$CURDIR` and `$FILENAME`, or an empty string if it does not exist.
+	 */
+	inline std::string real_path(const std::string &path)
+	{
+		std::string result;
+		if (char *resolved = realpath(path.c_str(), nullptr))
+		{
+			result = resolved;
+			free(resolved);
+		}
+		return result;
+	}
+
+	/**
+	 * Expands the variables that libucl defines for each file in the path of
+	 * an `.include` directive: `$CURDIR` is the directory of the including
+	 * file `file`, which must be a canonical path, and `$FILENAME` is `file`
+	 * itself.  Both may also be written as `${NAME}`, and `$$` is a `$`.
+	 * Other variables are left as they are.
+	 */
+	inline std::string expand_file_variables(std::string_view path,
+	                                         const std::string &file)
+	{
+		size_t           slash     = file.rfind('/');
+		std::string      directory = file.substr(0, slash == 0 ? 1 : slash);
+		std::string_view names[]   = {"CURDIR", "FILENAME"};
+		std::string_view values[]  = {directory, file};
+		std::string      result;
+		for (size_t i = 0; i < path.size(); i++)
+		{
+			if ((path[i] != '$') || (i + 1 == path.size()))
+			{
+				result += path[i];
+				continue;
+			}
+			if (path[i + 1] == '$')
+			{
+				result += '$';
+				i++;
+				continue;
+			}
+			bool braced   = path[i + 1] == '{';
+			bool expanded = false;
+			for (size_t n = 0; n < 2; n++)
+			{
+				std::string_view rest = path.substr(i + 1 + braced);
+				if (rest.starts_with(names[n]) &&
+				    (!braced || rest.substr(names[n].size()).starts_with('}')))
+				{
+					result += values[n];
+					i += names[n].size() + 2 * braced;
+					expanded = true;
+					break;
+				}
+			}
+			if (!expanded)
+			{
+				result += '$';
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * Returns the files named by `.include` directives in the UCL document
+	 * `text`, read from the canonical path `file`.  As in libucl, `$CURDIR`
+	 * and `$FILENAME` refer to `file`, and relative paths are resolved
+	 * against the working directory.  This is a textual scan: it finds the
+	 * directives that libucl would expand but does not interpret their
+	 * options or expand other variables.
+	 */
+	inline std::vector<std::string> included_files(std::string_view   text,
+	                                               const std::string &file)
+	{
+		std::vector<std::string> files;
+		std::string_view         directive = ".include";
+		std::string              workingDirectory;
+		for (size_t pos = text.find(directive); pos != std::string_view::npos;
+		     pos        = text.find(directive, pos))
+		{
+			pos += directive.size();
+			// Skip the optional parameters, for example `(priority=1)`.
+			size_t quote = text.find_first_not_of(" \t", pos);
+			if ((quote != std::string_view::npos) && (text[quote] == '('))
+			{
+				quote = text.find(')', quote);
+				if (quote == std::string_view::npos)
+				{
+					break;
+				}
+				quote = text.find_first_not_of(" \t", quote + 1);
+			}
+			if ((quote == std::string_view::npos) || (text[quote] != '"'))
+			{
+				continue;
+			}
+			size_t end = text.find('"', quote + 1);
+			if (end == std::string_view::npos)
+			{
+				break;
+			}
+			std::string path = expand_file_variables(
+			  text.substr(quote + 1, end - quote - 1), file);
+			if (!path.empty() && (path[0] != '/'))
+			{
+				if (workingDirectory.empty())
+				{
+					workingDirectory = real_path(".");
+				}
+				path.insert(0, "/");
+				path.insert(0, workingDirectory);
+			}
+			files.push_back(std::move(path));
+			pos = end;
+		}
+		return files;
+	}
+
+	/**
+	 * Watches a config file, and any files that it includes directly or
+	 * through other included files, and reloads the config when they
+	 * change.  Changes are detected with inotify on the directories that
+	 * contain the files, so editors that save by writing a new file and
+	 * renaming it over the old one are handled.  Bursts of changes are
+	 * coalesced: the config is reloaded once the files have been quiet for
+	 * the debounce interval.
+	 *
+	 * Parsing and validation run on a background thread.  A config that
+	 * passes validation is published atomically and then passed to each
+	 * subscriber, on the background thread, unless it is equal to the current
+	 * config.  A config that fails to parse or
+	 * validate is discarded, the previous config remains current, and the
+	 * error is available from `last_error`.
+	 *
+	 * `current` never blocks and the returned pointer remains valid for as
+	 * long as the caller holds it, even if a newer config is published.
+	 */
+	template<typename Config>
+	class ConfigWatcher
+	{
+		public:
+		/**
+		 * Function that creates a config from a parsed UCL object, usually
+		 * the generated `make_config`.  The watcher owns the objects that it
+		 * parses and nothing else can reach the properties that are not in
+		 * the schema, so it always asks for them to be compacted.
+		 */
+		using Loader = std::function<std::variant<Config, ucl_schema_error>(
+		  ucl_object_t *obj,
+		  bool          compact)>;
+
+		/**
+		 * Function that is called with each new config.
+		 */
+		using Subscriber =
+		  std::function<void(const std::shared_ptr<const Config> &)>;
+
+		/**
+		 * Function that is called with the document for each new config,
+		 * after it has been validated and compacted, so that copies can be
+		 * made, for example with `NumaReplicas::publish`.
+		 */
+		using Replicator = std::function<void(const ucl_object_t *)>;
+
+		private:
+		/**
+		 * The path of the main config file.
+		 */
+		std::string path;
+
+		/**
+		 * Additional files to watch, as well as those found in `.include`
+		 * directives.
+		 */
+		std::vector<std::string> extraPaths;
+
+		/**
+		 * The function used to create configs.
+		 */
+		Loader load;
+
+		/**
+		 * How long the files must be unchanged before reloading.
+		 */
+		std::chrono::milliseconds debounce;
+
+		/**
+		 * The most recent valid config.
+		 */
+		std::atomic<std::shared_ptr<const Config>> config;
+
+		/**
+		 * The number of configs that have been published.
+		 */
+		std::atomic<uint64_t> generationCount{0};
+
+		/**
+		 * The number of reloads that have been attempted.
+		 */
+		std::atomic<uint64_t> attemptCount{0};
+
+		/**
+		 * Protects `subscribers`, `nextSubscriber`, and `error`.
+		 */
+		std::mutex lock;
+
+		/**
+		 * Notified after each reload attempt.
+		 */
+		std::condition_variable reloaded;
+
+		/**
+		 * The subscribers, keyed by the identifier returned from `subscribe`.
+		 */
+		std::map<size_t, Subscriber> subscribers;
+
+		/**
+		 * The identifier for the next subscriber.
+		 */
+		size_t nextSubscriber = 0;
+
+		/**
+		 * The error from the most recent reload, empty if it succeeded.
+		 */
+		std::string error;
+
+		/**
+		 * Serialises calls to `replicator`, and protects it and `document`.
+		 */
+		std::mutex replicationLock;
+
+		/**
+		 * The function that is called with each new document, if any.
+		 */
+		Replicator replicator;
+
+		/**
+		 * The document for the most recent valid config.
+		 */
+		UCLPtr document;
+
+		/**
+		 * The inotify file descriptor.
+		 */
+		int inotify = -1;
+
+		/**
+		 * Event file descriptor used to wake the background thread.
+		 */
+		int wake = -1;
+
+		/**
+		 * Set to stop the background thread.
+		 */
+		std::atomic<bool> stopping{false};
+
+		/**
+		 * Set to request a reload without a file change.
+		 */
+		std::atomic<bool> reloadRequested{false};
+
+		/**
+		 * Watched directories, mapping inotify watch descriptors to the
+		 * names of the files of interest in each directory.
+		 */
+		std::map<int, std::vector<std::string>> watches;
+
+		/**
+		 * The watch descriptor for each watched directory.
+		 */
+		std::map<std::string, int> directories;
+
+		/**
+		 * The background thread.  Declared last so that it starts after the
+		 * other fields are initialised.
+		 */
+		std::thread thread;
+
+		/**
+		 * Split a path into a directory and a file name.
+		 */
+		static std::pair<std::string, std::string>
+		split_path(const std::string &file)
+		{
+			size_t slash = file.rfind('/');
+			if (slash == std::string::npos)
+			{
+				return {".", file};
+			}
+			return {slash == 0 ? "/" : file.substr(0, slash),
+			        file.substr(slash + 1)};
+		}
+
+		/**
+		 * Watch the directories that contain `files`.  Watches on directories
+		 * that are still needed are kept, rather than removed and added
+		 * again, so that no change to them is missed during a reload.
+		 */
+		void watch(const std::vector<std::string> &files)
+		{
+			std::map<std::string, std::vector<std::string>> wanted;
+			for (auto &file : files)
+			{
+				auto [directory, name] = split_path(file);
+				wanted[directory].push_back(name);
+			}
+			uint32_t mask =
+			  IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+			std::map<std::string, int>              added;
+			std::map<int, std::vector<std::string>> newWatches;
+			for (auto &[directory, names] : wanted)
+			{
+				// Adding a watch for a directory that is already watched
+				// returns the existing descriptor.
+				int descriptor =
+				  inotify_add_watch(inotify, directory.c_str(), mask);
+				if (descriptor >= 0)
+				{
+					added.emplace(directory, descriptor);
+					auto &watched = newWatches[descriptor];
+					watched.insert(watched.end(), names.begin(), names.end());
+				}
+			}
+			// Two names for the same directory share a descriptor, so only
+			// remove descriptors that are no longer used by any of them.
+			for (auto &[directory, descriptor] : directories)
+			{
+				if (!newWatches.contains(descriptor))
+				{
+					inotify_rm_watch(inotify, descriptor);
+				}
+			}
+			directories = std::move(added);
+			watches     = std::move(newWatches);
+		}
+
+		/**
+		 * Read the pending inotify events.  Returns true if any of them
+		 * refer to a watched file.
+		 */
+		bool read_events()
+		{
+			alignas(inotify_event) char buffer[4096];
+			bool                        relevant = false;
+			ssize_t                     length;
+			while ((length = ::read(inotify, buffer, sizeof(buffer))) > 0)
+			{
+				for (char *p = buffer; p < buffer + length;)
+				{
+					auto *event = reinterpret_cast<inotify_event *>(p);
+					auto  found = watches.find(event->wd);
+					if ((found != watches.end()) && (event->len > 0))
+					{
+						for (auto &name : found->second)
+						{
+							relevant |= (name == event->name);
+						}
+					}
+					p += sizeof(inotify_event) + event->len;
+				}
+			}
+			return relevant;
+		}
+
+		/**
+		 * Parse and validate the config, publish it if it is valid, and
+		 * update the watched files.
+		 */
+		void reload()
+		{
+			std::string              message;
+			std::vector<std::string> files{path};
+			files.insert(files.end(), extraPaths.begin(), extraPaths.end());
+			// Find the included files, and the files that they include,
+			// before parsing, so that they are watched even if the config is
+			// not valid.  Each file is scanned once, so cycles terminate.
+			std::set<std::string>    scanned;
+			std::vector<std::string> pending{path};
+			while (!pending.empty())
+			{
+				std::string file = std::move(pending.back());
+				pending.pop_back();
+				if (!scanned.insert(file).second)
+				{
+					continue;
+				}
+				// libucl expands `$CURDIR` and `$FILENAME` from the canonical
+				// path of the file that is being parsed.
+				std::string canonical = real_path(file);
+				if (FILE *f = canonical.empty()
+				                ? nullptr
+				                : fopen(canonical.c_str(), "r"))
+				{
+					std::string text;
+					char        buffer[4096];
+					size_t      length;
+					while ((length = fread(buffer, 1, sizeof(buffer), f)) > 0)
+					{
+						text.append(buffer, length);
+					}
+					fclose(f);
+					auto included = included_files(text, canonical);
+					files.insert(files.end(), included.begin(), included.end());
+					pending.insert(
+					  pending.end(), included.begin(), included.end());
+				}
+			}
+			watch(files);
+			auto *p = ucl_parser_new(UCL_PARSER_NO_IMPLICIT_ARRAYS);
+			ucl_parser_add_file(p, path.c_str());
+			if (const char *parseError = ucl_parser_get_error(p))
+			{
+				message = parseError;
+			}
+			else
+			{
+				UCLPtr obj{ucl_parser_get_object(p)};
+				// The `UCLPtr` holds its own reference.
+				ucl_object_unref(obj);
+				auto result = load(obj, true);
+				if (auto *err = std::get_if<ucl_schema_error>(&result))
+				{
+					message = err->msg;
+				}
+				else if (!unchanged(std::get<Config>(result)))
+				{
+					publish(std::make_shared<const Config>(
+					          std::move(std::get<Config>(result))),
+					        obj);
+				}
+			}
+			ucl_parser_free(p);
+			std::lock_guard<std::mutex> guard(lock);
+			error = std::move(message);
+			attemptCount++;
+			reloaded.notify_all();
+		}
+
+		/**
+		 * Returns true if `newConfig` is equal to the current config, in
+		 * which case a reload does not need to publish it.  Configs that
+		 * cannot be compared are always published.
+		 */
+		bool unchanged(const Config &newConfig)
+		{
+			if constexpr (std::equality_comparable<Config>)
+			{
+				auto current = config.load();
+				return current && (*current == newConfig);
+			}
+			return false;
+		}
+
+		/**
+		 * Make `newConfig` current and pass it to the subscribers.
+		 */
+		void publish(std::shared_ptr<const Config> newConfig,
+		             const UCLPtr                 &newDocument)
+		{
+			{
+				// Replicas are made before the config is published, so that
+				// they are current by the time subscribers are notified.
+				std::lock_guard<std::mutex> guard(replicationLock);
+				document = newDocument;
+				if (replicator)
+				{
+					replicator(document);
+				}
+			}
+			config.store(newConfig);
+			generationCount++;
+			std::vector<Subscriber> toNotify;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				for (auto &[id, subscriber] : subscribers)
+				{
+					toNotify.push_back(subscriber);
+				}
+			}
+			for (auto &subscriber : toNotify)
+			{
+				subscriber(newConfig);
+			}
+		}
+
+		/**
+		 * The body of the background thread.  Waits for changes, waits for
+		 * them to stop, and then reloads.
+		 */
+		void run()
+		{
+			pollfd fds[2] = {{inotify, POLLIN, 0}, {wake, POLLIN, 0}};
+			bool   dirty  = false;
+			while (!stopping)
+			{
+				int timeout = dirty ? static_cast<int>(debounce.count()) : -1;
+				int ready   = poll(fds, 2, timeout);
+				if (ready < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					break;
+				}
+				if (fds[1].revents & POLLIN)
+				{
+					uint64_t value;
+					(void)!::read(wake, &value, sizeof(value));
+					if (reloadRequested.exchange(false))
+					{
+						reload();
+					}
+					continue;
+				}
+				if (fds[0].revents & POLLIN)
+				{
+					dirty |= read_events();
+					continue;
+				}
+				// The poll timed out, so there has been no change for the
+				// debounce interval.
+				if (dirty)
+				{
+					dirty = false;
+					reload();
+				}
+			}
+		}
+
+		public:
+		/**
+		 * Constructor.  Loads the config at `file` with `loader` and then
+		 * watches it, and any files it includes or that are listed in
+		 * `extraFiles`, for changes.  If the initial config is not valid then
+		 * `current` returns null until a valid config is loaded.
+		 */
+		ConfigWatcher(std::string               file,
+		              Loader                    loader,
+		              std::chrono::milliseconds debounceInterval =
+		                std::chrono::milliseconds(100),
+		              std::vector<std::string> extraFiles = {})
+		  : path(std::move(file)),
+		    extraPaths(std::move(extraFiles)),
+		    load(std::move(loader)),
+		    debounce(debounceInterval)
+		{
+			inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			wake    = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			reload();
+			thread = std::thread([this]() { run(); });
+		}
+
+		/**
+		 * Destructor, stops the background thread.
+		 */
+		~ConfigWatcher()
+		{
+			stopping = true;
+			uint64_t one = 1;
+			(void)!::write(wake, &one, sizeof(one));
+			thread.join();
+			close(inotify);
+			close(wake);
+		}
+
+		ConfigWatcher(const ConfigWatcher &) = delete;
+
+		ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+
+		/**
+		 * Returns the most recent valid config, or null if there has not
+		 * been one.
+		 */
+		std::shared_ptr<const Config> current() const
+		{
+			return config.load();
+		}
+
+		/**
+		 * Call `newReplicator` with the document for the current config, if
+		 * there is one, and then with the document for each new config.  This
+		 * replaces any existing replicator.
+		 */
+		void replicate(Replicator newReplicator)
+		{
+			std::lock_guard<std::mutex> guard(replicationLock);
+			replicator = std::move(newReplicator);
+			if (replicator && document)
+			{
+				replicator(document);
+			}
+		}
+
+		/**
+		 * Returns the number of configs that have been published.
+		 */
+		uint64_t generation() const
+		{
+			return generationCount;
+		}
+
+		/**
+		 * Returns the number of reloads that have completed, whether or not
+		 * they produced a valid config.
+		 */
+		uint64_t attempts() const
+		{
+			return attemptCount;
+		}
+
+		/**
+		 * Returns the error from the most recent reload, or an empty string
+		 * if it succeeded.
+		 */
+		std::string last_error()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			return error;
+		}
+
+		/**
+		 * Register a function to call with each new config.  Returns an
+		 * identifier that can be passed to `unsubscribe`.
+		 */
+		size_t subscribe(Subscriber subscriber)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			subscribers.emplace(nextSubscriber, std::move(subscriber));
+			return nextSubscriber++;
+		}
+
+		/**
+		 * Remove a subscriber.  It may still be called once if a config is
+		 * being published concurrently.
+		 */
+		void unsubscribe(size_t id)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			subscribers.erase(id);
+		}
+
+		/**
+		 * Ask the background thread to reload the config now, without
+		 * waiting for a change.
+		 */
+		void request_reload()
+		{
+			reloadRequested = true;
+			uint64_t one    = 1;
+			(void)!::write(wake, &one, sizeof(one));
+		}
+
+		/**
+		 * Wait until more than `count` reloads have completed, or until
+		 * `timeout` expires.  Returns true if the reloads completed.  This is
+		 * intended for tests and for startup code that must see a change
+		 * applied.
+		 */
+		bool wait_for_attempts(uint64_t                  count,
+		                       std::chrono::milliseconds timeout)
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			return reloaded.wait_for(
+			  guard, timeout, [&]() { return attemptCount > count; });
+		}
+	};
+} // namespace CONFIG_DETAIL_NAMESPACE
@@ -0,0 +1,181 @@
+#include "test_async.h"
+#include "config-async.h"
+#include "test_helpers.h"
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace config::detail;
+
+/**
+ * A minimal event loop.  Tasks may be posted from any thread and are run by
+ * `run`, on the thread that calls it.
+ */
+class EventLoop
+{
+	std::mutex                        lock;
+	std::condition_variable           wake;
+	std::deque<std::function<void()>> queue;
+
+	public:
+	/**
+	 * The number of tasks that have been run.
+	 */
+	size_t steps = 0;
+
+	void post(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			queue.push_back(std::move(task));
+		}
+		wake.notify_one();
+	}
+
+	/**
+	 * Run tasks until `done` is true.
+	 */
+	void run(const bool &done)
+	{
+		while (!done)
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [&]() { return !queue.empty(); });
+			auto task = std::move(queue.front());
+			queue.pop_front();
+			guard.unlock();
+			task();
+			steps++;
+		}
+	}
+};
+
+/**
+ * A coroutine that starts immediately and is not awaited.
+ */
+struct Task
+{
+	struct promise_type
+	{
+		Task get_return_object()
+		{
+			return {};
+		}
+		std::suspend_never initial_suspend()
+		{
+			return {};
+		}
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+		void return_void() {}
+		void unhandled_exception()
+		{
+			std::terminate();
+		}
+	};
+};
+
+using Result = std::variant<Config, ucl_schema_error>;
+
+/**
+ * Load `path` and store the result and the thread that it was resumed on.
+ */
+static Task load(EventLoop              &loop,
+                 std::string             path,
+                 AsyncOptions            options,
+                 std::optional<Result>  &result,
+                 std::thread::id        &resumedOn,
+                 bool                   &done)
+{
+	result    = co_await make_config_async(std::move(path), loop, options);
+	resumedOn = std::this_thread::get_id();
+	done      = true;
+}
+
+/**
+ * Load `path` on `loop` with `options` and return the result.
+ */
+static Result
+run(EventLoop &loop, const std::string &path, AsyncOptions options)
+{
+	std::optional<Result> result;
+	std::thread::id       resumedOn;
+	bool                  done = false;
+	load(loop, path, options, result, resumedOn, done);
+	// Nothing happens until the loop runs.
+	assert(!done);
+	loop.run(done);
+	assert(resumedOn == std::this_thread::get_id());
+	return std::move(*result);
+}
+
+int main()
+{
+	char pattern[] = "/tmp/config-async-XXXXXX";
+	std::string directory = mkdtemp(pattern);
+	std::string valid     = directory + "/valid.conf";
+	std::string invalid   = directory + "/invalid.conf";
+	std::string longName  = directory + "/long.conf";
+	std::ofstream(valid) << "name = \"a\";\nworkers = 4;\ntimeout = 1.5;\n"
+	                        "tags = [\"x\", \"y\"];\n";
+	std::ofstream(invalid) << "name = \"a\";\nworkers = 4;\ntimeout = 90;\n";
+	// The generated checks count the length in characters and also run as
+	// their own steps.
+	std::string accents = "\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9";
+	std::ofstream(longName) << "name = \"" << accents << accents << "x\";\n";
+
+	EventLoop  loop;
+	WorkerPool pool(2);
+
+	// On a pool, the loop only runs the resumption.
+	auto result = run(loop, valid, {.pool = &pool});
+	assert(std::holds_alternative<Config>(result));
+	assert(std::get<Config>(result).workers() == 4);
+	assert(loop.steps == 1);
+
+	// Without a pool, validation is split into a step per property.
+	loop.steps = 0;
+	result     = run(loop, valid, {});
+	assert(std::holds_alternative<Config>(result));
+	assert(std::get<Config>(result).name() == "a");
+	assert(loop.steps > 4);
+	size_t steps = loop.steps;
+	loop.steps   = 0;
+	result       = run(loop, valid, {.chunkSize = 4});
+	assert(std::holds_alternative<Config>(result));
+	assert(loop.steps < steps);
+
+	// Both modes reject invalid documents.
+	assert(std::holds_alternative<ucl_schema_error>(
+	  run(loop, invalid, {.pool = &pool})));
+	assert(std::holds_alternative<ucl_schema_error>(run(loop, invalid, {})));
+	assert(std::holds_alternative<ucl_schema_error>(
+	  run(loop, longName, {.pool = &pool})));
+	assert(std::holds_alternative<ucl_schema_error>(run(loop, longName, {})));
+	std::ofstream(longName) << "name = \"" << accents << accents << "\";\n";
+	result = run(loop, longName, {});
+	assert(std::holds_alternative<Config>(result));
+	assert(std::get<Config>(result).name() == accents + accents);
+
+	// A missing file is an error.
+	assert(std::holds_alternative<ucl_schema_error>(
+	  run(loop, directory + "/missing.conf", {.pool = &pool})));
+	assert(std::holds_alternative<ucl_schema_error>(
+	  run(loop, directory + "/missing.conf", {})));
+
+	// Cancelling stops the load at the next step.
+	AsyncOptions cancelled;
+	cancelled.token.cancel();
+	result = run(loop, valid, cancelled);
+	assert(std::holds_alternative<ucl_schema_error>(result));
+	assert(std::string(std::get<ucl_schema_error>(result).msg) == "cancelled");
+
+	remove(valid.c_str());
+	remove(invalid.c_str());
+	remove(longName.c_str());
+	remove(directory.c_str());
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,55 @@
+#include "test_bake.h"
+#include <cassert>
+#include <cstdlib>
+
+using namespace std::chrono_literals;
+
+// Every value is known at compile time.
+static_assert(baked_config.name() == "cache");
+static_assert(baked_config.workers() == 8);
+static_assert(baked_config.ratio() == 0.25);
+static_assert(*baked_config.verbose());
+static_assert(*baked_config.timeout() == 1500ms);
+static_assert(baked_config.buffer_size()->count() == 65536);
+static_assert(baked_config.address()->bytes[3] == 1);
+static_assert(baked_config.endpoint()->host == "example.com");
+static_assert(baked_config.endpoint()->port == 8443);
+static_assert(baked_config.allowed()->size() == 2);
+static_assert((*baked_config.allowed())[1].length == 16);
+static_assert(baked_config.backends()->size() == 2);
+static_assert((*baked_config.backends())[0].name() == "alpha");
+static_assert((*(*baked_config.backends())[0].ports())[1] == 443);
+static_assert(!(*baked_config.backends())[1].ports());
+static_assert(baked_config.logging()->level() == "debug");
+static_assert(!baked_config.logging()->file());
+static_assert(!baked_config.retries());
+static_assert(baked_config.color()->extent == 3);
+static_assert((*baked_config.color())[1] == 128);
+
+/**
+ * Branches on baked values are resolved at compile time.
+ */
+template<int Workers>
+constexpr int worker_count()
+{
+	return Workers;
+}
+
+int main()
+{
+	static_assert(worker_count<baked_config.workers()>() == 8);
+	// The arrays can be iterated at run time.
+	int ports = 0;
+	for (auto &backend : *baked_config.backends())
+	{
+		if (auto list = backend.ports())
+		{
+			for (uint16_t port : *list)
+			{
+				ports += port;
+			}
+		}
+	}
+	assert(ports == 523);
+	return EXIT_SUCCESS;
+}
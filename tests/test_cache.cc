@@ -0,0 +1,66 @@
+#include "test_cache.h"
+#include "test_helpers.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+static const char config_string[] = "listen = \"192.0.2.1\"; workers = 4;\n";
+
+static const char other_string[] = "listen = \"192.0.2.2\";\n";
+
+static const char invalid_string[] = "listen = \"192.0.2.1\"; workers = 0;\n";
+
+int main()
+{
+	using config::detail::IPv4Address;
+	{
+		config::detail::ConfigCache<Config> cache;
+		auto first = make_config_cached(config_string, cache);
+		assert(std::get<Config>(first).workers() == 4);
+		auto second = make_config_cached(config_string, cache);
+		// Values decoded into the snapshot are still available.
+		assert((std::get<Config>(second).listen() ==
+		        IPv4Address{{192, 0, 2, 1}}));
+		assert(std::get<Config>(second).workers() == 4);
+		assert(std::holds_alternative<ucl_schema_error>(
+		  make_config_cached(invalid_string, cache)));
+		assert(std::holds_alternative<ucl_schema_error>(
+		  make_config_cached(invalid_string, cache)));
+		assert(std::holds_alternative<ucl_schema_error>(
+		  make_config_cached("listen = ", cache)));
+		auto stats = cache.statistics();
+		assert(stats.reused == 0);
+		assert(stats.skipped == 1);
+		assert(stats.validated == 3);
+	}
+	{
+		// Reuse the most recent config.
+		config::detail::ConfigCache<Config> cache(true);
+		auto first  = make_config_cached(config_string, cache);
+		auto second = make_config_cached(config_string, cache);
+		assert(std::get<Config>(second).workers() == 4);
+		make_config_cached(other_string, cache);
+		make_config_cached(config_string, cache);
+		auto stats = cache.statistics();
+		assert(stats.reused == 1);
+		assert(stats.skipped == 1);
+		assert(stats.validated == 2);
+	}
+	{
+		// Persist validated hashes across instances.
+		char path[] = "/tmp/config-cache-XXXXXX";
+		int  fd     = mkstemp(path);
+		assert(fd >= 0);
+		close(fd);
+		{
+			config::detail::ConfigCache<Config> cache(false, path);
+			make_config_cached(config_string, cache);
+			assert(cache.statistics().validated == 1);
+		}
+		config::detail::ConfigCache<Config> cache(false, path);
+		auto conf = make_config_cached(config_string, cache);
+		assert(std::get<Config>(conf).workers() == 4);
+		assert(cache.statistics().skipped == 1);
+		unlink(path);
+	}
+	return EXIT_SUCCESS;
+}
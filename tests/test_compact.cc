@@ -0,0 +1,39 @@
+#include "test_compact.h"
+#include "test_helpers.h"
+
+static const char config_string[] =
+  "listen = \"192.0.2.1\";\n"
+  "comment = \"not used by this program\";\n"
+  "other-tool { enabled = true; paths = [\"/a\", \"/b\"]; }\n"
+  "server { name = \"www\"; notes = \"ignored\"; }\n"
+  "backends = [{ host = \"a\"; weight = 1; }, { host = \"b\"; }];\n";
+
+int main()
+{
+	auto obj         = parse(config_string, sizeof(config_string));
+	auto confOrError = make_config(obj, true);
+	assert(std::holds_alternative<Config>(confOrError));
+	auto conf = std::get<Config>(confOrError);
+	// Unknown properties are removed at every level.
+	assert(ucl_object_lookup(obj, "comment") == nullptr);
+	assert(ucl_object_lookup(obj, "other-tool") == nullptr);
+	assert(ucl_object_lookup(ucl_object_lookup(obj, "server"), "notes") ==
+	       nullptr);
+	auto *first = ucl_array_find_index(ucl_object_lookup(obj, "backends"), 0);
+	assert(ucl_object_lookup(first, "weight") == nullptr);
+	// Properties in the schema, and values in the snapshot, are kept.
+	assert((conf.listen() == config::detail::IPv4Address{{192, 0, 2, 1}}));
+	assert(conf.server()->name() == "www");
+	auto backends = *conf.backends();
+	int  count    = 0;
+	for (auto backend : backends)
+	{
+		assert(backend.host() == (count++ == 0 ? "a" : "b"));
+	}
+	assert(count == 2);
+	// Without the flag, the object is not modified.
+	auto unchanged = parse(config_string, sizeof(config_string));
+	getConfig(unchanged);
+	assert(ucl_object_lookup(unchanged, "comment") != nullptr);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+#include "test_constant.h"
+#include "test_helpers.h"
+
+// Required properties with a single valid value are compile-time constants.
+static_assert(Config::version() == 3);
+static_assert(Config::mode() == "strict");
+static_assert(Config::strict());
+
+static Config load(const char *text)
+{
+	auto *obj  = parse(text, strlen(text));
+	auto  conf = getConfig(obj);
+	ucl_object_unref(obj);
+	return conf;
+}
+
+int main()
+{
+	auto conf = load("version = 3; mode = strict; strict = true; workers = 4;");
+	assert(conf.version() == 3);
+	assert(conf.get<"mode">() == "strict");
+	assert(conf.workers() == 4);
+	assert(!conf.ratio());
+	assert(!conf.label());
+
+	// Optional properties with a single valid value are only looked up to
+	// check whether they are present.
+	auto full = load("version = 3; mode = strict; strict = true; workers = 4;"
+	                 "ratio = 0.5; label = \"a \\\"quoted\\\" label\";");
+	assert(full.ratio() == 0.5);
+	assert(full.label() == "a \"quoted\" label");
+	assert(!(conf == full));
+
+	// Constants are still checked when the config is validated.
+	for (const char *text : {
+	       "version = 4; mode = strict; strict = true; workers = 4;",
+	       "version = 3; mode = lax; strict = true; workers = 4;",
+	       "version = 3; mode = strict; strict = false; workers = 4;",
+	       "version = 3; mode = strict; strict = true; workers = 4; "
+	       "ratio = 1;",
+	       "version = 3; mode = strict; strict = true; workers = 4; "
+	       "label = other;",
+	     })
+	{
+		auto *obj = parse(text, strlen(text));
+		checkInvalidConfig(obj);
+		ucl_object_unref(obj);
+	}
+	return EXIT_SUCCESS;
+}
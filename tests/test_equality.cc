@@ -0,0 +1,143 @@
+#include "test_equality.h"
+#include "test_helpers.h"
+
+static const char config_string[] =
+  "name = \"a\";\n"
+  "ratio = 0.0;\n"
+  "timeout = 1.5;\n"
+  "buffer = 1kb;\n"
+  "address = \"10.0.0.1\";\n"
+  "allowed = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+  "server { host = \"example.com\"; ports = [80, 443]; }\n";
+
+// The same config, written differently, with a property that is not in the
+// schema.
+static const char equivalent[] =
+  "unknown = 1;\n"
+  "server { ports = [80, 443]; host = \"example.com\"; }\n"
+  "allowed = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+  "address = \"10.0.0.1\";\n"
+  "buffer = \"1024\";\n"
+  "timeout = 1500ms;\n"
+  "ratio = -0.0;\n"
+  "name = \"a\";\n";
+
+// Configs that differ from `config_string` in one property.
+static const char *different[] = {
+  "name = \"b\";\n"
+  "ratio = 0.0;\n"
+  "timeout = 1.5;\n"
+  "buffer = 1kb;\n"
+  "address = \"10.0.0.1\";\n"
+  "allowed = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+  "server { host = \"example.com\"; ports = [80, 443]; }\n",
+  "name = \"a\";\n"
+  "timeout = 1.5;\n"
+  "buffer = 1kb;\n"
+  "address = \"10.0.0.1\";\n"
+  "allowed = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+  "server { host = \"example.com\"; ports = [80, 443]; }\n",
+  "name = \"a\";\n"
+  "ratio = 0.0;\n"
+  "timeout = 2;\n"
+  "buffer = 1kb;\n"
+  "address = \"10.0.0.1\";\n"
+  "allowed = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+  "server { host = \"example.com\"; ports = [80, 443]; }\n",
+  "name = \"a\";\n"
+  "ratio = 0.0;\n"
+  "timeout = 1.5;\n"
+  "buffer = 1000;\n"
+  "address = \"10.0.0.1\";\n"
+  "allowed = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+  "server { host = \"example.com\"; ports = [80, 443]; }\n",
+  "name = \"a\";\n"
+  "ratio = 0.0;\n"
+  "timeout = 1.5;\n"
+  "buffer = 1kb;\n"
+  "address = \"10.0.0.2\";\n"
+  "allowed = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+  "server { host = \"example.com\"; ports = [80, 443]; }\n",
+  "name = \"a\";\n"
+  "ratio = 0.0;\n"
+  "timeout = 1.5;\n"
+  "buffer = 1kb;\n"
+  "address = \"10.0.0.1\";\n"
+  "allowed = [\"192.168.0.0/16\", \"10.0.0.0/8\"];\n"
+  "server { host = \"example.com\"; ports = [80, 443]; }\n",
+  "name = \"a\";\n"
+  "ratio = 0.0;\n"
+  "timeout = 1.5;\n"
+  "buffer = 1kb;\n"
+  "address = \"10.0.0.1\";\n"
+  "allowed = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+  "server { host = \"example.com\"; ports = [80]; }\n",
+};
+
+static Config load(const char *text)
+{
+	auto *obj  = parse(text, strlen(text));
+	auto  conf = getConfig(obj);
+	ucl_object_unref(obj);
+	return conf;
+}
+
+int main()
+{
+	auto conf = load(config_string);
+	assert(conf == conf);
+	assert(conf.server() == conf.server());
+
+	// Properties are compared by value, not by how they were written.
+	auto same = load(equivalent);
+	assert(conf == same);
+	assert(conf.hash() == same.hash());
+	assert(conf.server()->hash() == same.server()->hash());
+
+	// Copies keep the cached hash and compare equal without looking at the
+	// properties.
+	Config copy = conf;
+	assert(copy.hash() == conf.hash());
+	assert(copy == conf);
+
+	for (const char *text : different)
+	{
+		auto other = load(text);
+		assert(!(conf == other));
+		assert(conf.hash() != other.hash());
+	}
+
+	// Each call to an accessor returns a new object, but the hash of the
+	// section is kept in the snapshot, so it is computed once.
+	auto   fresh  = load(config_string);
+	size_t before = fresh.bytes();
+	auto   hash   = fresh.server()->hash();
+	size_t after  = fresh.bytes();
+	assert(after > before);
+	assert(fresh.server()->hash() == hash);
+	assert(fresh.bytes() == after);
+
+	// Sections can be compared on their own.
+	auto renamed = load(different[0]);
+	assert(!(conf == renamed));
+	assert(conf.server() == renamed.server());
+	auto fewerPorts = load(different[6]);
+	assert(!(conf.server() == fewerPorts.server()));
+	assert(conf.allowed() == fewerPorts.allowed());
+
+	// Comparing does not compute hashes, and the result of comparing two
+	// sections is kept in the snapshot, so comparing them again is free.
+	auto   left   = load(config_string);
+	auto   right  = load(equivalent);
+	size_t empty  = left.bytes();
+	assert(left.server() == right.server());
+	assert(left.server()->known_hash() == 0);
+	assert(right.server()->known_hash() == 0);
+	size_t compared = left.bytes();
+	assert(compared > empty);
+	assert(left.server() == right.server());
+	assert(left.bytes() == compared);
+	left.server()->hash();
+	assert(left.server()->known_hash() != 0);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,55 @@
+#include "test_fixed.h"
+#include "test_helpers.h"
+#include <type_traits>
+
+// The length of arrays with a fixed number of items is a constant.
+static_assert(decltype(std::declval<Config>().color())::size() == 3);
+static_assert(decltype(std::declval<Config>().replicas())::size() == 2);
+
+static const char config_string[] =
+  "color = [255, 128, 0];\n"
+  "thresholds = [0.5, 0.75, 0.9, 0.99];\n"
+  "replicas = [{ host = \"a\"; }, { host = \"b\"; }];\n"
+  "tags = [\"x\", \"y\"];\n";
+
+int main()
+{
+	auto obj  = parse(config_string, sizeof(config_string));
+	auto conf = getConfig(obj);
+	ucl_object_unref(obj);
+
+	auto color = conf.color();
+	assert(color[0] == 255);
+	assert(color[1] == 128);
+	assert(color.get<2>() == 0);
+	int sum = 0;
+	for (auto component : color)
+	{
+		sum += component;
+	}
+	assert(sum == 383);
+
+	auto thresholds = conf.thresholds();
+	assert(thresholds);
+	assert((*thresholds)[3] == 0.99);
+	assert(conf.replicas()[1].host() == "b");
+
+	// Arrays whose length can vary are plain ranges.
+	using Tags = config::detail::
+	  Range<std::string_view, config::detail::StringViewAdaptor, true>;
+	static_assert(std::is_same_v<decltype(conf.tags()), std::optional<Tags>>);
+	assert(conf.tags()->at(1) == "y");
+
+	// The number of items is still checked when the config is validated.
+	for (const char *text : {
+	       "color = [255, 128]; replicas = [{ host = a; }, { host = b; }];",
+	       "color = [1, 2, 3, 4]; replicas = [{ host = a; }, { host = b; }];",
+	       "color = [1, 2, 3]; replicas = [{ host = a; }];",
+	     })
+	{
+		auto *invalid = parse(text, strlen(text));
+		checkInvalidConfig(invalid);
+		ucl_object_unref(invalid);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#include "test_format.h"
+#include "test_helpers.h"
+
+static const char config_string[] =
+  "listen = \"192.0.2.1\";\n"
+  "listen6 = \"2001:db8::1\";\n"
+  "allow = [\"10.0.0.0/8\", \"2001:db8::/32\"];\n"
+  "host = \"www.example.com\";\n"
+  "upstream { url = \"https://user@[::1]:8443/a/b?x=1#top\"; }\n";
+
+static const char bad_ipv4[] = "listen = \"192.0.2.256\";\n";
+
+static const char bad_cidr[] = "listen = \"192.0.2.1\";\n"
+                               "allow = [\"10.0.0.1/8\"];\n";
+
+static const char bad_host[] = "listen = \"192.0.2.1\";\n"
+                               "host = \"-example.com\";\n";
+
+static const char bad_uri[] = "listen = \"192.0.2.1\";\n"
+                              "upstream { url = \"ftp://example.com\"; }\n";
+
+int main()
+{
+	using namespace config::detail;
+	auto obj  = parse(config_string, sizeof(config_string));
+	auto conf = getConfig(obj);
+	assert((conf.listen() == IPv4Address{{192, 0, 2, 1}}));
+	assert(conf.listen6()->bytes[0] == 0x20);
+	assert(conf.listen6()->bytes[15] == 1);
+	int  prefixes = 0;
+	auto allow    = conf.allow();
+	for (IPPrefix prefix : *allow)
+	{
+		if (prefixes++ == 0)
+		{
+			assert(prefix.length == 8);
+			assert(prefix.contains(*formats::parse_address("10.1.2.3")));
+			assert(!prefix.contains(*formats::parse_address("11.1.2.3")));
+		}
+		else
+		{
+			assert(prefix.length == 32);
+			assert(prefix.address.family == AF_INET6);
+		}
+	}
+	assert(prefixes == 2);
+	assert(conf.host() == "www.example.com");
+	URI url = conf.upstream()->url();
+	assert(url.scheme == "https");
+	assert(url.userinfo == "user");
+	assert(url.host == "[::1]");
+	assert(url.port == 8443);
+	assert(url.path == "/a/b");
+	assert(url.query == "x=1");
+	assert(url.fragment == "top");
+	// Without a snapshot, values are decoded on access.
+	Config direct(obj);
+	assert((direct.listen() == IPv4Address{{192, 0, 2, 1}}));
+	checkInvalidConfig(parse(bad_ipv4, sizeof(bad_ipv4)));
+	checkInvalidConfig(parse(bad_cidr, sizeof(bad_cidr)));
+	checkInvalidConfig(parse(bad_host, sizeof(bad_host)));
+	checkInvalidConfig(parse(bad_uri, sizeof(bad_uri)));
+	return EXIT_SUCCESS;
+}
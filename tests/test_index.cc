@@ -0,0 +1,43 @@
+#include "test_index.h"
+#include "test_helpers.h"
+
+static const char config_string[] =
+  "backends = [\n"
+  "  { name = \"alpha\"; host = \"a.example.com\"; port = 80; },\n"
+  "  { name = \"beta\"; host = \"b.example.com\"; },\n"
+  "  { name = \"gamma\"; host = \"c.example.com\"; port = 8080; },\n"
+  "];\n";
+
+static const char duplicate[] =
+  "backends = [\n"
+  "  { name = \"alpha\"; host = \"a.example.com\"; },\n"
+  "  { name = \"alpha\"; host = \"b.example.com\"; },\n"
+  "];\n";
+
+static const char bad_item[] =
+  "backends = [{ name = \"Alpha\"; host = \"a.example.com\"; }];\n";
+
+int main()
+{
+	auto obj      = parse(config_string, sizeof(config_string));
+	auto conf     = getConfig(obj);
+	auto backends = conf.backends();
+	assert(backends.find_by_name("beta")->host() == "b.example.com");
+	assert(!backends.find_by_name("beta")->port());
+	assert(backends.find_by_name("gamma")->port() == 8080);
+	assert(!backends.find_by_name("delta"));
+	// The index does not change iteration.
+	int count = 0;
+	for (auto backend : backends)
+	{
+		assert(backends.find_by_name(backend.name())->host() == backend.host());
+		count++;
+	}
+	assert(count == 3);
+	// Without a snapshot, lookups scan the array.
+	assert(Config(obj).backends().find_by_name("alpha")->port() == 80);
+	assert(!Config(obj).backends().find_by_name("delta"));
+	checkInvalidConfig(parse(duplicate, sizeof(duplicate)));
+	checkInvalidConfig(parse(bad_item, sizeof(bad_item)));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#include "test_layout.h"
+#include "test_helpers.h"
+#include <array>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <type_traits>
+
+static const char config_string[] = "name = \"a\";\nworkers = 4;\n"
+                                    "ratio = 0.5;\nmotd = \"hello\";\n"
+                                    "color = [255, 128, 0];\n"
+                                    "ports = [80, 443];\n"
+                                    "aliases = [\"b\", \"c\"];\n"
+                                    "limits { depth = 3; }\n";
+
+/**
+ * Returns the access counts written by `write_access_profile`.
+ */
+static std::map<std::string, unsigned long long> read_profile()
+{
+	FILE *f = tmpfile();
+	Config::write_access_profile(f);
+	rewind(f);
+	std::map<std::string, unsigned long long> counts;
+	char                                      name[64];
+	unsigned long long                        count;
+	while (fscanf(f, "%63s %llu", name, &count) == 2)
+	{
+		counts[name] = count;
+	}
+	fclose(f);
+	return counts;
+}
+
+int main()
+{
+	// With a profile, the class is aligned so that the hot fields share a
+	// cache line.
+	static_assert(alignof(Config) == 64);
+	auto obj  = parse(config_string, sizeof(config_string));
+	auto conf = getConfig(obj);
+	ucl_object_unref(obj);
+
+	// Fields in the first cache line.
+	assert(conf.name() == "a");
+	assert(conf.workers() == 4);
+	assert(conf.ratio() == 0.5);
+	assert(!conf.backlog());
+	// Arrays with a fixed number of items are decoded into `std::array`s.
+	using Color = std::array<uint8_t, 3>;
+	static_assert(std::is_same_v<decltype(conf.color()),
+	                             const std::optional<Color> &>);
+	assert((conf.color() == Color{255, 128, 0}));
+	// Arrays with a small `maxItems` are stored inline.
+	auto ports = *conf.ports();
+	static_assert(sizeof(ports) == 18);
+	assert(ports.size() == 2);
+	assert(ports[1] == 443);
+	// Fields behind the pointer.
+	assert(!conf.verbose());
+	assert(conf.motd() == "hello");
+	assert(!conf.origin());
+	int aliases = 0;
+	for (auto alias : *conf.aliases())
+	{
+		assert((alias == "b") || (alias == "c"));
+		aliases++;
+	}
+	assert(aliases == 2);
+	// Properties that are not scalars are looked up as before.
+	assert(conf.limits()->depth() == 3);
+	assert(conf.get<"motd">() == "hello");
+
+	auto copy = conf;
+	assert(copy.name() == "a");
+
+	auto counts = read_profile();
+	assert(counts.size() == 11);
+	assert(counts["name"] == 2);
+	assert(counts["workers"] == 1);
+	assert(counts["motd"] == 2);
+	assert(counts["limits"] == 1);
+	assert(counts["color"] == 1);
+	assert(counts["ports"] == 1);
+	return EXIT_SUCCESS;
+}
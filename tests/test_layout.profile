@@ -0,0 +1,12 @@
+# Written by Config::write_access_profile
+name 120000
+workers 90000
+verbose 0
+ratio 5000
+motd 0
+backlog 12
+color 30000
+origin 0
+ports 20000
+aliases 0
+limits 7
@@ -0,0 +1,64 @@
+#include "test_length.h"
+#include "test_helpers.h"
+#include <string>
+
+using config::detail::utf8_length;
+
+static bool valid(const std::string &text)
+{
+	auto *obj    = parse(text.data(), text.size());
+	auto  result = make_config(obj);
+	ucl_object_unref(obj);
+	return std::holds_alternative<Config>(result);
+}
+
+int main()
+{
+	// Lengths are counted in code points.
+	assert(utf8_length("") == 0);
+	assert(utf8_length("h\xc3\xa9llo") == 5);
+	assert(utf8_length("\xe2\x82\xac") == 1);
+	assert(utf8_length("\xf0\x9f\x98\x80") == 1);
+	std::string ascii(100, 'a');
+	assert(utf8_length(ascii) == 100);
+	std::string mixed = ascii + "\xc3\xa9" + ascii + "\xe2\x82\xac";
+	assert(utf8_length(mixed) == 202);
+
+	// Invalid sequences are rejected, including after a run of ASCII.
+	for (std::string invalid : {"\x80",
+	                            "\xc0\xaf",
+	                            "\xc3",
+	                            "\xe0\x80\xaf",
+	                            "\xed\xa0\x80",
+	                            "\xf4\x90\x80\x80",
+	                            "\xf8\x88\x80\x80\x80",
+	                            "\xe2\x82"})
+	{
+		assert(!utf8_length(invalid));
+		assert(!utf8_length(ascii + invalid));
+		assert(!utf8_length(invalid + ascii));
+	}
+
+	// Sequences that cross a 16-byte block are still counted and validated.
+	for (size_t offset = 0; offset < 20; offset++)
+	{
+		std::string prefix(offset, 'a');
+		assert(utf8_length(prefix + "\xf0\x9f\x98\x80" + ascii) ==
+		       offset + 101);
+		assert(utf8_length(prefix + "\xe2\x82\xac" + ascii) == offset + 101);
+		assert(!utf8_length(prefix + "\xed\xa0\x80" + ascii));
+		assert(!utf8_length(prefix + "\xf0\x9f\x98" + ascii));
+		assert(!utf8_length(prefix + "\xf0\x9f\x98"));
+	}
+
+	assert(valid("name = ab;"));
+	assert(valid("name = \"h\xc3\xa9llo\";"));
+	assert(valid("name = abc; tags = [x, yz];"));
+	assert(valid("name = abc; motd = \"" + std::string(40, 'm') + "\";"));
+	assert(!valid("name = a;"));
+	assert(!valid("name = abcdef;"));
+	assert(!valid("name = \"h\xc3\xa9llo!\";"));
+	assert(!valid("name = abc; tags = [x, \"\"];"));
+	assert(!valid("name = abc; motd = \"" + std::string(41, 'm') + "\";"));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+#include "test_limits.h"
+#include "test_helpers.h"
+#include <chrono>
+#include <string>
+#include <string_view>
+
+using namespace config::detail;
+
+// The root object, `name`, four ports, and two routes with a path and three
+// hosts each.
+static_assert(schema_limits.maxBytes == 0);
+static_assert(schema_limits.maxDepth == 5);
+static_assert(schema_limits.maxNodes == 20);
+static_assert(schema_limits.maxArrayLength == 4);
+
+static const char config_string[] =
+  "name = \"front\";\n"
+  "ports = [80, 443];\n"
+  "routes = [{ path = \"/\", hosts = [a, b, c] }];\n";
+
+static void check_error(std::string_view   text,
+                        std::string_view   message,
+                        const ConfigLimits &limits = {})
+{
+	auto result = make_config_limited(text, limits);
+	assert(std::holds_alternative<ucl_schema_error>(result));
+	std::string_view error = std::get<ucl_schema_error>(result).msg;
+	if (error != message)
+	{
+		std::cerr << "Expected '" << message << "', got '" << error << "'"
+		          << std::endl;
+		abort();
+	}
+}
+
+int main()
+{
+	auto result = make_config_limited(config_string);
+	assert(std::holds_alternative<Config>(result));
+	auto conf = std::get<Config>(std::move(result));
+	assert(conf.name() == "front");
+	int ports = 0;
+	for (auto port : *conf.ports())
+	{
+		assert((port == 80) || (port == 443));
+		ports++;
+	}
+	assert(ports == 2);
+
+	// Limits from the caller apply as well as the ones from the schema.
+	check_error(config_string,
+	            "document is " + std::to_string(sizeof(config_string) - 1) +
+	              " bytes, more than 16",
+	            {.maxBytes = 16});
+	check_error(config_string,
+	            "array has more than 2 items",
+	            {.maxArrayLength = 2});
+	check_error(
+	  config_string, "document has more than 8 values", {.maxNodes = 8});
+
+	// Deep nesting is rejected before the document is parsed, even inside
+	// an object that the schema does not allow.
+	std::string deep = "other = ";
+	deep += std::string(100000, '[') + std::string(100000, ']') + ";\n";
+	check_error(deep, "document is nested more than 5 deep");
+	// Brackets in strings and comments are not counted.
+	auto quoted = make_config_limited("name = \"[[[[[[[[\"; # {{{{{{\n"
+	                                  "/* [[[[[[ */\n");
+	assert(std::holds_alternative<Config>(quoted));
+	// The bracket count is a lower bound, and the tree is checked as well.
+	check_error("routes = [{ hosts = [[[a]]] }];\n",
+	            "document is nested more than 5 deep");
+
+	// Arrays longer than `maxItems`, and documents with more values than the
+	// schema allows, are rejected before validation.
+	check_error("ports = [1, 2, 3, 4, 5, 6, 7, 8];\n",
+	            "array has more than 4 items");
+	std::string wide;
+	for (int i = 0; i < 32; i++)
+	{
+		wide += "extra" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+	}
+	check_error(wide, "document has more than 20 values");
+
+	// The deadline is checked between steps.
+	check_error(config_string,
+	            "deadline exceeded",
+	            {.timeout = std::chrono::nanoseconds(1)});
+
+	// Macros are not expanded, so documents cannot read other files.
+	auto included =
+	  make_config_limited(".include \"/nonexistent/limits.conf\"\n"
+	                      "name = \"included\";\n");
+	assert(std::holds_alternative<Config>(included));
+	assert(std::get<Config>(included).name() == "included");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include "test_numa.h"
+#include "config-numa.h"
+#include "config-watcher.h"
+#include "test_helpers.h"
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace std::chrono_literals;
+using namespace config::detail;
+
+static const char config_string[] = "name = \"a\";\nworkers = 4;\n"
+                                    "buffer = \"64kb\";\n";
+
+/**
+ * Split the CPUs that this process may run on into two emulated nodes.  With
+ * a single CPU, both nodes contain it.
+ */
+static NumaTopology emulated_topology()
+{
+	cpu_set_t set;
+	sched_getaffinity(0, sizeof(set), &set);
+	std::vector<int> cpus;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (CPU_ISSET(cpu, &set))
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	size_t half = std::max<size_t>(cpus.size() / 2, 1);
+	return NumaTopology(
+	  {{cpus.begin(), cpus.begin() + half},
+	   {cpus.begin() + (cpus.size() > 1 ? half : 0), cpus.end()}});
+}
+
+int main()
+{
+	NumaTopology parsed(std::string_view{"0-2,5;7"});
+	assert(parsed.size() == 2);
+	assert((parsed.cpus(0) == std::vector<int>{0, 1, 2, 5}));
+	assert(parsed.node_of(7) == 1);
+	assert(parsed.node_of(3) == 0);
+	assert(NumaTopology::system().size() >= 1);
+
+	NumaReplicas<Config> replicas(make_config_unchecked, emulated_topology());
+	auto                 obj = parse(config_string, sizeof(config_string));
+	assert(replicas.replica(0) == nullptr);
+	assert(replicas.local() == nullptr);
+	assert(replicas.publish(obj));
+
+	// Each node has its own copy of the document and the snapshot.
+	auto first  = replicas.replica(0);
+	auto second = replicas.replica(1);
+	assert(first != second);
+	assert(first->name() == second->name());
+	assert(first->name().data() != second->name().data());
+	assert(second->buffer()->count() == 65536);
+	auto *local = replicas.local();
+	auto  node  = emulated_topology().current_node();
+	assert(local == replicas.replica(node).get());
+	assert(local->workers() == 4);
+
+	// Each instance has its own cache entry, so using another instance does
+	// not replace the replica that this thread has already looked up.
+	{
+		NumaReplicas<Config> other(make_config_unchecked, emulated_topology());
+		assert(other.publish(obj));
+		auto *otherLocal = other.local();
+		assert(otherLocal != local);
+		assert(replicas.local() == local);
+		assert(other.local() == otherLocal);
+	}
+	assert(replicas.local() == local);
+	ucl_object_unref(obj);
+
+	// Unknown properties are compacted away from each replica's copy.
+	std::string large = std::string(config_string) + "unknown = \"" +
+	                    std::string(4096, 'x') + "\";\n";
+	obj = parse(large.data(), large.size());
+	assert(replicas.publish(obj));
+	assert(replicas.replica(0)->bytes() < 4096);
+	assert(replicas.replica(1)->bytes() < 4096);
+	ucl_object_unref(obj);
+
+	// Replicas are replaced together, and readers see the new ones.
+	char        pattern[] = "/tmp/config-numa-XXXXXX";
+	std::string directory = mkdtemp(pattern);
+	std::string path      = directory + "/main.conf";
+	std::ofstream(path) << "name = \"b\";\nworkers = 1;\n";
+	ConfigWatcher<Config> watcher(path, make_config, 20ms);
+	watcher.replicate([&](const ucl_object_t *o) { replicas.publish(o); });
+	assert(replicas.local()->name() == "b");
+	std::atomic<bool> stop{false};
+
+	std::thread reader([&]() {
+		// The worker count never decreases.
+		int last = 1;
+		while (!stop)
+		{
+			int workers = *replicas.local()->workers();
+			assert(workers >= last);
+			last = workers;
+		}
+	});
+	for (int i = 2; i <= 5; i++)
+	{
+		auto attempts = watcher.attempts();
+		std::ofstream(path) << "name = \"b\";\nworkers = " << i << ";\n";
+		watcher.request_reload();
+		bool reloaded = watcher.wait_for_attempts(attempts, 5s);
+		assert(reloaded);
+		assert(replicas.local()->workers() == i);
+		assert(replicas.replica(1)->workers() == i);
+	}
+	stop = true;
+	reader.join();
+
+	remove(path.c_str());
+	remove(directory.c_str());
+	return EXIT_SUCCESS;
+}
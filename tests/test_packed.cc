@@ -0,0 +1,55 @@
+#include "test_packed.h"
+#include "test_helpers.h"
+#include <string>
+
+// 64 optional flags take two bits each, the required flag one bit and the
+// enumerations three and two bits, so the fields fit in three words.
+static_assert(sizeof(config::detail::PackedBits<3>) == 24);
+
+static Config load(const std::string &text)
+{
+	auto *obj  = parse(text.data(), text.size());
+	auto  conf = getConfig(obj);
+	ucl_object_unref(obj);
+	return conf;
+}
+
+int main()
+{
+	auto conf = load("name = a; enabled = true; level = warn;");
+	assert(conf.name() == "a");
+	assert(conf.enabled());
+	assert(conf.level() == "warn");
+	assert(!conf.mode());
+	assert(!conf.flag0());
+	assert(!conf.flag63());
+
+	std::string text = "name = b; enabled = false; level = debug; "
+	                   "mode = \"very-safe\";";
+	for (int i = 0; i < 64; i++)
+	{
+		text += " flag" + std::to_string(i) + " = ";
+		text += (i % 3 == 0) ? "true;" : "false;";
+	}
+	auto flags = load(text);
+	assert(!flags.enabled());
+	assert(flags.level() == "debug");
+	assert(flags.mode() == "very-safe");
+	assert(flags.flag0() == true);
+	assert(flags.flag1() == false);
+	assert(flags.flag31() == false);
+	assert(flags.flag33() == true);
+	assert(flags.flag62() == false);
+	assert(flags.flag63() == true);
+	assert(flags.get<"flag3">() == true);
+	assert(!(conf == flags));
+	assert(flags == load(text));
+	assert(flags.hash() == load(text).hash());
+
+	// Values that are not in the enumeration are rejected.
+	const char invalid[] = "name = c; enabled = true; level = trace;";
+	auto      *obj       = parse(invalid, sizeof(invalid));
+	checkInvalidConfig(obj);
+	ucl_object_unref(obj);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,43 @@
+#include "test_pattern.h"
+#include "test_helpers.h"
+
+static const char config_string[] = "hostname = \"www.example.com\";\n"
+                                    "contains = \"xxabbbcxx\";\n"
+                                    "labels = [\"prod-1\", \"dev-123\"];\n"
+                                    "inner { code = \"x\xc3\xa9y\"; }\n";
+
+static const char bad_hostname[] = "hostname = \"www.-example.com\";\n";
+
+static const char bad_contains[] = "hostname = \"example.com\";\n"
+                                   "contains = \"xxacxx\";\n";
+
+static const char bad_label[] = "hostname = \"example.com\";\n"
+                                "labels = [\"prod-1\", \"test-1\"];\n";
+
+static const char bad_inner[] = "hostname = \"example.com\";\n"
+                                "inner { code = \"1234\"; }\n";
+
+int main()
+{
+	static_assert(Config::hostname_pattern.match("a.b-c.d"));
+	static_assert(!Config::hostname_pattern.match("a..b"));
+	static_assert(Config::contains_pattern.match("abc"));
+	static_assert(!Config::contains_pattern.match("ab"));
+	static_assert(Config::innerClass::code_pattern.match("123"));
+	// `.` follows POSIX: it matches a newline and one valid UTF-8 character.
+	static_assert(Config::innerClass::code_pattern.match("x\ny"));
+	static_assert(Config::innerClass::code_pattern.match("x\xf0\x9f\x98\x80y"));
+	static_assert(!Config::innerClass::code_pattern.match("x\xe0\x80\xafy"));
+	static_assert(!Config::innerClass::code_pattern.match("x\xed\xa0\x80y"));
+	static_assert(
+	  !Config::innerClass::code_pattern.match("x\xf4\x90\x80\x80y"));
+	auto obj  = parse(config_string, sizeof(config_string));
+	auto conf = getConfig(obj);
+	assert(conf.hostname() == "www.example.com");
+	assert(conf.inner()->code() == "x\xc3\xa9y");
+	checkInvalidConfig(parse(bad_hostname, sizeof(bad_hostname)));
+	checkInvalidConfig(parse(bad_contains, sizeof(bad_contains)));
+	checkInvalidConfig(parse(bad_label, sizeof(bad_label)));
+	checkInvalidConfig(parse(bad_inner, sizeof(bad_inner)));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+#include "test_pointer.h"
+#include "test_helpers.h"
+#include <type_traits>
+
+using config::detail::get;
+
+static const char config_string[] =
+  "name = \"proxy\";\n"
+  "upstreams = [{ host = \"a\"; timeout = 5; }, { host = \"b\"; }];\n"
+  "limits { max-connections = 100; }\n";
+
+static const char no_upstreams[] = "name = \"x\";\n"
+                                   "limits { max-connections = 1; }\n";
+
+int main()
+{
+	auto obj  = parse(config_string, sizeof(config_string));
+	auto conf = getConfig(obj);
+	// Required properties are not optional.
+	static_assert(
+	  std::is_same_v<decltype(get<"/name">(conf)), std::string_view>);
+	static_assert(std::is_same_v<decltype(get<"/limits/max-connections">(conf)),
+	                             decltype(conf.limits().max_connections())>);
+	assert(get<"/name">(conf) == "proxy");
+	assert(get<"/limits/max-connections">(conf) == 100);
+	assert(get<"">(conf).name() == "proxy");
+	// Array elements and optional properties give optional results.
+	assert(get<"/upstreams/1/host">(conf) == "b");
+	assert(get<"/upstreams/0/timeout">(conf) == std::chrono::duration<int>(5));
+	assert(!get<"/upstreams/1/timeout">(conf));
+	assert(!get<"/upstreams/2/host">(conf));
+	assert(get<"/upstreams/0">(conf)->host() == "a");
+	auto empty = parse(no_upstreams, sizeof(no_upstreams));
+	assert(!get<"/upstreams/0/host">(getConfig(empty)));
+	// Segments are unescaped at compile time.
+	using config::detail::pointer_segment;
+	static_assert(std::string_view(pointer_segment<"/a~1b~0c", 1, 8>()) ==
+	              "a/b~c");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+#include "test_pool.h"
+#include "config-pool.h"
+#include "test_helpers.h"
+#include <string>
+#include <vector>
+
+using namespace config::detail;
+
+/**
+ * Returns a document for the tenants in `group`.
+ */
+static ucl_object_t *document(int group)
+{
+	std::string text = "backend = \"b" + std::to_string(group) +
+	                   "\";\nconnections = 4;\naliases = [x, y];\n";
+	return parse(text.data(), text.size());
+}
+
+/**
+ * Returns the storage of the first alias of `view`, which is in its
+ * document.
+ */
+static const char *first_alias(const ConfigPool<Config>::View &view)
+{
+	auto aliases = view.aliases();
+	for (auto alias : *aliases)
+	{
+		return alias.data();
+	}
+	return nullptr;
+}
+
+int main()
+{
+	using Pool = ConfigPool<Config>;
+	Pool pool(make_config);
+	assert(!pool.get(0));
+	assert(pool.size() == 0);
+
+	// Tenants that share a string share its storage.
+	std::vector<ucl_object_t *> documents;
+	std::vector<Pool::Update>   updates;
+	for (Pool::TenantId tenant = 0; tenant < 3000; tenant++)
+	{
+		documents.push_back(document(tenant % 3));
+		updates.push_back({tenant, documents.back()});
+	}
+	assert(pool.update(updates).empty());
+	for (auto *obj : documents)
+	{
+		ucl_object_unref(obj);
+	}
+	assert(pool.size() == 3000);
+	assert(pool.interned_strings() == 3);
+	assert(pool.get(1)->backend() == "b1");
+	assert(pool.get(2999)->connections() == 4);
+	assert(pool.get(4)->backend().data() == pool.get(1)->backend().data());
+	assert(pool.get(4)->backend() != pool.get(5)->backend());
+	assert(!pool.get(3000));
+	assert(!pool.get(100000));
+
+	// Properties that are not materialized are read from the document.
+	auto   view    = pool.get(2);
+	auto   aliases = view->aliases();
+	size_t count   = 0;
+	for (auto alias : *aliases)
+	{
+		assert((alias == "x") || (alias == "y"));
+		count++;
+	}
+	assert(count == 2);
+
+	// Tenants with equal configs share a document.
+	assert(first_alias(*pool.get(2)) == first_alias(*pool.get(2999)));
+	assert(first_alias(*pool.get(2)) != first_alias(*pool.get(1)));
+
+	// Invalid documents are rejected and the tenant keeps its config.
+	static const char invalid[] = "backend = \"b\";\nconnections = 0;\n";
+	auto             *bad       = parse(invalid, sizeof(invalid));
+	auto              error     = pool.set(7, bad);
+	ucl_object_unref(bad);
+	assert(error);
+	assert(pool.get(7)->backend() == "b1");
+
+	// Readers keep the config that they looked up across updates.
+	auto old = pool.get(7);
+	auto obj = document(5);
+	assert(!pool.set(7, obj));
+	ucl_object_unref(obj);
+	assert(pool.get(7)->backend() == "b5");
+	assert(old->backend() == "b1");
+	assert(pool.get(4)->backend() == "b1");
+	assert(pool.interned_strings() == 4);
+
+	// Updates can add and remove tenants together, and invalid ones are
+	// reported without stopping the others.
+	auto *added = document(1);
+	bad         = parse(invalid, sizeof(invalid));
+	Pool::Update batch[] = {{7, nullptr}, {50000, added}, {8, bad}};
+	auto         rejected = pool.update(batch);
+	ucl_object_unref(added);
+	ucl_object_unref(bad);
+	assert(rejected.size() == 1);
+	assert(rejected[0].tenant == 8);
+	assert(!pool.get(7));
+	assert(pool.get(50000)->backend() == "b1");
+	assert(pool.size() == 3000);
+	pool.erase(7);
+	pool.erase(60000);
+	assert(pool.size() == 3000);
+	assert(old->backend() == "b1");
+
+	// Strings that are no longer used are dropped when the arena is rebuilt,
+	// and views from before the rebuild remain valid.
+	Pool small(make_config);
+	obj = document(0);
+	small.set(0, obj);
+	ucl_object_unref(obj);
+	auto first = small.get(0);
+	for (int group = 1; group < 100; group++)
+	{
+		obj = document(group);
+		small.set(0, obj);
+		ucl_object_unref(obj);
+	}
+	assert(small.get(0)->backend() == "b99");
+	assert(small.interned_strings() < 99);
+	assert(first->backend() == "b0");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include "test_prefix_trie.h"
+#include "test_helpers.h"
+#include <random>
+#include <string>
+
+using namespace config::detail;
+
+static const char config_string[] = "allow = [\"0.0.0.0/0\", \"10.0.0.0/8\", "
+                                    "\"10.1.0.0/16\", \"10.1.2.3/32\", "
+                                    "\"10.0.0.0/8\", \"2001:db8::/32\", "
+                                    "\"2001:db8:1::/48\"];\n";
+
+static const char bad_prefix[] = "allow = [\"10.0.0.0/8\", \"10.0.0.0/33\"];\n";
+
+static IPAddress address(const char *str)
+{
+	return *formats::parse_address(str);
+}
+
+/**
+ * Check the trie against a linear scan for random prefixes and addresses.
+ */
+static void check_random(uint8_t family, unsigned bits)
+{
+	std::mt19937          rng(bits);
+	std::vector<IPPrefix> prefixes;
+	for (int i = 0; i < 500; i++)
+	{
+		IPPrefix p;
+		p.address.family = family;
+		// Cluster the prefixes so that they nest.
+		p.address.bytes[0] = rng() % 4;
+		for (unsigned b = 1; b < bits / 8; b++)
+		{
+			p.address.bytes[b] = rng() % 3;
+		}
+		p.length = rng() % (bits + 1);
+		for (unsigned b = p.length; b < bits; b++)
+		{
+			p.address.bytes[b / 8] &= ~(0x80 >> (b % 8));
+		}
+		prefixes.push_back(p);
+	}
+	PrefixTrie trie(prefixes);
+	for (int i = 0; i < 5000; i++)
+	{
+		IPAddress a;
+		a.family = family;
+		for (unsigned b = 0; b < bits / 8; b++)
+		{
+			a.bytes[b] = rng() % (b == 0 ? 4 : 3);
+		}
+		std::optional<size_t> expected;
+		for (size_t p = 0; p < prefixes.size(); p++)
+		{
+			if (prefixes[p].contains(a) &&
+			    (!expected ||
+			     (prefixes[p].length > prefixes[*expected].length)))
+			{
+				expected = p;
+			}
+		}
+		assert(trie.lookup(a) == expected);
+	}
+}
+
+int main()
+{
+	auto obj  = parse(config_string, sizeof(config_string));
+	auto conf = getConfig(obj);
+	auto trie = conf.allow();
+	assert(trie.size() == 7);
+	assert(trie.lookup(address("192.0.2.1")) == 0);
+	assert(trie.lookup(address("10.200.0.1")) == 1);
+	assert(trie.lookup(address("10.1.200.1")) == 2);
+	assert(trie.lookup(address("10.1.2.3")) == 3);
+	assert(trie.lookup(address("2001:db8:2::1")) == 5);
+	assert(trie.lookup(address("2001:db8:1::1")) == 6);
+	assert(!trie.lookup(address("2001:db9::1")));
+	assert(trie[3].length == 32);
+	assert(!conf.deny());
+	// Without a snapshot, the trie is built on access.
+	assert(Config(obj).allow().lookup(address("10.1.2.3")) == 3);
+	checkInvalidConfig(parse(bad_prefix, sizeof(bad_prefix)));
+	check_random(AF_INET, 32);
+	check_random(AF_INET6, 128);
+	return EXIT_SUCCESS;
+}
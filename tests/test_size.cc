@@ -0,0 +1,63 @@
+#include "test_size.h"
+#include "test_helpers.h"
+#include <type_traits>
+
+static const char config_string[] = "buffer = 64kb;\n"
+                                    "cache = \"1.5gb\";\n"
+                                    "small = 255;\n"
+                                    "limits = [\"4g\", 1.5k, \"512\"];\n";
+
+static const char too_big[] = "buffer = \"64.5kb\";\n";
+
+static const char not_multiple[] = "buffer = 1;\n"
+                                   "cache = 1500;\n";
+
+static const char fractional[] = "buffer = \"1.0001k\";\n";
+
+static const char negative[] = "buffer = -1;\n";
+
+static const char bad_suffix[] = "buffer = \"10xb\";\n";
+
+int main()
+{
+	using namespace config::detail;
+	// The accessors use the narrowest type that can hold the bounds.
+	static_assert(
+	  std::is_same_v<decltype(std::declval<Config>().buffer()),
+	                 ByteSize<uint32_t>>);
+	static_assert(
+	  std::is_same_v<decltype(std::declval<Config>().cache()),
+	                 std::optional<ByteSize<uint64_t>>>);
+	static_assert(
+	  std::is_same_v<decltype(std::declval<Config>().small()),
+	                 std::optional<ByteSize<uint8_t>>>);
+	auto obj  = parse(config_string, sizeof(config_string));
+	auto conf = getConfig(obj);
+	assert(conf.buffer().count() == 65536);
+	assert(conf.cache()->count() == 1610612736);
+	assert(conf.small()->count() == 255);
+	uint32_t expected[] = {4000000000, 1500, 512};
+	int      i          = 0;
+	auto     limits     = conf.limits();
+	for (auto limit : *limits)
+	{
+		assert(limit.count() == expected[i++]);
+	}
+	assert(i == 3);
+	// Without a snapshot, strings are decoded on access.
+	assert(Config(obj).cache()->count() == 1610612736);
+	assert(parse_size("1kb") == 1024);
+	assert(parse_size("2M") == 2000000);
+	assert(parse_size("0.5kb") == 512);
+	assert(parse_size("18446744073709551615") == UINT64_MAX);
+	assert(!parse_size("18446744073709551616"));
+	assert(!parse_size("17179869184gb"));
+	assert(!parse_size(".k"));
+	assert(!parse_size("1kib"));
+	checkInvalidConfig(parse(too_big, sizeof(too_big)));
+	checkInvalidConfig(parse(not_multiple, sizeof(not_multiple)));
+	checkInvalidConfig(parse(fractional, sizeof(fractional)));
+	checkInvalidConfig(parse(negative, sizeof(negative)));
+	checkInvalidConfig(parse(bad_suffix, sizeof(bad_suffix)));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+#include "test_tenants.h"
+#include "config-tenants.h"
+#include "test_helpers.h"
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace config::detail;
+
+int main()
+{
+	char        pattern[] = "/tmp/config-tenants-XXXXXX";
+	std::string directory = mkdtemp(pattern);
+	for (int i = 0; i < 8; i++)
+	{
+		std::ofstream(directory + "/t" + std::to_string(i) + ".conf")
+		  << "backend = \"b" << i << "\";\nconnections = " << i + 1 << ";\n";
+	}
+	std::ofstream(directory + "/invalid.conf") << "connections = 0;\n";
+	std::ofstream(directory + "/large.conf")
+	  << "backend = \"b\";\nallow = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n"
+	  << "unknown = \"" << std::string(4096, 'x') << "\";\n";
+
+	// Snapshots and documents are counted.
+	{
+		std::string small = "backend = \"b\";\n";
+		std::string large = "backend = \"b\";\n"
+		                    "allow = [\"10.0.0.0/8\", \"192.168.0.0/16\"];\n";
+		auto        a     = getConfig(parse(small.data(), small.size()));
+		auto        b     = getConfig(parse(large.data(), large.size()));
+		assert(a.bytes() > sizeof(Config));
+		assert(b.bytes() > a.bytes() + 2 * sizeof(IPPrefix));
+	}
+
+	// Everything fits.
+	TenantCache<Config> cache(DirectorySource(directory), make_config, 1 << 20);
+	auto                first = cache.get("t1");
+	assert(first->backend() == "b1");
+	assert(cache.get("t1") == first);
+	auto stats = cache.statistics();
+	assert((stats.hits == 1) && (stats.misses == 1) && (stats.entries == 1));
+	assert(stats.bytes >= first->bytes());
+
+	// Unknown properties are compacted away before the config is counted.
+	auto large = cache.get("large");
+	assert(large->allow()->lookup(*formats::parse_address("10.1.2.3")) == 0);
+	assert(large->bytes() < 4096);
+
+	// Failures are reported and not cached.
+	std::string error;
+	assert(cache.get("invalid", &error) == nullptr);
+	assert(!error.empty());
+	assert(cache.get("missing", &error) == nullptr);
+	assert(cache.get("../t1") == nullptr);
+	assert(cache.statistics().failures == 3);
+	assert(cache.statistics().entries == 2);
+
+	// Invalidated configs are loaded again.
+	std::ofstream(directory + "/t1.conf") << "backend = \"new\";\n";
+	assert(cache.get("t1")->backend() == "b1");
+	cache.invalidate("t1");
+	assert(cache.get("t1")->backend() == "new");
+	assert(first->backend() == "b1");
+
+	// A config whose load raced with an invalidation is returned but not
+	// cached.
+	int                 reads = 0;
+	TenantCache<Config> raced(
+	  [&](const std::string &tenant) {
+		  if (reads++ == 0)
+		  {
+			  raced.invalidate(tenant);
+		  }
+		  return DirectorySource(directory)(tenant);
+	  },
+	  make_config,
+	  1 << 20);
+	assert(raced.get("t2")->backend() == "b2");
+	assert(raced.statistics().entries == 0);
+	raced.get("t2");
+	assert((raced.statistics().entries == 1) && (reads == 2));
+
+	// With room for a few configs, the least recently used are evicted.
+	size_t              budget = (first->bytes() + 256) * 2;
+	TenantCache<Config> small(DirectorySource(directory), make_config, budget, 1);
+	small.get("t2");
+	small.get("t3");
+	small.get("t2");
+	for (int i = 4; i < 8; i++)
+	{
+		small.get("t" + std::to_string(i));
+	}
+	stats = small.statistics();
+	assert(stats.evictions > 0);
+	assert(stats.bytes <= budget);
+	assert(stats.entries + stats.evictions == 6);
+	stats = small.statistics();
+	small.get("t7");
+	assert(small.statistics().hits == stats.hits + 1);
+	small.get("t2");
+	assert(small.statistics().misses == stats.misses + 1);
+
+	// Documents can also come from a single file, one line per tenant.
+	std::string kv = directory + "/tenants.kv";
+	std::ofstream(kv) << "alpha\tbackend = \"a\";\n"
+	                  << "no tab\n"
+	                  << "beta\tbackend = \"b\"; connections = 2;\n"
+	                  << "gamma\tbackend = \"c\";";
+	TenantCache<Config> fromFile(KeyValueFileSource(kv), make_config, 1 << 20);
+	assert(fromFile.get("alpha")->backend() == "a");
+	assert(fromFile.get("beta")->connections() == 2);
+	assert(fromFile.get("gamma")->backend() == "c");
+	assert(fromFile.get("no tab") == nullptr);
+
+	for (auto name : {"invalid", "large", "t0", "t1", "t2", "t3", "t4", "t5",
+	                  "t6", "t7"})
+	{
+		remove((directory + '/' + name + ".conf").c_str());
+	}
+	remove(kv.c_str());
+	remove(directory.c_str());
+	return EXIT_SUCCESS;
+}
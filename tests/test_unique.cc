@@ -0,0 +1,50 @@
+#include "test_unique.h"
+#include "test_helpers.h"
+#include <string>
+#include <string_view>
+
+static const char config_string[] = "names = [a, b, c, ab];\n"
+                                    "ids = [1, -1, 2, 3, 1024];\n";
+
+static const char duplicate_name[] = "names = [a, b, a];\n";
+
+static const char duplicate_id[] = "ids = [3, 1, 2, 3];\n";
+
+static const char empty_name[] = "names = [a, \"\"];\n";
+
+int main()
+{
+	auto obj   = parse(config_string, sizeof(config_string));
+	auto conf  = getConfig(obj);
+	auto ids   = conf.ids();
+	int  count = 0;
+	for (auto id : *ids)
+	{
+		assert(id != 0);
+		count++;
+	}
+	assert(count == 5);
+	checkInvalidConfig(parse(duplicate_id, sizeof(duplicate_id)));
+	checkInvalidConfig(parse(empty_name, sizeof(empty_name)));
+
+	// The error reports the index of the duplicate.
+	auto *dup    = parse(duplicate_name, sizeof(duplicate_name));
+	auto  result = make_config(dup);
+	assert(std::holds_alternative<ucl_schema_error>(result));
+	assert(std::string_view(std::get<ucl_schema_error>(result).msg) ==
+	       "item 2 is a duplicate of an earlier item");
+
+	// Large arrays of distinct items, including ones that collide in the low
+	// bits, are accepted.
+	std::string many = "ids = [";
+	for (int i = 0; i < 50000; i++)
+	{
+		many += std::to_string(i << 16);
+		many += ',';
+	}
+	many += "];\n";
+	getConfig(parse(many.data(), many.size()));
+	many.insert(many.size() - 3, "0,");
+	checkInvalidConfig(parse(many.data(), many.size()));
+	return EXIT_SUCCESS;
+}
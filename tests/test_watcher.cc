@@ -0,0 +1,144 @@
+#include "test_watcher.h"
+#include "config-watcher.h"
+#include "test_helpers.h"
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+using Watcher = config::detail::ConfigWatcher<Config>;
+
+static std::string directory;
+
+/**
+ * Write `contents` to `name` in the test directory.  If `replace` is true then
+ * write a temporary file and rename it, as many editors do.
+ */
+static void
+write_file(const char *name, const std::string &contents, bool replace = false)
+{
+	std::string path = directory + '/' + name;
+	std::string tmp  = replace ? path + ".tmp" : path;
+	std::ofstream(tmp) << contents;
+	if (replace)
+	{
+		rename(tmp.c_str(), path.c_str());
+	}
+}
+
+/**
+ * Wait for the watcher to finish the reload after `attempts`.
+ */
+static void wait_for_reload(Watcher &watcher, uint64_t attempts)
+{
+	bool reloaded = watcher.wait_for_attempts(attempts, 5s);
+	assert(reloaded);
+}
+
+int main()
+{
+	char pattern[] = "/tmp/config-watcher-XXXXXX";
+	directory      = mkdtemp(pattern);
+	// As in libucl, bare relative paths in `.include` directives are resolved
+	// against the working directory.
+	int changed = chdir(directory.c_str());
+	assert(changed == 0);
+	write_file("main.conf", ".include \"workers.conf\"\nname = \"a\";\n");
+	write_file("workers.conf", "workers = 1;\n");
+
+	Watcher watcher(directory + "/main.conf", make_config, 20ms);
+	assert(watcher.current()->name() == "a");
+	assert(watcher.current()->workers() == 1);
+	assert(watcher.generation() == 1);
+	std::atomic<int> notified{0};
+	watcher.subscribe(
+	  [&](const std::shared_ptr<const Config> &) { notified++; });
+
+	// Replace the main file by renaming over it.
+	auto attempts = watcher.attempts();
+	write_file("main.conf", ".include \"workers.conf\"\nname = \"b\";\n", true);
+	wait_for_reload(watcher, attempts);
+	assert(watcher.current()->name() == "b");
+	assert(notified == 1);
+
+	// Modify the included file in place.
+	attempts = watcher.attempts();
+	write_file("workers.conf", "workers = 2;\n");
+	wait_for_reload(watcher, attempts);
+	assert(watcher.current()->workers() == 2);
+
+	// An invalid config is not published.
+	auto old = watcher.current();
+	attempts = watcher.attempts();
+	write_file("workers.conf", "workers = 0;\n");
+	wait_for_reload(watcher, attempts);
+	assert(watcher.current() == old);
+	assert(!watcher.last_error().empty());
+	assert(notified == 2);
+
+	// A burst of writes is coalesced.
+	attempts = watcher.attempts();
+	for (int i = 0; i < 10; i++)
+	{
+		write_file("workers.conf",
+		           "workers = " + std::to_string(i + 3) + ";\n");
+	}
+	wait_for_reload(watcher, attempts);
+	std::this_thread::sleep_for(100ms);
+	assert(watcher.attempts() <= attempts + 2);
+	assert(watcher.current()->workers() == 12);
+	assert(watcher.last_error().empty());
+
+	// Reloading a config that has not changed does not publish it.
+	auto generation    = watcher.generation();
+	int  notifications = notified;
+	attempts           = watcher.attempts();
+	watcher.request_reload();
+	wait_for_reload(watcher, attempts);
+	assert(watcher.generation() == generation);
+	assert(notified == notifications);
+
+	// Files included by included files are watched, and `$CURDIR` is the
+	// directory of the file that contains the directive.
+	mkdir((directory + "/sub").c_str(), 0700);
+	write_file("sub/label.conf", ".include \"${CURDIR}/text.conf\"\n");
+	write_file("sub/text.conf", "label = \"first\";\n");
+	attempts = watcher.attempts();
+	write_file("workers.conf",
+	           ".include \"$CURDIR/sub/label.conf\"\nworkers = 12;\n");
+	wait_for_reload(watcher, attempts);
+	assert(watcher.current()->label() == "first");
+	attempts = watcher.attempts();
+	write_file("sub/text.conf", "label = \"second\";\n", true);
+	wait_for_reload(watcher, attempts);
+	assert(watcher.current()->label() == "second");
+
+	// Readers can run concurrently with reloads.
+	std::atomic<bool> done{false};
+	std::thread       reader([&]() {
+		while (!done)
+		{
+			assert(watcher.current()->workers() >= 12);
+		}
+	});
+	for (int i = 0; i < 20; i++)
+	{
+		attempts = watcher.attempts();
+		watcher.request_reload();
+		wait_for_reload(watcher, attempts);
+	}
+	done = true;
+	reader.join();
+
+	for (auto *name :
+	     {"main.conf", "workers.conf", "sub/label.conf", "sub/text.conf"})
+	{
+		remove((directory + '/' + name).c_str());
+	}
+	rmdir((directory + "/sub").c_str());
+	rmdir(directory.c_str());
+	return EXIT_SUCCESS;
+}